@@ -0,0 +1,276 @@
+#pragma once
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "voxel.h"
+#include "mesh.h"
+
+// CELLULAR AUTOMATA
+// Runs on a bit-packed copy of the occupancy: one bit per voxel, rows of 64 voxels per word along x.
+// Neighbour counts are bit-sliced, i.e. 64 cells are counted at once with full adders on whole words:
+// x triples first (2 bit sums), then y triples (4 bit), then z triples (5 bit, 0..27 including the cell).
+// Every thread walks its own z slab and keeps the y sums of three planes in a small ring, so each plane is
+// summed once. Generations are double buffered; changed words flag their chunks so caStore only writes
+// (and remeshes) chunks that actually changed. Works on any cubic grid size.
+
+struct CaRule
+{
+    const char* name;
+    uint32_t birth;   // bit n: empty cell with n solid neighbours (of 26) becomes solid
+    uint32_t survive; // bit n: solid cell with n solid neighbours stays solid
+    bool sand;        // ignore the masks, let every voxel fall one cell per generation
+};
+
+static constexpr uint32_t caRange(const int lo, const int hi)
+{
+    return static_cast<uint32_t>((1ull << (hi + 1)) - (1ull << lo));
+}
+
+static const CaRule kCaRules[] = {
+    { "Life 4555", caRange(5, 5), caRange(4, 5), false },
+    { "Caves", caRange(14, 26), caRange(13, 26), false },
+    { "Erode", 0, caRange(14, 26), false },
+    { "Sand", 0, 0, true },
+};
+
+struct CaGrid
+{
+    int size;
+    int words;                  // per row
+    int chunks;                 // per axis
+    std::vector<uint64_t> cur;  // (z * size + y) * words + w
+    std::vector<uint64_t> next;
+    std::vector<uint8_t> changed; // per z plane and (cy, cx), since the last caStore
+    std::vector<std::vector<uint64_t>> ring; // per thread: 3 planes of y sums + x sums of one plane
+};
+
+static void caInit(CaGrid* ca, const int size)
+{
+    ca->size = size;
+    ca->words = (size + 63) / 64;
+    ca->chunks = (size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    ca->cur.assign(static_cast<size_t>(size) * size * ca->words, 0);
+    ca->next.assign(ca->cur.size(), 0);
+    ca->changed.assign(static_cast<size_t>(size) * ca->chunks * ca->chunks, 0);
+}
+
+// Occupancy from a uint8 grid of the same size, x fastest
+static void caLoad(CaGrid* ca, const uint8_t* data)
+{
+    const int n = ca->size;
+    #pragma omp parallel for
+    for (int z = 0; z < n; z++)
+        for (int y = 0; y < n; y++) {
+            const uint8_t* row = data + (static_cast<size_t>(z) * n + y) * n;
+            uint64_t* out = &ca->cur[(static_cast<size_t>(z) * n + y) * ca->words];
+            for (int w = 0; w < ca->words; w++) {
+                uint64_t bits = 0;
+                const int x0 = w * 64, x1 = std::min(x0 + 64, n);
+                for (int x = x0; x < x1; x++) bits |= static_cast<uint64_t>(row[x] != 0) << (x - x0);
+                out[w] = bits;
+            }
+        }
+}
+
+// acc (n planes) += b (m planes), ripple carry over bit planes
+template <int n, int m>
+static inline void caAdd(uint64_t* acc, const uint64_t* b)
+{
+    uint64_t carry = 0;
+    for (int k = 0; k < n; k++) {
+        const uint64_t bk = k < m ? b[k] : 0;
+        const uint64_t t = acc[k] ^ bk;
+        const uint64_t c = (acc[k] & bk) | (t & carry);
+        acc[k] = t ^ carry;
+        carry = c;
+    }
+}
+
+// Bit-sliced T >= c for a constant c; branches only depend on c
+static inline uint64_t caAtLeast(const uint64_t t[5], const int c)
+{
+    if (c >= 32) return 0;
+    uint64_t gt = 0, eq = ~0ull;
+    for (int j = 4; j >= 0; j--) {
+        if (c >> j & 1) eq &= t[j];
+        else {
+            gt |= eq & t[j];
+            eq &= ~t[j];
+        }
+    }
+    return gt | eq;
+}
+
+// Bit-sliced lookup: for every lane, bit T of mask where T is the 5 plane count in t. Each run of set bits
+// in the mask is one range test.
+static inline uint64_t caMatch(uint32_t mask, const uint64_t t[5])
+{
+    uint64_t result = 0;
+    while (mask) {
+        const int lo = __builtin_ctz(mask);
+        const uint32_t above = ~mask & ~((1u << lo) - 1);
+        const int hi = above ? __builtin_ctz(above) : 32; // one past the run
+        result |= caAtLeast(t, lo) & ~caAtLeast(t, hi);
+        mask &= hi < 32 ? ~((1u << hi) - 1) : 0;
+    }
+    return result;
+}
+
+// 4 plane y sums (0..9) of x triples for every row of plane z, zero outside the grid. rows is scratch for
+// the 2 plane x sums of the plane.
+static void caPlaneSums(const CaGrid* ca, const int z, uint64_t* out, uint64_t* rows)
+{
+    const int n = ca->size, words = ca->words;
+    const size_t plane = static_cast<size_t>(n) * words * 4;
+    if (z < 0 || z >= n) {
+        memset(out, 0, plane * sizeof(uint64_t));
+        return;
+    }
+
+    for (int y = 0; y < n; y++) {
+        const uint64_t* row = &ca->cur[(static_cast<size_t>(z) * n + y) * words];
+        for (int w = 0; w < words; w++) {
+            const uint64_t c = row[w];
+            const uint64_t l = c << 1 | (w > 0 ? row[w - 1] >> 63 : 0);
+            const uint64_t r = c >> 1 | (w + 1 < words ? row[w + 1] << 63 : 0);
+            uint64_t* s = rows + (static_cast<size_t>(y) * words + w) * 2;
+            s[0] = l ^ c ^ r;
+            s[1] = (l & c) | (r & (l ^ c));
+        }
+    }
+
+    for (int y = 0; y < n; y++)
+        for (int w = 0; w < words; w++) {
+            uint64_t* acc = out + (static_cast<size_t>(y) * words + w) * 4;
+            const uint64_t* s = rows + (static_cast<size_t>(y) * words + w) * 2;
+            acc[0] = s[0]; acc[1] = s[1]; acc[2] = 0; acc[3] = 0;
+            if (y > 0) caAdd<4, 2>(acc, s - words * 2);
+            if (y + 1 < n) caAdd<4, 2>(acc, s + words * 2);
+        }
+}
+
+// Marks the chunks covered by the set bits of d (row y, word w of plane z)
+static void caFlag(CaGrid* ca, const int z, const int y, const int w, const uint64_t d)
+{
+    uint8_t* flags = &ca->changed[(static_cast<size_t>(z) * ca->chunks + y / CHUNK_SIZE) * ca->chunks];
+    for (int cx = w * 64 / CHUNK_SIZE; cx < ca->chunks && cx * CHUNK_SIZE < (w + 1) * 64; cx++) {
+        const int shift = cx * CHUNK_SIZE - w * 64;
+        if (d >> shift & ((1ull << CHUNK_SIZE) - 1)) flags[cx] = 1;
+    }
+}
+
+// One generation, returns the number of words that changed
+static long caStep(CaGrid* ca, const CaRule& rule)
+{
+    const int n = ca->size, words = ca->words;
+    const uint64_t tail = n % 64 ? (1ull << (n % 64)) - 1 : ~0ull;
+    long changed = 0;
+
+    if (rule.sand) {
+        // A voxel falls when the cell below is empty; a cell fills when the one above falls into it
+        #pragma omp parallel for reduction(+:changed)
+        for (int z = 0; z < n; z++)
+            for (int y = 0; y < n; y++)
+                for (int w = 0; w < words; w++) {
+                    const size_t i = (static_cast<size_t>(z) * n + y) * words + w;
+                    const uint64_t c = ca->cur[i];
+                    const uint64_t below = y > 0 ? ca->cur[i - words] : ~0ull;
+                    const uint64_t above = y + 1 < n ? ca->cur[i + words] : 0;
+                    const uint64_t v = (c & below) | (above & ~c);
+                    ca->next[i] = v;
+                    if (v != c) {
+                        caFlag(ca, z, y, w, v ^ c);
+                        changed++;
+                    }
+                }
+        ca->cur.swap(ca->next);
+        return changed;
+    }
+
+    const uint32_t birth = rule.birth, survive = rule.survive << 1; // counts include the cell itself
+    const size_t plane = static_cast<size_t>(n) * words * 4;
+    const int threads = threadCount();
+    ca->ring.resize(threads);
+    for (auto& r : ca->ring) r.resize(plane * 3 + plane / 2);
+
+    #pragma omp parallel for schedule(static) reduction(+:changed)
+    for (int slab = 0; slab < threads; slab++) {
+        const int z0 = static_cast<int>(static_cast<long>(n) * slab / threads), z1 = static_cast<int>(static_cast<long>(n) * (slab + 1) / threads);
+        uint64_t* ring = ca->ring[threadIndex()].data();
+        uint64_t* rows = ring + plane * 3;
+        if (z0 < z1) {
+            caPlaneSums(ca, z0 - 1, ring + plane * ((z0 + 2) % 3), rows);
+            caPlaneSums(ca, z0, ring + plane * (z0 % 3), rows);
+        }
+        for (int z = z0; z < z1; z++) {
+            caPlaneSums(ca, z + 1, ring + plane * ((z + 1) % 3), rows);
+            const uint64_t* prev = ring + plane * ((z + 2) % 3);
+            const uint64_t* mid = ring + plane * (z % 3);
+            const uint64_t* post = ring + plane * ((z + 1) % 3);
+
+            for (int y = 0; y < n; y++)
+                for (int w = 0; w < words; w++) {
+                    const size_t k = (static_cast<size_t>(y) * words + w) * 4;
+                    uint64_t sum[5] = { prev[k], prev[k + 1], prev[k + 2], prev[k + 3], 0 };
+                    caAdd<5, 4>(sum, mid + k);
+                    caAdd<5, 4>(sum, post + k);
+
+                    const size_t i = (static_cast<size_t>(z) * n + y) * words + w;
+                    const uint64_t c = ca->cur[i];
+                    uint64_t v = (c & caMatch(survive, sum)) | (~c & caMatch(birth, sum));
+                    if (w == words - 1) v &= tail;
+                    ca->next[i] = v;
+                    if (v != c) {
+                        caFlag(ca, z, y, w, v ^ c);
+                        changed++;
+                    }
+                }
+        }
+    }
+    ca->cur.swap(ca->next);
+    return changed;
+}
+
+// Writes the chunks changed since the last call back into the grid (new voxels get material 1) and marks
+// them for remeshing, returns the number of chunks written
+static int caStore(CaGrid* ca, VoxelGrid* g, VoxelMesh* mesh)
+{
+    const int n = ca->size, chunks = ca->chunks;
+    std::vector<int> dirty;
+    for (int cz = 0; cz < chunks; cz++)
+        for (int c = 0; c < chunks * chunks; c++)
+            for (int z = cz * CHUNK_SIZE; z < std::min(n, (cz + 1) * CHUNK_SIZE); z++)
+                if (ca->changed[static_cast<size_t>(z) * chunks * chunks + c]) {
+                    dirty.push_back(cz * chunks * chunks + c);
+                    break;
+                }
+
+    const int count = static_cast<int>(dirty.size());
+    // Flags can be stale (a voxel that flipped back), so the written box is what gets remeshed
+    std::vector<VoxelBox> written(count, { INT_MAX, INT_MAX, INT_MAX, INT_MIN, INT_MIN, INT_MIN });
+    #pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < count; i++) {
+        const int index = dirty[i];
+        const int x0 = index % chunks * CHUNK_SIZE, y0 = index / chunks % chunks * CHUNK_SIZE, z0 = index / (chunks * chunks) * CHUNK_SIZE;
+        VoxelBox& b = written[i];
+        for (int z = z0; z < std::min(n, z0 + CHUNK_SIZE); z++)
+        for (int y = y0; y < std::min(n, y0 + CHUNK_SIZE); y++) {
+            const uint64_t* row = &ca->cur[(static_cast<size_t>(z) * n + y) * ca->words];
+            for (int x = x0; x < std::min(n, x0 + CHUNK_SIZE); x++) {
+                const bool bit = row[x >> 6] >> (x & 63) & 1;
+                if (bit == (g->data[z][y][x] != 0)) continue;
+                g->data[z][y][x] = bit ? 1 : 0;
+                b = { std::min(b.x0, x), std::min(b.y0, y), std::min(b.z0, z), std::max(b.x1, x + 1), std::max(b.y1, y + 1), std::max(b.z1, z + 1) };
+            }
+        }
+    }
+
+    int num_written = 0;
+    for (const VoxelBox& b : written) {
+        meshMarkDirty(mesh, b);
+        num_written += !b.empty();
+    }
+    std::fill(ca->changed.begin(), ca->changed.end(), 0);
+    return num_written;
+}
@@ -0,0 +1,156 @@
+#pragma once
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "raster.h"
+#include "image.h"
+
+// HEADLESS BATCH RENDERER
+// voxely batch <poses> <out dir> [--size WxH] [--fov F] [--png] [--aa]
+// Pose file: one view per line "px py pz yaw pitch lx ly lz [ortho_scale]", '#' starts a comment.
+// Views are spread over all cores, each worker owns its framebuffers, the face list is shared read only.
+
+struct BatchPose
+{
+    Vec3 position;
+    float yaw, pitch;
+    Vec3 light_dir;
+    float ortho_scale; // 0 = perspective
+};
+
+struct BatchOptions
+{
+    const char* poses;
+    const char* out_dir;
+    int width, height;
+    float fov;
+    bool png;
+    bool aa;
+};
+
+static bool batchParseArgs(BatchOptions* o, const int argc, char** argv)
+{
+    if (argc < 2) return false;
+    o->poses = argv[0];
+    o->out_dir = argv[1];
+    o->width = 1024;
+    o->height = 768;
+    o->fov = 60.0f;
+    o->png = false;
+    o->aa = false;
+
+    for (int i = 2; i < argc; i++) {
+        if (!strcmp(argv[i], "--png")) o->png = true;
+        else if (!strcmp(argv[i], "--aa")) o->aa = true;
+        else if (!strcmp(argv[i], "--size") && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &o->width, &o->height) != 2) return false;
+        }
+        else if (!strcmp(argv[i], "--fov") && i + 1 < argc) o->fov = static_cast<float>(atof(argv[++i]));
+        else return false;
+    }
+    return o->width > 0 && o->height > 0;
+}
+
+static bool batchLoadPoses(std::vector<BatchPose>* poses, const char* path)
+{
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+
+    char line[512];
+    int line_no = 0;
+    bool ok = true;
+    while (fgets(line, sizeof(line), f)) {
+        line_no++;
+        if (char* hash = strchr(line, '#')) *hash = 0;
+
+        BatchPose p = {};
+        const int n = sscanf(line, "%f %f %f %f %f %f %f %f %f",
+                             &p.position.x, &p.position.y, &p.position.z, &p.yaw, &p.pitch,
+                             &p.light_dir.x, &p.light_dir.y, &p.light_dir.z, &p.ortho_scale);
+        if (n <= 0) continue;
+        if (n < 8) {
+            fprintf(stderr, "%s:%d: expected px py pz yaw pitch lx ly lz [ortho_scale]\n", path, line_no);
+            ok = false;
+            break;
+        }
+        poses->push_back(p);
+    }
+    fclose(f);
+    return ok;
+}
+
+static bool batchRenderView(const BatchOptions* o, const BatchPose& pose, const int index, const RasterBatch* batch, const float half,
+                            Framebuffer* fb, RasterScratch* scratch, uint32_t* aa, std::vector<uint8_t>* encoded)
+{
+    RasterView view;
+    rasterViewFromAngles(&view, pose.position, pose.yaw, pose.pitch, o->fov, half);
+    view.light = dot(pose.light_dir, pose.light_dir) > 0.0f;
+    view.light_dir = view.light ? norm(pose.light_dir) : pose.light_dir;
+    view.ortho = pose.ortho_scale > 0.0f;
+    view.ortho_scale = pose.ortho_scale;
+
+    rasterRender(fb, scratch, batch, 1, &view, 0, fb->height);
+
+    const uint32_t* pixels = fb->color;
+    if (o->aa) {
+        rasterAntiAlias(fb, aa, 0, fb->height, scratch->threads);
+        pixels = aa;
+    }
+
+    if (o->png) encodePNG(encoded, pixels, fb->width, fb->height);
+    else encodePPM(encoded, pixels, fb->width, fb->height);
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/view_%05d.%s", o->out_dir, index, o->png ? "png" : "ppm");
+    if (!writeFile(path, *encoded)) {
+        fprintf(stderr, "failed to write %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+static int batchRender(const int argc, char** argv, const VoxelFace* faces, const int num_faces, const float half)
+{
+    BatchOptions o;
+    if (!batchParseArgs(&o, argc, argv)) {
+        fprintf(stderr, "usage: voxely batch <poses> <out dir> [--size WxH] [--fov F] [--png] [--aa]\n");
+        return 1;
+    }
+
+    std::vector<BatchPose> poses;
+    if (!batchLoadPoses(&poses, o.poses)) {
+        fprintf(stderr, "failed to read poses from %s\n", o.poses);
+        return 1;
+    }
+
+    const RasterBatch batch = { faces, num_faces };
+    const int n = static_cast<int>(poses.size());
+    const size_t pixels = static_cast<size_t>(o.width) * o.height;
+
+    // Fewer views than cores: render them one by one with every thread working on each frame
+    const bool per_view = n >= threadCount();
+    int failed = 0;
+    const double t0 = nowMs();
+
+    #pragma omp parallel reduction(+:failed) if (per_view)
+    {
+        Framebuffer fb;
+        framebufferInit(&fb, o.width, o.height);
+        RasterScratch scratch;
+        scratch.threads = per_view ? 1 : 0;
+        std::vector<uint32_t> aa(o.aa ? pixels : 0);
+        std::vector<uint8_t> encoded;
+
+        #pragma omp for schedule(dynamic)
+        for (int i = 0; i < n; i++)
+            if (!batchRenderView(&o, poses[i], i, &batch, half, &fb, &scratch, aa.data(), &encoded)) failed++;
+
+        framebufferFree(&fb);
+    }
+
+    const double ms = nowMs() - t0;
+    printf("rendered %d views (%dx%d, %d faces) in %.1f ms: %.2f views/s, %d failed\n",
+           n - failed, o.width, o.height, num_faces, ms, n / (ms / 1000.0), failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,539 @@
+#pragma once
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "voxel.h"
+#include "collide.h"
+#include "query.h"
+#include "path.h"
+#include "gen.h"
+#include "store.h"
+#include "graph.h"
+#include "islands.h"
+#include "automata.h"
+#include "parallel.h"
+
+// HEADLESS BENCHMARKS
+// voxely bench [--agents N] [--ticks T] [--queries N] [--paths N] [--path-size N] [--gen-size N]
+// Runs against the default world and prints one line per benchmark. --path-size swaps in a generated
+// terrain of that size for the pathfinding run, --gen-size sets the grid the generators fill.
+// Self checks against plain reference code follow, one pass/fail line each; any failure exits with 1.
+
+struct BenchOptions
+{
+    int agents;
+    int ticks;
+    int queries;
+    int paths;
+    int path_size; // 0 = default world
+    int gen_size;
+};
+
+static bool benchParseArgs(BenchOptions* o, const int argc, char** argv)
+{
+    o->agents = 1000;
+    o->ticks = 600;
+    o->queries = 200000;
+    o->paths = 5000;
+    o->path_size = 0;
+    o->gen_size = GRID_SIZE;
+    for (int i = 0; i < argc; i++) {
+        if (!strcmp(argv[i], "--agents") && i + 1 < argc) o->agents = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--ticks") && i + 1 < argc) o->ticks = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--queries") && i + 1 < argc) o->queries = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--paths") && i + 1 < argc) o->paths = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--path-size") && i + 1 < argc) o->path_size = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--gen-size") && i + 1 < argc) o->gen_size = atoi(argv[++i]);
+        else return false;
+    }
+    return o->agents > 0 && o->ticks > 0 && o->queries > 0 && o->paths > 0 && o->path_size >= 0 && o->gen_size > 0;
+}
+
+// Player sized agents dropped at random points, walking in random directions under gravity
+static void benchCollide(const BenchOptions* o, const VoxelGrid* g)
+{
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<CollideAgent> agents(o->agents);
+    for (CollideAgent& a : agents) {
+        const float x = unit(rng) * g->size, y = unit(rng) * g->size, z = unit(rng) * g->size;
+        a.box = { { x - PLAYER_HALF_WIDTH, y, z - PLAYER_HALF_WIDTH }, { x + PLAYER_HALF_WIDTH, y + PLAYER_HEIGHT, z + PLAYER_HALF_WIDTH } };
+        a.vel[0] = (unit(rng) - 0.5f) * 16.0f;
+        a.vel[1] = 0.0f;
+        a.vel[2] = (unit(rng) - 0.5f) * 16.0f;
+    }
+
+    const float dt = 1.0f / 60.0f;
+    long long blocked = 0;
+    const double t0 = nowMs();
+    for (int t = 0; t < o->ticks; t++) {
+        for (CollideAgent& a : agents) a.vel[1] = std::max(a.vel[1] - PLAYER_GRAVITY * dt, -PLAYER_MAX_FALL);
+        collideMoveAgents(g, agents.data(), o->agents, dt);
+        for (const CollideAgent& a : agents) blocked += a.hit != 0;
+    }
+    const double ms = nowMs() - t0;
+    const double moves = static_cast<double>(o->agents) * o->ticks;
+    printf("collide: %d agents x %d ticks in %.1f ms: %.3f us/move, %.1f%% blocked, %d threads\n",
+           o->agents, o->ticks, ms, ms * 1000.0 / moves, 100.0 * blocked / moves, threadCount());
+}
+
+static void benchReport(const char* name, const int count, const double ms, const int hits)
+{
+    printf("%-10s %d queries in %.1f ms: %.2f M/s, %d hits\n", name, count, ms, count / (ms * 1000.0), hits);
+}
+
+// Random query batches against the pyramid, with the plain grid raycast as a baseline
+static void benchQuery(const BenchOptions* o, const VoxelGrid* g)
+{
+    const int n = o->queries;
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    const float size = static_cast<float>(g->size);
+
+    double t0 = nowMs();
+    QueryWorld w;
+    queryInit(&w, &g->data[0][0][0], g->size);
+    printf("pyramid: %d levels built in %.1f ms\n", static_cast<int>(w.levels.size()), nowMs() - t0);
+
+    std::vector<QueryRay> rays(n);
+    for (QueryRay& r : rays) {
+        const float z = unit(rng) * 2.0f - 1.0f, phi = unit(rng) * 6.2831853f, s = sqrtf(1.0f - z * z);
+        r = { { unit(rng) * size, unit(rng) * size, unit(rng) * size }, { s * cosf(phi), s * sinf(phi), z }, size * 2.0f };
+    }
+    std::vector<QueryHit> hits(n);
+    t0 = nowMs();
+    queryRaycasts(&w, rays.data(), n, hits.data());
+    double ms = nowMs() - t0;
+    int count = 0;
+    for (const QueryHit& h : hits) count += h.hit;
+    benchReport("raycast", n, ms, count);
+
+    count = 0;
+    t0 = nowMs();
+    #pragma omp parallel for schedule(dynamic, 64) reduction(+:count)
+    for (int i = 0; i < n; i++) {
+        int hit[3], normal[3];
+        count += g->raycast(rays[i].origin, rays[i].dir, rays[i].max_dist, hit, normal);
+    }
+    benchReport("grid ray", n, nowMs() - t0, count);
+
+    std::vector<float[6]> boxes(n);
+    for (auto& b : boxes) {
+        const float x = unit(rng) * size, y = unit(rng) * size, z = unit(rng) * size, e = 0.5f + unit(rng) * 4.0f;
+        b[0] = x - e; b[1] = y - e; b[2] = z - e; b[3] = x + e; b[4] = y + e; b[5] = z + e;
+    }
+    std::vector<uint8_t> overlaps(n);
+    t0 = nowMs();
+    queryOverlaps(&w, boxes.data(), n, overlaps.data());
+    ms = nowMs() - t0;
+    count = 0;
+    for (const uint8_t v : overlaps) count += v;
+    benchReport("overlap", n, ms, count);
+
+    std::vector<VoxelBox> regions(n);
+    for (VoxelBox& b : regions) {
+        const int x = static_cast<int>(unit(rng) * size), y = static_cast<int>(unit(rng) * size), z = static_cast<int>(unit(rng) * size);
+        const int e = 1 + static_cast<int>(unit(rng) * 64.0f);
+        b = { x, y, z, x + e, y + e, z + e };
+    }
+    std::vector<uint32_t> counts(n);
+    t0 = nowMs();
+    queryCounts(&w, regions.data(), n, counts.data());
+    ms = nowMs() - t0;
+    count = 0;
+    for (const uint32_t c : counts) count += c != 0;
+    benchReport("count", n, ms, count);
+
+    // Line of sight between observer and target sets, as close to square as the query count allows
+    const int observers = std::max(1, static_cast<int>(sqrtf(static_cast<float>(n)))), targets = std::max(1, n / observers);
+    std::vector<float[3]> eyes(observers), marks(targets);
+    for (auto& p : eyes) {
+        p[0] = unit(rng) * size; p[1] = unit(rng) * size; p[2] = unit(rng) * size;
+    }
+    for (auto& p : marks) {
+        p[0] = unit(rng) * size; p[1] = unit(rng) * size; p[2] = unit(rng) * size;
+    }
+    std::vector<uint64_t> visible(static_cast<size_t>(observers) * queryVisibilityWords(targets));
+    t0 = nowMs();
+    queryVisibility(&w, eyes.data(), observers, marks.data(), targets, visible.data());
+    ms = nowMs() - t0;
+    count = 0;
+    for (const uint64_t v : visible) count += std::popcount(v);
+    benchReport("sight", observers * targets, ms, count);
+
+    std::vector<float[3]> points(n);
+    for (auto& p : points) {
+        p[0] = unit(rng) * size; p[1] = unit(rng) * size; p[2] = unit(rng) * size;
+    }
+    std::vector<QueryNearest> nearest(n);
+    t0 = nowMs();
+    queryNearest(&w, points.data(), n, 32.0f, nearest.data());
+    ms = nowMs() - t0;
+    count = 0;
+    for (const QueryNearest& q : nearest) count += q.found;
+    benchReport("nearest", n, ms, count);
+}
+
+// Rolling terrain with pillars and carved pockets, for pathfinding at sizes beyond the default grid
+static std::vector<uint8_t> benchTerrain(const int n)
+{
+    std::vector<uint8_t> data(static_cast<size_t>(n) * n * n, 0);
+    std::mt19937 rng(11);
+    std::uniform_int_distribution<int> coord(0, n - 1);
+    #pragma omp parallel for
+    for (int z = 0; z < n; z++)
+        for (int x = 0; x < n; x++) {
+            const int h = n / 4 + static_cast<int>(8.0f * sinf(x * 0.07f) + 6.0f * cosf(z * 0.05f) + 3.0f * sinf((x + z) * 0.19f));
+            for (int y = 0; y < std::min(h, n); y++) data[(static_cast<size_t>(z) * n + y) * n + x] = 1;
+        }
+    for (int i = 0; i < n * n / 50; i++) {
+        const int x = coord(rng), z = coord(rng), top = std::min(n / 4 + 8 + static_cast<int>(rng() % 12), n);
+        for (int y = 0; y < top; y++) data[(static_cast<size_t>(z) * n + y) * n + x] = 1;
+    }
+    return data;
+}
+
+// Graph build, random queries through the worker pool, then small edits with incremental updates
+static void benchPath(const BenchOptions* o, const VoxelGrid* g)
+{
+    std::vector<uint8_t> data;
+    const int n = o->path_size ? o->path_size : g->size;
+    if (o->path_size) data = benchTerrain(n);
+    else data.assign(&g->data[0][0][0], &g->data[0][0][0] + static_cast<size_t>(n) * n * n);
+
+    auto* graph = new PathGraph();
+    double t0 = nowMs();
+    pathInit(graph, data.data(), n);
+    printf("path graph: %d^3, %d nodes built in %.1f ms\n", n, static_cast<int>(graph->nodes.size()), nowMs() - t0);
+
+    std::mt19937 rng(3);
+    std::vector<std::pair<PathCell, PathCell>> pairs;
+    for (int i = 0; i < o->paths; i++) {
+        PathCell a, b;
+        if (pathRandomCell(graph, &rng, &a) && pathRandomCell(graph, &rng, &b)) pairs.push_back({ a, b });
+    }
+    auto* service = new PathService();
+    pathServiceStart(service, graph, threadCount());
+    t0 = nowMs();
+    for (const auto& [a, b] : pairs) pathRequest(service, a, b);
+    std::vector<PathResult> results;
+    while (results.size() < pairs.size()) {
+        pathPoll(service, &results);
+        std::this_thread::yield();
+    }
+    const double ms = nowMs() - t0;
+    pathServiceStop(service);
+    delete service;
+    int found = 0;
+    long long cells = 0;
+    for (const PathResult& r : results) {
+        found += r.found;
+        cells += static_cast<long long>(r.cells.size());
+    }
+    printf("paths: %d queries in %.1f ms: %.0f/s, %d found, %.1f cells avg, %d workers\n", static_cast<int>(pairs.size()), ms,
+           pairs.size() / (ms / 1000.0), found, found ? static_cast<double>(cells) / found : 0.0, threadCount());
+
+    const int edits = 32;
+    std::uniform_int_distribution<int> coord(0, n - 9);
+    t0 = nowMs();
+    for (int e = 0; e < edits; e++) {
+        const int x = coord(rng), y = coord(rng) % std::max(n / 2 - 8, 1), z = coord(rng);
+        const uint8_t v = static_cast<uint8_t>(e & 1);
+        for (int zz = z; zz < z + 8; zz++)
+            for (int yy = y; yy < y + 8; yy++)
+                for (int xx = x; xx < x + 8; xx++) data[(static_cast<size_t>(zz) * n + yy) * n + xx] = v;
+        pathMarkDirty(graph, { x, y, z, x + 8, y + 8, z + 8 });
+        pathUpdate(graph, data.data());
+    }
+    printf("path edits: %d 8^3 boxes, %.2f ms per update\n", edits, (nowMs() - t0) / edits);
+    delete graph;
+}
+
+// Sponge noise samples every voxel, the coarse lattices every step^3 voxels
+static void benchGen(const VoxelGrid* g)
+{
+    const int n = g->size;
+    auto* grid = new VoxelGrid();
+    grid->init();
+    double t0 = nowMs();
+    grid->setRandomNoiseSponge();
+    const double sponge_ms = nowMs() - t0;
+    const size_t total = static_cast<size_t>(n) * n * n;
+    printf("gen sponge: %d^3 in %.1f ms, %zu 3D samples\n", n, sponge_ms, total);
+
+    // Coarse lattices against the exact sponge: all voxels compared, field error from the sampled check
+    const std::vector<uint8_t> exact(&grid->data[0][0][0], &grid->data[0][0][0] + total);
+    for (int step = 2; step <= 4; step++) {
+        t0 = nowMs();
+        const long long lattice = genSpongeCoarse(grid, step);
+        const double ms = nowMs() - t0;
+        long long flipped = 0;
+        for (size_t i = 0; i < total; i++) flipped += (&grid->data[0][0][0])[i] != exact[i];
+        GenError err;
+        genSpongeCoarse(grid, step, &err);
+        printf("gen coarse %d: %.1f ms (%.1fx), %lld samples, max field error %.4f, %.3f%% voxels flipped\n", step, ms,
+               sponge_ms / ms, lattice, err.max_abs, 100.0 * flipped / total);
+    }
+
+    delete grid;
+}
+
+static void benchGenReport(const char* name, const int n, const double ms, const uint8_t* data)
+{
+    const size_t total = static_cast<size_t>(n) * n * n;
+    long long solid = 0;
+    #pragma omp parallel for reduction(+:solid)
+    for (long long i = 0; i < static_cast<long long>(total); i++) solid += data[i] != 0;
+    printf("gen %-8s %d^3 in %.1f ms: %.1f Mvoxels/s, %.1f%% solid\n", name, n, ms, total / (ms * 1000.0), 100.0 * solid / total);
+}
+
+// The generators that fill any grid size
+static void benchGenerators(const BenchOptions* o)
+{
+    const int n = o->gen_size;
+    std::vector<uint8_t> data(static_cast<size_t>(n) * n * n);
+
+    const GenTerrain terrain = genDefaultTerrain();
+    double t0 = nowMs();
+    genTerrain(&terrain, data.data(), n);
+    benchGenReport("terrain", n, nowMs() - t0, data.data());
+
+    const GenWorley worley = genDefaultWorley();
+    t0 = nowMs();
+    genWorley(&worley, data.data(), n);
+    benchGenReport("worley", n, nowMs() - t0, data.data());
+
+    const GenWarp warp = genDefaultWarp();
+    t0 = nowMs();
+    genWarped(&warp, data.data(), n);
+    benchGenReport("warp", n, nowMs() - t0, data.data());
+
+    // The default graph cold, again with every field cached, then after moving the cave threshold
+    auto* graph = new GeneratorGraph();
+    graphInit(graph);
+    graphDefault(graph);
+    graphCompile(graph, n);
+    const char* runs[] = { "graph", "graph warm", "graph edit" };
+    for (int r = 0; r < 3; r++) {
+        if (r == 2) {
+            graph->nodes[7].a += 0.1f;
+            graphCompile(graph, n);
+        }
+        const long long misses = graph->misses;
+        t0 = nowMs();
+        graphFill(graph, data.data(), n);
+        benchGenReport(runs[r], n, nowMs() - t0, data.data());
+        printf("    %lld fields computed, %d cached\n", graph->misses - misses, static_cast<int>(graph->cache.size()));
+    }
+    delete graph;
+}
+
+// A point wandering across a world far larger than memory, reading voxels around it through the store
+static void benchStore(const BenchOptions* o)
+{
+    auto* s = new ChunkStore();
+    storeInit(s, genDefaultTerrain(), 256, 4096);
+    std::mt19937 rng(9);
+    std::uniform_int_distribution<int> near(-48, 48);
+    const int n = o->queries;
+    float pos[3] = { 0.0f, 96.0f, 0.0f };
+    long long solid = 0;
+    const double t0 = nowMs();
+    for (int i = 0; i < n; i++) {
+        pos[0] += 0.05f;
+        pos[2] += 0.02f;
+        solid += storeAt(s, static_cast<int>(pos[0]) + near(rng), static_cast<int>(pos[1]) + near(rng), static_cast<int>(pos[2]) + near(rng)) != 0;
+    }
+    const double ms = nowMs() - t0;
+    int uniform = 0;
+    for (const auto& [key, slot] : s->index) uniform += s->slots[slot].voxels.empty();
+    printf("store: %d lookups over %.0f voxels in %.1f ms, %lld generated, %lld evicted, %d resident (%d uniform), %.1f%% hits, %.1f%% solid\n",
+           n, pos[0], ms, s->generated, s->evicted, static_cast<int>(s->index.size()), uniform, 100.0 * s->hits / n, 100.0 * solid / n);
+    delete s;
+}
+
+// SELF CHECKS
+
+static bool benchCheckReport(const char* name, const char* against, const long long mismatches, const long long total)
+{
+    printf("check %-8s against %s: %s, %lld of %lld differ\n", name, against, mismatches ? "FAIL" : "pass", mismatches, total);
+    return !mismatches;
+}
+
+// Voxels whose island, as labeled by m, does not match a plain stack flood fill (same component <-> same island)
+static long long benchIslandsMismatch(const IslandMap* m, const uint8_t* data, const int n)
+{
+    const size_t total = static_cast<size_t>(n) * n * n;
+    std::vector<int> label(total, -1), island;
+    std::vector<size_t> stack;
+    long long bad = 0;
+    for (size_t s = 0; s < total; s++) {
+        if (!data[s] || label[s] >= 0) continue;
+        const int k = static_cast<int>(island.size());
+        island.push_back(-1);
+        label[s] = k;
+        stack.push_back(s);
+        while (!stack.empty()) {
+            const size_t i = stack.back();
+            stack.pop_back();
+            const int x = static_cast<int>(i % n), y = static_cast<int>(i / n % n), z = static_cast<int>(i / (static_cast<size_t>(n) * n));
+            const int id = islandAt(m, x, y, z);
+            if (island[k] < 0) island[k] = id;
+            bad += id < 0 || id != island[k];
+            const int next[6][3] = { {x-1,y,z}, {x+1,y,z}, {x,y-1,z}, {x,y+1,z}, {x,y,z-1}, {x,y,z+1} };
+            for (const auto& q : next) {
+                if (q[0] < 0 || q[1] < 0 || q[2] < 0 || q[0] >= n || q[1] >= n || q[2] >= n) continue;
+                const size_t j = (static_cast<size_t>(q[2]) * n + q[1]) * n + q[0];
+                if (data[j] && label[j] < 0) {
+                    label[j] = k;
+                    stack.push_back(j);
+                }
+            }
+        }
+    }
+    // Two components sharing an island id
+    std::vector<int> owner(m->islands.size(), 0);
+    for (const int id : island)
+        if (id >= 0) bad += owner[id]++ > 0;
+    return bad;
+}
+
+// Labels the default world, then again incrementally after carving it up
+static bool benchCheckIslands(const VoxelGrid* g)
+{
+    const int n = g->size;
+    std::vector<uint8_t> data(&g->data[0][0][0], &g->data[0][0][0] + static_cast<size_t>(n) * n * n);
+    auto* m = new IslandMap();
+    islandsInit(m, data.data(), n);
+    long long bad = benchIslandsMismatch(m, data.data(), n);
+    std::mt19937 rng(17);
+    for (int i = 0; i < 24; i++) {
+        const int c[3] = { static_cast<int>(rng() % n), static_cast<int>(rng() % n), static_cast<int>(rng() % n) }, e = 4 + static_cast<int>(rng() % 12);
+        const VoxelBox box = { std::max(c[0] - e, 0), std::max(c[1] - e, 0), std::max(c[2] - e, 0), std::min(c[0] + e, n), std::min(c[1] + e, n), std::min(c[2] + e, n) };
+        const uint8_t value = i % 3 ? 0 : 1;
+        for (int z = box.z0; z < box.z1; z++)
+            for (int y = box.y0; y < box.y1; y++) memset(&data[(static_cast<size_t>(z) * n + y) * n + box.x0], value, box.x1 - box.x0);
+        islandsMarkDirty(m, box);
+    }
+    islandsUpdate(m, data.data());
+    bad += benchIslandsMismatch(m, data.data(), n);
+    delete m;
+    return benchCheckReport("islands", "a flood fill", bad, 2ll * n * n * n);
+}
+
+// Three generations of every rule on random occupancy, against a direct count of the 26 neighbours. The size
+// is not a multiple of 64, so the partial last word of each row is covered.
+static bool benchCheckAutomata()
+{
+    constexpr int n = 70;
+    const auto at = [](const std::vector<uint8_t>& d, const int x, const int y, const int z) {
+        return x < 0 || y < 0 || z < 0 || x >= n || y >= n || z >= n ? 0 : d[(static_cast<size_t>(z) * n + y) * n + x];
+    };
+    std::mt19937 rng(5);
+    std::vector<uint8_t> start(static_cast<size_t>(n) * n * n);
+    for (uint8_t& v : start) v = rng() % 100 < 45;
+    long long bad = 0, total = 0;
+    auto* ca = new CaGrid();
+    for (const CaRule& rule : kCaRules) {
+        caInit(ca, n);
+        caLoad(ca, start.data());
+        std::vector<uint8_t> ref = start, next(ref.size());
+        for (int gen = 0; gen < 3; gen++) {
+            caStep(ca, rule);
+            for (int z = 0; z < n; z++)
+                for (int y = 0; y < n; y++)
+                    for (int x = 0; x < n; x++) {
+                        const int c = at(ref, x, y, z);
+                        int v;
+                        if (rule.sand) v = (c && (y == 0 || at(ref, x, y - 1, z))) || (!c && at(ref, x, y + 1, z));
+                        else {
+                            int k = 0;
+                            for (int dz = -1; dz <= 1; dz++)
+                                for (int dy = -1; dy <= 1; dy++)
+                                    for (int dx = -1; dx <= 1; dx++) k += (dx || dy || dz) && at(ref, x + dx, y + dy, z + dz);
+                            v = (c ? rule.survive : rule.birth) >> k & 1;
+                        }
+                        next[(static_cast<size_t>(z) * n + y) * n + x] = static_cast<uint8_t>(v);
+                    }
+            ref.swap(next);
+        }
+        for (int z = 0; z < n; z++)
+            for (int y = 0; y < n; y++)
+                for (int x = 0; x < n; x++) {
+                    const bool bit = ca->cur[(static_cast<size_t>(z) * n + y) * ca->words + x / 64] >> (x % 64) & 1;
+                    bad += bit != (ref[(static_cast<size_t>(z) * n + y) * n + x] != 0);
+                }
+        total += static_cast<long long>(n) * n * n;
+    }
+    delete ca;
+    return benchCheckReport("automata", "direct neighbour counts", bad, total);
+}
+
+// The node formulas evaluated recursively per voxel, with no caching, lattices or fusing
+static float benchGraphNaive(const GeneratorGraph* g, const int v, const int x, const int y, const int z)
+{
+    const GraphNode& n = g->nodes[v];
+    const auto in = [&](const int k) { return benchGraphNaive(g, n.in[k], x, y, z); };
+    switch (n.op) {
+        case GRAPH_CONST: return n.a;
+        case GRAPH_HEIGHT: return (n.a - static_cast<float>(y) / static_cast<float>(g->scale)) * n.b;
+        case GRAPH_NOISE: {
+            const float dx = n.in[0] >= 0 ? n.b * in(0) : 0.0f, dy = n.in[1] >= 0 ? n.b * in(1) : 0.0f, dz = n.in[2] >= 0 ? n.b * in(2) : 0.0f;
+            const float inv = 1.0f / n.a;
+            return 2.0f * genFbm3((x + dx) * inv, (y + dy) * inv, (z + dz) * inv, n.seed, n.octaves) - 1.0f;
+        }
+        case GRAPH_ADD: return in(0) + in(1);
+        case GRAPH_MUL: return in(0) * in(1);
+        case GRAPH_THRESHOLD: return in(0) - n.a;
+        case GRAPH_UNION: return std::max(in(0), in(1));
+        case GRAPH_INTERSECT: return std::min(in(0), in(1));
+        case GRAPH_SUBTRACT: return std::min(in(0), -in(1));
+        case GRAPH_MATERIAL: return in(0) > 0.0f ? n.a : (n.in[1] >= 0 ? in(1) : 0.0f);
+        default: return 0.0f;
+    }
+}
+
+// The default graph with every noise node on a step 1 lattice, so the compiled fill has to match exactly
+static bool benchCheckGraph()
+{
+    constexpr int n = 40;
+    auto* g = new GeneratorGraph();
+    graphInit(g);
+    graphDefault(g);
+    for (GraphNode& node : g->nodes)
+        if (node.op == GRAPH_NOISE) node.step = 1;
+    long long bad = 0;
+    std::vector<uint8_t> data(static_cast<size_t>(n) * n * n);
+    if (graphCompile(g, n)) {
+        graphFill(g, data.data(), n);
+        for (int z = 0; z < n; z++)
+            for (int y = 0; y < n; y++)
+                for (int x = 0; x < n; x++)
+                    bad += data[(static_cast<size_t>(z) * n + y) * n + x] != static_cast<uint8_t>(benchGraphNaive(g, g->output, x, y, z));
+    }
+    else bad = static_cast<long long>(data.size());
+    delete g;
+    return benchCheckReport("graph", "a naive evaluator", bad, static_cast<long long>(data.size()));
+}
+
+static int benchRun(const int argc, char** argv, const VoxelGrid* g)
+{
+    BenchOptions o;
+    if (!benchParseArgs(&o, argc, argv)) {
+        fprintf(stderr, "usage: voxely bench [--agents N] [--ticks T] [--queries N] [--paths N] [--path-size N] [--gen-size N]\n");
+        return 1;
+    }
+    benchCollide(&o, g);
+    benchQuery(&o, g);
+    benchPath(&o, g);
+    benchGen(g);
+    benchGenerators(&o);
+    benchStore(&o);
+    bool ok = true;
+    ok &= benchCheckIslands(g);
+    ok &= benchCheckAutomata();
+    ok &= benchCheckGraph();
+    return ok ? 0 : 1;
+}
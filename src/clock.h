@@ -0,0 +1,53 @@
+#pragma once
+#include <algorithm>
+
+// SIMULATION CLOCK
+// Fixed timestep accumulator: frame time goes in, whole ticks of 1/hz come out, and the leftover fraction
+// of a tick is the blend factor between the last two simulated states for display. After a long frame at
+// most max_steps ticks run and the rest of the backlog is dropped, so a slow simulation falls behind real
+// time instead of spiralling.
+
+#define CLOCK_DEFAULT_HZ 60
+#define CLOCK_DEFAULT_MAX_STEPS 8
+
+struct SimClock
+{
+    int hz;
+    int max_steps;
+    double accum;      // seconds not yet simulated
+    float alpha;       // blend from the previous tick to the current one
+    int steps;         // ticks run on the last advance
+    long long dropped; // ticks skipped by the catch-up cap, total
+};
+
+static void clockInit(SimClock* c, const int hz = CLOCK_DEFAULT_HZ, const int max_steps = CLOCK_DEFAULT_MAX_STEPS)
+{
+    c->hz = hz;
+    c->max_steps = max_steps;
+    c->accum = 0.0;
+    c->alpha = 0.0f;
+    c->steps = 0;
+    c->dropped = 0;
+}
+
+static float clockDt(const SimClock* c)
+{
+    return 1.0f / static_cast<float>(c->hz);
+}
+
+// Adds a frame of seconds and returns how many ticks to run now
+static int clockAdvance(SimClock* c, const double seconds)
+{
+    const double dt = 1.0 / c->hz;
+    c->accum += std::max(seconds, 0.0);
+    int steps = static_cast<int>(c->accum / dt);
+    if (steps > c->max_steps) {
+        c->dropped += steps - c->max_steps;
+        steps = c->max_steps;
+        c->accum = 0.0;
+    }
+    else c->accum -= dt * steps;
+    c->alpha = static_cast<float>(std::clamp(c->accum / dt, 0.0, 1.0));
+    c->steps = steps;
+    return steps;
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include "voxel.h"
+
+// COLLISION
+// Axis aligned boxes in voxel coordinates, moved against the grid one axis at a time (Y, X, then Z). A move
+// along an axis only visits the voxel layers its leading face sweeps through, inside the box's footprint on
+// the other two axes, so the cost follows distance times footprint and never the box volume. A box that
+// already overlaps voxels can still move out of them. Below the grid counts as solid ground, the other
+// sides are open.
+
+#define COLLIDE_SKIN 1e-3f // gap kept to a blocking face
+
+#define PLAYER_HALF_WIDTH 0.4f
+#define PLAYER_HEIGHT 1.8f
+#define PLAYER_EYE 1.6f
+#define PLAYER_GRAVITY 30.0f
+#define PLAYER_JUMP 9.0f
+#define PLAYER_MAX_FALL 50.0f
+
+struct CollideBox
+{
+    float min[3], max[3];
+};
+
+struct CollideAgent
+{
+    CollideBox box;
+    float vel[3];
+    uint8_t hit; // bit per axis that was blocked on the last move
+};
+
+struct Player
+{
+    float pos[3]; // feet center
+    float vel[3];
+    bool grounded;
+};
+
+static bool collideSolid(const VoxelGrid* g, const int x, const int y, const int z)
+{
+    return y < 0 || g->at(x, y, z);
+}
+
+// How far the box can move along axis, up to delta, before its leading face reaches a solid voxel
+static float collideSweep(const VoxelGrid* g, const CollideBox& b, const int axis, const float delta)
+{
+    if (delta == 0.0f) return 0.0f;
+    const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+    const int u0 = static_cast<int>(floorf(b.min[u])), u1 = static_cast<int>(ceilf(b.max[u])) - 1;
+    const int v0 = static_cast<int>(floorf(b.min[v])), v1 = static_cast<int>(ceilf(b.max[v])) - 1;
+
+    const auto blocked = [&](const int layer) {
+        int c[3];
+        c[axis] = layer;
+        for (c[v] = v0; c[v] <= v1; c[v]++)
+            for (c[u] = u0; c[u] <= u1; c[u]++)
+                if (collideSolid(g, c[0], c[1], c[2])) return true;
+        return false;
+    };
+
+    if (delta > 0.0f) {
+        const int first = static_cast<int>(ceilf(b.max[axis])), last = static_cast<int>(ceilf(b.max[axis] + delta)) - 1;
+        for (int layer = first; layer <= last; layer++)
+            if (blocked(layer)) return std::max(0.0f, layer - b.max[axis] - COLLIDE_SKIN);
+    } else {
+        const int first = static_cast<int>(floorf(b.min[axis])) - 1, last = static_cast<int>(floorf(b.min[axis] + delta));
+        for (int layer = first; layer >= last; layer--)
+            if (blocked(layer)) return std::min(0.0f, layer + 1 - b.min[axis] + COLLIDE_SKIN);
+    }
+    return delta;
+}
+
+// Moves the box by delta, stopping each axis at the first solid voxel; returns the blocked axes as bits
+static uint8_t collideMove(const VoxelGrid* g, CollideBox* b, const float delta[3])
+{
+    static const int kOrder[3] = { 1, 0, 2 };
+    uint8_t hit = 0;
+    for (const int axis : kOrder) {
+        const float d = collideSweep(g, *b, axis, delta[axis]);
+        if (d != delta[axis]) hit |= static_cast<uint8_t>(1 << axis);
+        b->min[axis] += d;
+        b->max[axis] += d;
+    }
+    return hit;
+}
+
+// Moves every agent by its velocity for dt, zeroing the velocity along blocked axes. Agents only read the
+// grid, so they are spread over all threads.
+static void collideMoveAgents(const VoxelGrid* g, CollideAgent* agents, const int count, const float dt)
+{
+    #pragma omp parallel for schedule(static, 64)
+    for (int i = 0; i < count; i++) {
+        CollideAgent& a = agents[i];
+        const float delta[3] = { a.vel[0] * dt, a.vel[1] * dt, a.vel[2] * dt };
+        a.hit = collideMove(g, &a.box, delta);
+        for (int axis = 0; axis < 3; axis++)
+            if (a.hit >> axis & 1) a.vel[axis] = 0.0f;
+    }
+}
+
+static CollideBox playerBox(const Player* p)
+{
+    return { { p->pos[0] - PLAYER_HALF_WIDTH, p->pos[1], p->pos[2] - PLAYER_HALF_WIDTH },
+             { p->pos[0] + PLAYER_HALF_WIDTH, p->pos[1] + PLAYER_HEIGHT, p->pos[2] + PLAYER_HALF_WIDTH } };
+}
+
+// Walks with horizontal velocity (wish_x, wish_z) under gravity. Walking into a ledge while on the
+// ground jumps, so one voxel steps can be climbed without a jump key.
+static void playerStep(Player* p, const VoxelGrid* g, const float wish_x, const float wish_z, const float dt)
+{
+    p->vel[0] = wish_x;
+    p->vel[2] = wish_z;
+    p->vel[1] = std::max(p->vel[1] - PLAYER_GRAVITY * dt, -PLAYER_MAX_FALL);
+
+    CollideBox box = playerBox(p);
+    const float delta[3] = { p->vel[0] * dt, p->vel[1] * dt, p->vel[2] * dt };
+    const uint8_t hit = collideMove(g, &box, delta);
+    p->pos[0] = (box.min[0] + box.max[0]) * 0.5f;
+    p->pos[1] = box.min[1];
+    p->pos[2] = (box.min[2] + box.max[2]) * 0.5f;
+
+    const bool was_grounded = p->grounded;
+    p->grounded = (hit & 2) && p->vel[1] < 0.0f;
+    if (hit & 2) p->vel[1] = 0.0f;
+    if (was_grounded && (hit & 5)) p->vel[1] = PLAYER_JUMP;
+}
@@ -0,0 +1,167 @@
+#pragma once
+#include <climits>
+#include <cmath>
+#include <vector>
+#include "voxel.h"
+#include "mesh.h"
+
+// CSG EDITS
+// Signed distance primitives in a local unit frame, placed with an affine transform (position, yaw/pitch/roll
+// in degrees, per-axis scale) and combined with the grid by union, subtract or intersect. Edits are queued in
+// a CsgBatch; csgApply bins them by chunk, applies every touched chunk once (in parallel, edits in queue order
+// so the result matches applying them one by one) and marks only the voxels that changed for remeshing.
+
+enum CsgShape : uint8_t { CSG_SPHERE, CSG_BOX, CSG_CYLINDER, CSG_TORUS };
+enum CsgOp : uint8_t { CSG_UNION, CSG_SUBTRACT, CSG_INTERSECT };
+
+struct CsgEdit
+{
+    float inv[12];   // voxel -> local, row major 3x4
+    float thickness; // torus minor radius in local units
+    VoxelBox box;    // voxels the shape can cover (whole grid for intersect)
+    uint8_t shape;
+    uint8_t op;
+    uint8_t material;
+};
+
+struct CsgBatch
+{
+    std::vector<CsgEdit> edits;
+    std::vector<std::vector<int>> bins; // edit indices per chunk, CHUNKS^3
+    std::vector<int> touched;           // chunks with a non-empty bin
+};
+
+// Sign of the local unit shape: true strictly inside
+static bool csgInside(const uint8_t shape, const float x, const float y, const float z, const float thickness)
+{
+    switch (shape) {
+        case CSG_SPHERE: return x*x + y*y + z*z < 1.0f;
+        case CSG_BOX: return fabsf(x) < 1.0f && fabsf(y) < 1.0f && fabsf(z) < 1.0f;
+        case CSG_CYLINDER: return x*x + z*z < 1.0f && fabsf(y) < 1.0f;
+        case CSG_TORUS: {
+            const float q = sqrtf(x*x + z*z) - 1.0f;
+            return q*q + y*y < thickness*thickness;
+        }
+        default: return false;
+    }
+}
+
+static CsgEdit csgEdit(const uint8_t shape, const uint8_t op, const uint8_t material, const float pos[3], const float rot[3], const float scale[3], const float thickness = 0.25f)
+{
+    CsgEdit e = {};
+    e.shape = shape;
+    e.op = op;
+    e.material = op == CSG_SUBTRACT ? 0 : material;
+    e.thickness = thickness;
+
+    // R = Ry(yaw) * Rx(pitch) * Rz(roll)
+    const float d2r = 3.14159265f / 180.0f;
+    const float cy = cosf(rot[0] * d2r), sy = sinf(rot[0] * d2r);
+    const float cp = cosf(rot[1] * d2r), sp = sinf(rot[1] * d2r);
+    const float cr = cosf(rot[2] * d2r), sr = sinf(rot[2] * d2r);
+    const float R[3][3] = {
+        { cy*cr + sy*sp*sr, -cy*sr + sy*sp*cr, sy*cp },
+        { cp*sr,            cp*cr,             -sp   },
+        { -sy*cr + cy*sp*sr, sy*sr + cy*sp*cr, cy*cp },
+    };
+
+    // Inverse of T * R * S is S^-1 * R^T * (p - T)
+    for (int i = 0; i < 3; i++) {
+        const float s = 1.0f / scale[i];
+        e.inv[i*4 + 0] = R[0][i] * s;
+        e.inv[i*4 + 1] = R[1][i] * s;
+        e.inv[i*4 + 2] = R[2][i] * s;
+        e.inv[i*4 + 3] = -(R[0][i]*pos[0] + R[1][i]*pos[1] + R[2][i]*pos[2]) * s;
+    }
+
+    if (op == CSG_INTERSECT) {
+        e.box = { 0, 0, 0, GRID_SIZE, GRID_SIZE, GRID_SIZE };
+        return e;
+    }
+
+    // World bounds of the local AABB: half extents through |R * S|
+    const float ext[3] = { shape == CSG_TORUS ? 1.0f + thickness : 1.0f, shape == CSG_TORUS ? thickness : 1.0f, shape == CSG_TORUS ? 1.0f + thickness : 1.0f };
+    float half[3];
+    for (int i = 0; i < 3; i++)
+        half[i] = fabsf(R[i][0]) * scale[0] * ext[0] + fabsf(R[i][1]) * scale[1] * ext[1] + fabsf(R[i][2]) * scale[2] * ext[2];
+    e.box = VoxelGrid::bounds(pos[0] - half[0], pos[1] - half[1], pos[2] - half[2], pos[0] + half[0], pos[1] + half[1], pos[2] + half[2]);
+    return e;
+}
+
+static void csgPush(CsgBatch* batch, const CsgEdit& e)
+{
+    batch->edits.push_back(e);
+}
+
+// Applies one edit to the part of its box inside chunk box c, grows dirty by the voxels that changed
+static void csgApplyChunk(VoxelGrid* g, const CsgEdit& e, const VoxelBox& c, VoxelBox* dirty)
+{
+    const VoxelBox b = { std::max(e.box.x0, c.x0), std::max(e.box.y0, c.y0), std::max(e.box.z0, c.z0),
+                         std::min(e.box.x1, c.x1), std::min(e.box.y1, c.y1), std::min(e.box.z1, c.z1) };
+    if (b.empty()) return;
+
+    const float* m = e.inv;
+    for (int z = b.z0; z < b.z1; z++)
+    for (int y = b.y0; y < b.y1; y++) {
+        // Local position steps by the first matrix column along the row
+        float lx = m[0]*b.x0 + m[1]*y + m[2]*z + m[3];
+        float ly = m[4]*b.x0 + m[5]*y + m[6]*z + m[7];
+        float lz = m[8]*b.x0 + m[9]*y + m[10]*z + m[11];
+        uint8_t* row = g->data[z][y];
+        int first = b.x1, last = b.x0 - 1;
+        for (int x = b.x0; x < b.x1; x++, lx += m[0], ly += m[4], lz += m[8]) {
+            const bool inside = csgInside(e.shape, lx, ly, lz, e.thickness);
+            uint8_t v = row[x];
+            if (e.op == CSG_INTERSECT) { if (!inside) v = 0; }
+            else if (inside) v = e.material;
+            if (v == row[x]) continue;
+            row[x] = v;
+            first = std::min(first, x);
+            last = x;
+        }
+        if (first > last) continue;
+        *dirty = { std::min(dirty->x0, first), std::min(dirty->y0, y), std::min(dirty->z0, z),
+                   std::max(dirty->x1, last + 1), std::max(dirty->y1, y + 1), std::max(dirty->z1, z + 1) };
+    }
+}
+
+// Applies and clears the queue, marks changed chunks dirty, returns the number of changed chunks
+static int csgApply(CsgBatch* batch, VoxelGrid* g, VoxelMesh* mesh)
+{
+    if (batch->edits.empty()) return 0;
+    if (batch->bins.empty()) batch->bins.resize(CHUNKS * CHUNKS * CHUNKS);
+
+    for (int i = 0; i < static_cast<int>(batch->edits.size()); i++) {
+        const VoxelBox b = g->clip(batch->edits[i].box);
+        if (b.empty()) continue;
+        for (int cz = b.z0 / CHUNK_SIZE; cz <= (b.z1 - 1) / CHUNK_SIZE; cz++)
+        for (int cy = b.y0 / CHUNK_SIZE; cy <= (b.y1 - 1) / CHUNK_SIZE; cy++)
+        for (int cx = b.x0 / CHUNK_SIZE; cx <= (b.x1 - 1) / CHUNK_SIZE; cx++) {
+            std::vector<int>& bin = batch->bins[meshChunkIndex(cx, cy, cz)];
+            if (bin.empty()) batch->touched.push_back(meshChunkIndex(cx, cy, cz));
+            bin.push_back(i);
+        }
+    }
+
+    const int count = static_cast<int>(batch->touched.size());
+    std::vector<VoxelBox> dirty(count, { INT_MAX, INT_MAX, INT_MAX, INT_MIN, INT_MIN, INT_MIN });
+    #pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < count; i++) {
+        const int index = batch->touched[i];
+        const int x0 = index % CHUNKS * CHUNK_SIZE, y0 = index / CHUNKS % CHUNKS * CHUNK_SIZE, z0 = index / (CHUNKS * CHUNKS) * CHUNK_SIZE;
+        const VoxelBox c = g->clip({ x0, y0, z0, x0 + CHUNK_SIZE, y0 + CHUNK_SIZE, z0 + CHUNK_SIZE });
+        for (const int e : batch->bins[index]) csgApplyChunk(g, batch->edits[e], c, &dirty[i]);
+    }
+
+    int num_changed = 0;
+    for (int i = 0; i < count; i++) {
+        if (!dirty[i].empty()) {
+            meshMarkDirty(mesh, dirty[i]);
+            num_changed++;
+        }
+        batch->bins[batch->touched[i]].clear();
+    }
+    batch->touched.clear();
+    batch->edits.clear();
+    return num_changed;
+}
@@ -0,0 +1,267 @@
+#pragma once
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "voxel.h"
+#include "raster.h"
+#include "mesh.h"
+#include "islands.h"
+
+// VOXEL DEBRIS
+// Islands that hang free (not the largest one, not resting on y = 0) are cut out of the grid into rigid
+// bodies with their own small voxel grid. A body is meshed once in its local space; per frame only its
+// transform changes, which the voxel rasterizer takes per batch and the triangle path applies when it
+// rewrites the body's model. Bodies fall under gravity and collide their surface voxels against the world
+// (below y = 0 counts as ground), then go to sleep once they stop moving.
+
+#define DEBRIS_MAX_VOXELS 32768
+#define DEBRIS_GRAVITY 60.0f // voxels / s^2
+#define DEBRIS_BOUNCE 0.25f
+#define DEBRIS_FRICTION 0.8f
+
+struct DebrisBody
+{
+    int sx, sy, sz;
+    std::vector<uint8_t> voxels;  // local grid, x fastest
+    std::vector<VoxelFace> faces; // exposed faces in local coordinates
+    std::vector<float> hull;      // surface voxel centers relative to the center of mass, xyz
+    float center[3];              // center of mass, local coordinates
+    float pos[3];                 // center of mass, grid voxel coordinates
+    float vel[3];
+    float rot[4];                 // orientation quaternion w, x, y, z
+    float spin[3];                // angular velocity, rad/s
+    float transform[12];          // local -> grid voxel coordinates, row major 3x4
+    Model model;                  // world space triangles for the wrapper path
+    int still;                    // consecutive steps below the sleep threshold
+    bool asleep;
+};
+
+struct DebrisWorld
+{
+    std::vector<DebrisBody> bodies;
+};
+
+static void debrisRotation(const float q[4], float R[9])
+{
+    const float w = q[0], x = q[1], y = q[2], z = q[3];
+    R[0] = 1 - 2*(y*y + z*z); R[1] = 2*(x*y - w*z);     R[2] = 2*(x*z + w*y);
+    R[3] = 2*(x*y + w*z);     R[4] = 1 - 2*(x*x + z*z); R[5] = 2*(y*z - w*x);
+    R[6] = 2*(x*z - w*y);     R[7] = 2*(y*z + w*x);     R[8] = 1 - 2*(x*x + y*y);
+}
+
+static bool debrisSolid(const VoxelGrid* g, const float x, const float y, const float z)
+{
+    if (y < 0.0f) return true;
+    return g->at(static_cast<int>(floorf(x)), static_cast<int>(floorf(y)), static_cast<int>(floorf(z)));
+}
+
+static bool debrisCollides(const DebrisBody* b, const VoxelGrid* g, const float pos[3], const float R[9])
+{
+    const float* h = b->hull.data();
+    for (size_t i = 0; i < b->hull.size(); i += 3) {
+        const float x = R[0]*h[i] + R[1]*h[i + 1] + R[2]*h[i + 2] + pos[0];
+        const float y = R[3]*h[i] + R[4]*h[i + 1] + R[5]*h[i + 2] + pos[1];
+        const float z = R[6]*h[i] + R[7]*h[i + 1] + R[8]*h[i + 2] + pos[2];
+        if (debrisSolid(g, x, y, z)) return true;
+    }
+    return false;
+}
+
+static void debrisUpdateTransform(DebrisBody* b)
+{
+    float R[9];
+    debrisRotation(b->rot, R);
+    for (int i = 0; i < 3; i++) {
+        b->transform[i*4 + 0] = R[i*3 + 0];
+        b->transform[i*4 + 1] = R[i*3 + 1];
+        b->transform[i*4 + 2] = R[i*3 + 2];
+        b->transform[i*4 + 3] = b->pos[i] - (R[i*3]*b->center[0] + R[i*3 + 1]*b->center[1] + R[i*3 + 2]*b->center[2]);
+    }
+}
+
+// Faces and collision hull from the local grid
+static void debrisBuild(DebrisBody* b)
+{
+    const int offsets[6][3] = { {-1,0,0}, {1,0,0}, {0,-1,0}, {0,1,0}, {0,0,-1}, {0,0,1} };
+    const auto at = [b](const int x, const int y, const int z) {
+        if (x < 0 || y < 0 || z < 0 || x >= b->sx || y >= b->sy || z >= b->sz) return static_cast<uint8_t>(0);
+        return b->voxels[(static_cast<size_t>(z) * b->sy + y) * b->sx + x];
+    };
+
+    b->faces.clear();
+    b->hull.clear();
+    for (int z = 0; z < b->sz; z++)
+    for (int y = 0; y < b->sy; y++)
+    for (int x = 0; x < b->sx; x++) {
+        const uint8_t material = at(x, y, z);
+        if (!material) continue;
+        bool surface = false;
+        for (int f = 0; f < 6; f++) {
+            if (at(x + offsets[f][0], y + offsets[f][1], z + offsets[f][2])) continue;
+            b->faces.push_back({ static_cast<int16_t>(x), static_cast<int16_t>(y), static_cast<int16_t>(z), static_cast<uint8_t>(f), material });
+            surface = true;
+        }
+        if (surface) b->hull.insert(b->hull.end(), { x + 0.5f - b->center[0], y + 0.5f - b->center[1], z + 0.5f - b->center[2] });
+    }
+}
+
+// Rewrites the body's triangles from its faces and current transform (same layout as meshChunkModel)
+static void debrisModel(DebrisBody* b, const float half)
+{
+    if (!b->model.transformed_triangles)
+        b->model.transformed_triangles = static_cast<Triangle*>(malloc(sizeof(Triangle) * b->faces.size() * 2));
+    const float* m = b->transform;
+    b->model.num_triangles = 0;
+    for (const VoxelFace& f : b->faces) {
+        Vec3 P[4];
+        for (int k = 0; k < 4; k++) {
+            const int c = kFaceQuad[f.dir][k];
+            const float x = static_cast<float>(f.x + (c & 1)), y = static_cast<float>(f.y + (c >> 1 & 1)), z = static_cast<float>(f.z + (c >> 2 & 1));
+            P[k] = vec3(m[0]*x + m[1]*y + m[2]*z + m[3] - half, m[4]*x + m[5]*y + m[6]*z + m[7] - half, m[8]*x + m[9]*y + m[10]*z + m[11] - half);
+        }
+        const Vec3 color = materialColor(f.material);
+        b->model.transformed_triangles[b->model.num_triangles++] = { P[0], P[1], P[2], color };
+        b->model.transformed_triangles[b->model.num_triangles++] = { P[0], P[2], P[3], color };
+    }
+}
+
+// Cuts every free hanging island out of the grid into a body, returns how many were added. Expects the
+// island map to match the grid; marks the cut out regions dirty in both the mesh and the island map.
+static int debrisDetach(DebrisWorld* w, VoxelGrid* g, IslandMap* islands, VoxelMesh* mesh)
+{
+    int added = 0;
+    for (int id = 0; id < static_cast<int>(islands->islands.size()); id++) {
+        const Island& island = islands->islands[id];
+        const VoxelBox& box = island.bounds;
+        if (id == islands->largest || box.y0 == 0 || island.size > DEBRIS_MAX_VOXELS) continue;
+
+        DebrisBody b = {};
+        b.sx = box.x1 - box.x0;
+        b.sy = box.y1 - box.y0;
+        b.sz = box.z1 - box.z0;
+        b.voxels.assign(static_cast<size_t>(b.sx) * b.sy * b.sz, 0);
+        double sum[3] = {};
+        for (int z = box.z0; z < box.z1; z++)
+        for (int y = box.y0; y < box.y1; y++)
+        for (int x = box.x0; x < box.x1; x++) {
+            if (islandAt(islands, x, y, z) != id) continue;
+            const int lx = x - box.x0, ly = y - box.y0, lz = z - box.z0;
+            b.voxels[(static_cast<size_t>(lz) * b.sy + ly) * b.sx + lx] = g->data[z][y][x];
+            g->data[z][y][x] = 0;
+            sum[0] += lx + 0.5;
+            sum[1] += ly + 0.5;
+            sum[2] += lz + 0.5;
+        }
+        meshMarkDirty(mesh, box);
+        islandsMarkDirty(islands, box);
+
+        for (int i = 0; i < 3; i++) b.center[i] = static_cast<float>(sum[i] / island.size);
+        b.pos[0] = box.x0 + b.center[0];
+        b.pos[1] = box.y0 + b.center[1];
+        b.pos[2] = box.z0 + b.center[2];
+        b.rot[0] = 1.0f;
+
+        // A little tumble, varied per body
+        const uint32_t h = static_cast<uint32_t>(w->bodies.size()) * 2654435761u;
+        b.spin[0] = ((h & 0xFF) / 255.0f - 0.5f) * 2.0f;
+        b.spin[2] = ((h >> 8 & 0xFF) / 255.0f - 0.5f) * 2.0f;
+
+        debrisBuild(&b);
+        debrisUpdateTransform(&b);
+        debrisModel(&b, g->size * 0.5f);
+        w->bodies.push_back(std::move(b));
+        added++;
+    }
+    return added;
+}
+
+static void debrisStepBody(DebrisBody* b, const VoxelGrid* g, const float dt)
+{
+    float R[9];
+    debrisRotation(b->rot, R);
+    b->vel[1] -= DEBRIS_GRAVITY * dt;
+
+    // Rotation first; a blocked turn just stops the spin
+    const float* s = b->spin;
+    float q[4] = {
+        b->rot[0] + 0.5f * dt * (-s[0]*b->rot[1] - s[1]*b->rot[2] - s[2]*b->rot[3]),
+        b->rot[1] + 0.5f * dt * ( s[0]*b->rot[0] + s[1]*b->rot[3] - s[2]*b->rot[2]),
+        b->rot[2] + 0.5f * dt * ( s[1]*b->rot[0] + s[2]*b->rot[1] - s[0]*b->rot[3]),
+        b->rot[3] + 0.5f * dt * ( s[2]*b->rot[0] + s[0]*b->rot[2] - s[1]*b->rot[1]),
+    };
+    const float len = sqrtf(q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3]);
+    for (float& c : q) c /= len;
+    float Rq[9];
+    debrisRotation(q, Rq);
+    if (debrisCollides(b, g, b->pos, Rq)) {
+        b->spin[0] = b->spin[1] = b->spin[2] = 0.0f;
+    } else {
+        memcpy(b->rot, q, sizeof(q));
+        memcpy(R, Rq, sizeof(R));
+    }
+
+    // Translation one axis at a time so contacts slide instead of sticking
+    for (int a = 0; a < 3; a++) {
+        float p[3] = { b->pos[0], b->pos[1], b->pos[2] };
+        p[a] += b->vel[a] * dt;
+        if (!debrisCollides(b, g, p, R)) {
+            b->pos[a] = p[a];
+            continue;
+        }
+        b->vel[a] = fabsf(b->vel[a]) < 2.0f ? 0.0f : -b->vel[a] * DEBRIS_BOUNCE;
+        for (int k = 0; k < 3; k++) {
+            if (k != a) b->vel[k] *= DEBRIS_FRICTION;
+            b->spin[k] *= DEBRIS_FRICTION;
+        }
+    }
+
+    const float motion = b->vel[0]*b->vel[0] + b->vel[1]*b->vel[1] + b->vel[2]*b->vel[2] + b->spin[0]*b->spin[0] + b->spin[1]*b->spin[1] + b->spin[2]*b->spin[2];
+    b->still = motion < 0.5f ? b->still + 1 : 0;
+    if (b->still > 30) {
+        b->asleep = true;
+        memset(b->vel, 0, sizeof(b->vel));
+        memset(b->spin, 0, sizeof(b->spin));
+    }
+}
+
+// Advances every awake body by dt (substepped so nothing moves more than half a voxel per step) and
+// refreshes its transform and triangles
+static void debrisStep(DebrisWorld* w, const VoxelGrid* g, float dt)
+{
+    dt = std::min(dt, 1.0f / 30.0f);
+    const float half = g->size * 0.5f;
+    const int count = static_cast<int>(w->bodies.size());
+    #pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < count; i++) {
+        DebrisBody* b = &w->bodies[i];
+        if (b->asleep) continue;
+        const float speed = sqrtf(b->vel[0]*b->vel[0] + b->vel[1]*b->vel[1] + b->vel[2]*b->vel[2]) + DEBRIS_GRAVITY * dt;
+        const int steps = std::clamp(static_cast<int>(ceilf(speed * dt / 0.5f)), 1, 8);
+        for (int k = 0; k < steps && !b->asleep; k++) debrisStepBody(b, g, dt / steps);
+        debrisUpdateTransform(b);
+        debrisModel(b, half);
+    }
+}
+
+// The world changed under the bodies, let all of them settle again
+static void debrisWake(DebrisWorld* w)
+{
+    for (DebrisBody& b : w->bodies) {
+        b.asleep = false;
+        b.still = 0;
+    }
+}
+
+// Appends one transformed batch per body
+static void debrisAppendBatches(const DebrisWorld* w, std::vector<RasterBatch>* out)
+{
+    for (const DebrisBody& b : w->bodies)
+        if (!b.faces.empty()) out->push_back({ b.faces.data(), static_cast<int>(b.faces.size()), b.transform });
+}
+
+static void debrisFree(DebrisWorld* w)
+{
+    for (DebrisBody& b : w->bodies) free(b.model.transformed_triangles);
+    w->bodies.clear();
+}
@@ -0,0 +1,264 @@
+#pragma once
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <vector>
+#include "voxel.h"
+#include "mesh.h"
+
+// WATER
+// Cellular fluid: every voxel holds a fill level (0..FLUID_FULL) next to the solid grid. Each tick water
+// first falls into the cell below, then shares with lower horizontal neighbours; water in a cell an edit
+// filled is pushed out into open neighbours, so volume is conserved. Water ticks on every few ticks of the
+// simulation clock (about FLUID_HZ per simulated second) and only visits awake chunks; a chunk that had no
+// flow for FLUID_SLEEP_TICKS ticks sleeps until flow from a neighbour or a grid edit wakes it, so the cost
+// follows the moving water, not the world size.
+// Chunks are updated in place in 8 phases of a 2x2x2 checkerboard: a chunk only touches its own cells and
+// a one voxel border, so chunks of one phase never overlap and run in parallel.
+// The surface is a second chunked mesh (material FLUID_MATERIAL), remeshed only where levels changed.
+
+#define FLUID_FULL 255
+#define FLUID_MATERIAL 2
+#define FLUID_VISIBLE 16 // level from which a cell is drawn
+#define FLUID_HZ 20
+#define FLUID_SLEEP_TICKS 8
+
+struct FluidGrid
+{
+    int size;
+    std::vector<uint8_t> level;  // x fastest
+    std::vector<uint8_t> awake;  // per chunk (mesh chunk layout)
+    std::vector<uint8_t> calm;   // per chunk, ticks without flow
+    std::vector<int> active;     // scratch: awake chunks of the current tick
+    std::vector<uint8_t> flowed; // scratch, per active chunk
+    std::vector<VoxelBox> changed; // scratch, per active chunk
+    VoxelMesh mesh;
+    int ticks;
+};
+
+static size_t fluidIndex(const FluidGrid* f, const int x, const int y, const int z)
+{
+    return (static_cast<size_t>(z) * f->size + y) * f->size + x;
+}
+
+// Wakes the chunks whose cells, or whose neighbours' cells, lie in box
+static void fluidWake(FluidGrid* f, const VoxelBox& box)
+{
+    if (box.empty()) return;
+    const int last = f->size - 1;
+    for (int cz = std::max(box.z0 - 1, 0) / CHUNK_SIZE; cz <= std::min(box.z1, last) / CHUNK_SIZE; cz++)
+    for (int cy = std::max(box.y0 - 1, 0) / CHUNK_SIZE; cy <= std::min(box.y1, last) / CHUNK_SIZE; cy++)
+    for (int cx = std::max(box.x0 - 1, 0) / CHUNK_SIZE; cx <= std::min(box.x1, last) / CHUNK_SIZE; cx++) {
+        const int index = meshChunkIndex(cx, cy, cz);
+        f->awake[index] = 1;
+        f->calm[index] = 0;
+    }
+}
+
+static void fluidInit(FluidGrid* f, const int size)
+{
+    f->size = size;
+    f->level.assign(static_cast<size_t>(size) * size * size, 0);
+    f->awake.assign(CHUNKS * CHUNKS * CHUNKS, 0);
+    f->calm.assign(CHUNKS * CHUNKS * CHUNKS, 0);
+    f->mesh.chunks.resize(CHUNKS * CHUNKS * CHUNKS);
+    f->ticks = 0;
+}
+
+// Fills (or with amount 0 drains) the air cells of a sphere, returns the box touched
+static VoxelBox fluidFill(FluidGrid* f, const VoxelGrid* g, const float cx, const float cy, const float cz, const float radius, const uint8_t amount)
+{
+    const VoxelBox box = g->clip(VoxelGrid::bounds(cx - radius, cy - radius, cz - radius, cx + radius, cy + radius, cz + radius));
+    for (int z = box.z0; z < box.z1; z++)
+    for (int y = box.y0; y < box.y1; y++)
+    for (int x = box.x0; x < box.x1; x++)
+        if ((x - cx)*(x - cx) + (y - cy)*(y - cy) + (z - cz)*(z - cz) < radius*radius && !g->data[z][y][x])
+            f->level[fluidIndex(f, x, y, z)] = amount;
+    fluidWake(f, box);
+    meshMarkDirty(&f->mesh, box);
+    return box;
+}
+
+// One in-place update of chunk (cx, cy, cz). Returns true if any water moved; grows changed by the cells
+// that changed and wakes neighbour chunks that received water.
+static bool fluidChunk(FluidGrid* f, const VoxelGrid* g, const int cx, const int cy, const int cz, const int tick, VoxelBox* changed)
+{
+    const int n = f->size;
+    const int x0 = cx * CHUNK_SIZE, y0 = cy * CHUNK_SIZE, z0 = cz * CHUNK_SIZE;
+    const int x1 = std::min(x0 + CHUNK_SIZE, n), y1 = std::min(y0 + CHUNK_SIZE, n), z1 = std::min(z0 + CHUNK_SIZE, n);
+    bool flowed = false;
+
+    const auto touch = [&](const int x, const int y, const int z) {
+        *changed = { std::min(changed->x0, x), std::min(changed->y0, y), std::min(changed->z0, z),
+                     std::max(changed->x1, x + 1), std::max(changed->y1, y + 1), std::max(changed->z1, z + 1) };
+        if (x >= x0 && x < x1 && y >= y0 && y < y1 && z >= z0 && z < z1) return;
+        const int index = meshChunkIndex(x / CHUNK_SIZE, y / CHUNK_SIZE, z / CHUNK_SIZE);
+        std::atomic_ref<uint8_t>(f->awake[index]).store(1, std::memory_order_relaxed);
+        std::atomic_ref<uint8_t>(f->calm[index]).store(0, std::memory_order_relaxed);
+    };
+
+    // Alternate the scan and spread order every tick so the in-place update has no preferred direction
+    static const int kSide[4][2] = { {1,0}, {0,1}, {-1,0}, {0,-1} };
+    const bool flip = tick & 1;
+    for (int y = y0; y < y1; y++)
+    for (int zi = 0; zi < z1 - z0; zi++)
+    for (int xi = 0; xi < x1 - x0; xi++) {
+        const int z = flip ? z1 - 1 - zi : z0 + zi;
+        const int x = flip ? x1 - 1 - xi : x0 + xi;
+        uint8_t& L = f->level[fluidIndex(f, x, y, z)];
+        if (!L) continue;
+        if (g->data[z][y][x]) {
+            // Displaced by an edit: pushed up, then sideways, then down into open neighbours; the rest rises
+            // into the solid cell above and keeps rising until it reaches air. Nothing is dropped, water
+            // that can't move (at the top of the grid) stays hidden until it is dug out.
+            static const int kPush[7][3] = { {0,1,0}, {1,0,0}, {-1,0,0}, {0,0,1}, {0,0,-1}, {0,-1,0}, {0,1,0} };
+            for (int k = 0; k < 7; k++) {
+                const int nx = x + kPush[k][0], ny = y + kPush[k][1], nz = z + kPush[k][2];
+                if (nx < 0 || ny < 0 || nz < 0 || nx >= n || ny >= n || nz >= n || (k < 6 && g->data[nz][ny][nx])) continue;
+                uint8_t& N = f->level[fluidIndex(f, nx, ny, nz)];
+                const int flow = std::min<int>(L, FLUID_FULL - N);
+                if (flow <= 0) continue;
+                N = static_cast<uint8_t>(N + flow);
+                L = static_cast<uint8_t>(L - flow);
+                flowed = true;
+                touch(x, y, z);
+                touch(nx, ny, nz);
+                if (!L) break;
+            }
+            continue;
+        }
+
+        if (y > 0 && !g->data[z][y - 1][x]) {
+            uint8_t& B = f->level[fluidIndex(f, x, y - 1, z)];
+            const int flow = std::min<int>(L, FLUID_FULL - B);
+            if (flow > 0) {
+                B = static_cast<uint8_t>(B + flow);
+                L = static_cast<uint8_t>(L - flow);
+                flowed = true;
+                touch(x, y, z);
+                touch(x, y - 1, z);
+                if (!L) continue;
+            }
+        }
+
+        for (int k = 0; k < 4; k++) {
+            const int* d = kSide[(k + tick) & 3];
+            const int nx = x + d[0], nz = z + d[1];
+            if (nx < 0 || nz < 0 || nx >= n || nz >= n || g->data[nz][y][nx]) continue;
+            uint8_t& N = f->level[fluidIndex(f, nx, y, nz)];
+            const int diff = L - N;
+            if (diff < 2) continue;
+            const int flow = std::max(1, diff / 5);
+            N = static_cast<uint8_t>(N + flow);
+            L = static_cast<uint8_t>(L - flow);
+            flowed = true;
+            touch(x, y, z);
+            touch(nx, y, nz);
+        }
+    }
+    return flowed;
+}
+
+static void fluidTick(FluidGrid* f, const VoxelGrid* g)
+{
+    f->active.clear();
+    for (int i = 0; i < static_cast<int>(f->awake.size()); i++)
+        if (f->awake[i]) f->active.push_back(i);
+    const int count = static_cast<int>(f->active.size());
+    f->flowed.assign(count, 0);
+    f->changed.assign(count, { INT_MAX, INT_MAX, INT_MAX, INT_MIN, INT_MIN, INT_MIN });
+
+    std::vector<int> phase;
+    for (int p = 0; p < 8; p++) {
+        phase.clear();
+        for (int i = 0; i < count; i++) {
+            const int index = f->active[i];
+            const int cx = index % CHUNKS, cy = index / CHUNKS % CHUNKS, cz = index / (CHUNKS * CHUNKS);
+            if ((cx & 1) == (p & 1) && (cy & 1) == (p >> 1 & 1) && (cz & 1) == (p >> 2 & 1)) phase.push_back(i);
+        }
+        const int num = static_cast<int>(phase.size());
+        #pragma omp parallel for schedule(dynamic)
+        for (int k = 0; k < num; k++) {
+            const int i = phase[k], index = f->active[i];
+            f->flowed[i] = fluidChunk(f, g, index % CHUNKS, index / CHUNKS % CHUNKS, index / (CHUNKS * CHUNKS), f->ticks, &f->changed[i]);
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        const int index = f->active[i];
+        meshMarkDirty(&f->mesh, f->changed[i]);
+        if (f->flowed[i]) f->calm[index] = 0;
+        else if (++f->calm[index] >= FLUID_SLEEP_TICKS) f->awake[index] = 0;
+    }
+    f->ticks++;
+}
+
+static void fluidChunkFaces(std::vector<VoxelFace>* out, const FluidGrid* f, const VoxelGrid* g, const int cx, const int cy, const int cz)
+{
+    const int offsets[6][3] = { {-1,0,0}, {1,0,0}, {0,-1,0}, {0,1,0}, {0,0,-1}, {0,0,1} };
+    const int n = f->size;
+    const auto wet = [&](const int x, const int y, const int z) { return f->level[fluidIndex(f, x, y, z)] >= FLUID_VISIBLE; };
+    out->clear();
+
+    const int x0 = cx * CHUNK_SIZE, y0 = cy * CHUNK_SIZE, z0 = cz * CHUNK_SIZE;
+    const int x1 = std::min(x0 + CHUNK_SIZE, n), y1 = std::min(y0 + CHUNK_SIZE, n), z1 = std::min(z0 + CHUNK_SIZE, n);
+    for (int z = z0; z < z1; z++)
+    for (int y = y0; y < y1; y++)
+    for (int x = x0; x < x1; x++) {
+        if (!wet(x, y, z) || g->data[z][y][x]) continue;
+        for (int d = 0; d < 6; d++) {
+            const int nx = x + offsets[d][0], ny = y + offsets[d][1], nz = z + offsets[d][2];
+            if (nx >= 0 && ny >= 0 && nz >= 0 && nx < n && ny < n && nz < n && (g->data[nz][ny][nx] || wet(nx, ny, nz))) continue;
+            out->push_back({ static_cast<int16_t>(x), static_cast<int16_t>(y), static_cast<int16_t>(z), static_cast<uint8_t>(d), FLUID_MATERIAL });
+            if (f->mesh.light) out->back().light = lightFaceCorners(f->mesh.light, &g->data[0][0][0], x, y, z, d);
+        }
+    }
+}
+
+// Remeshes the water chunks marked dirty, returns how many were rebuilt
+static int fluidMeshUpdate(FluidGrid* f, const VoxelGrid* g)
+{
+    std::vector<int> dirty;
+    for (int i = 0; i < static_cast<int>(f->mesh.chunks.size()); i++)
+        if (f->mesh.chunks[i].dirty) dirty.push_back(i);
+    if (dirty.empty()) return 0;
+
+    const int count = static_cast<int>(dirty.size());
+    const float half = g->size * 0.5f;
+    #pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < count; i++) {
+        const int index = dirty[i];
+        MeshChunk& c = f->mesh.chunks[index];
+        fluidChunkFaces(&c.faces, f, g, index % CHUNKS, index / CHUNKS % CHUNKS, index / (CHUNKS * CHUNKS));
+        meshChunkModel(&c.model, c.faces, half);
+        c.dirty = false;
+    }
+    meshRebuildBatches(&f->mesh);
+    return count;
+}
+
+// Runs a water tick if one falls on simulation tick sim_tick of a clock at hz, then remeshes the surface;
+// returns whether water ticked
+static bool fluidUpdate(FluidGrid* f, const VoxelGrid* g, const long long sim_tick, const int hz)
+{
+    const int every = std::max(1, (hz + FLUID_HZ / 2) / FLUID_HZ);
+    const bool due = sim_tick % every == 0;
+    if (due) fluidTick(f, g);
+    fluidMeshUpdate(f, g);
+    return due;
+}
+
+static int fluidActiveChunks(const FluidGrid* f)
+{
+    int n = 0;
+    for (const uint8_t a : f->awake) n += a;
+    return n;
+}
+
+static void fluidFree(FluidGrid* f)
+{
+    meshFree(&f->mesh);
+    f->level.clear();
+    f->awake.clear();
+    f->calm.clear();
+}
@@ -0,0 +1,362 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "voxel.h"
+
+// TERRAIN GENERATION
+// Heightmap terrain: 2D fBm value noise is evaluated once per (x, z) column, a row of columns at a time so
+// the octave loops vectorize, and every row of voxels is filled against those heights. Rows entirely below
+// or above the band around the surface are a single memset; only voxels inside the band sample 3D noise,
+// which bends the surface into overhangs and opens caves under it. The band is exact: density is the
+// distance to the surface over the band plus at most +-overhang of noise, so nothing outside it can flip.
+// Output is uint8 (x fastest), 0 = air and 1 = solid, for the whole grid or any box of it.
+
+struct GenTerrain
+{
+    uint32_t seed;
+    float scale;      // first octave feature size in voxels
+    int octaves;
+    float lacunarity;
+    float gain;
+    float base;       // mean height as a fraction of the grid size
+    float amplitude;  // height range as a fraction of the grid size
+    float band;       // voxels around the surface where 3D noise applies
+    float overhang;   // 3D noise weight, below 1 to keep the band exact
+    float cave_scale; // 3D feature size in voxels
+};
+
+static GenTerrain genDefaultTerrain()
+{
+    return { 1337u, 64.0f, 5, 2.0f, 0.5f, 0.35f, 0.25f, 6.0f, 0.6f, 12.0f };
+}
+
+static uint32_t genHash(const int x, const int y, const int z, const uint32_t seed)
+{
+    uint32_t h = seed ^ static_cast<uint32_t>(x) * 0x8DA6B343u ^ static_cast<uint32_t>(y) * 0xD8163841u ^ static_cast<uint32_t>(z) * 0xCB1AB31Fu;
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    h *= 0x846CA68Bu;
+    h ^= h >> 16;
+    return h;
+}
+
+// Lattice value in [0, 1)
+static float genLattice(const int x, const int y, const int z, const uint32_t seed)
+{
+    return static_cast<float>(genHash(x, y, z, seed) >> 8) * (1.0f / 16777216.0f);
+}
+
+static float genFade(const float t)
+{
+    return t * t * (3.0f - 2.0f * t);
+}
+
+static float genNoise2(const float x, const float z, const uint32_t seed)
+{
+    const float fx = floorf(x), fz = floorf(z);
+    const int ix = static_cast<int>(fx), iz = static_cast<int>(fz);
+    const float u = genFade(x - fx), v = genFade(z - fz);
+    const float a = genLattice(ix, 0, iz, seed), b = genLattice(ix + 1, 0, iz, seed);
+    const float c = genLattice(ix, 0, iz + 1, seed), d = genLattice(ix + 1, 0, iz + 1, seed);
+    return a + (b - a) * u + (c - a) * v + (a - b - c + d) * u * v;
+}
+
+static float genNoise3(const float x, const float y, const float z, const uint32_t seed)
+{
+    const float fx = floorf(x), fy = floorf(y), fz = floorf(z);
+    const int ix = static_cast<int>(fx), iy = static_cast<int>(fy), iz = static_cast<int>(fz);
+    const float u = genFade(x - fx), v = genFade(y - fy), w = genFade(z - fz);
+    const auto plane = [&](const int k) {
+        const float a = genLattice(ix, iy, k, seed), b = genLattice(ix + 1, iy, k, seed);
+        const float c = genLattice(ix, iy + 1, k, seed), d = genLattice(ix + 1, iy + 1, k, seed);
+        return a + (b - a) * u + (c - a) * v + (a - b - c + d) * u * v;
+    };
+    const float p0 = plane(iz), p1 = plane(iz + 1);
+    return p0 + (p1 - p0) * w;
+}
+
+// Surface heights (in voxels) of count columns starting at (x0, z)
+static void genHeightRow(const GenTerrain* t, const int size, const int x0, const int z, const int count, float* out)
+{
+    std::fill(out, out + count, 0.0f);
+    float freq = 1.0f / t->scale, amp = 1.0f, total = 0.0f;
+    for (int o = 0; o < t->octaves; o++) {
+        const uint32_t seed = t->seed + static_cast<uint32_t>(o) * 0x9E3779B9u;
+        const float zf = static_cast<float>(z) * freq;
+        #pragma omp simd
+        for (int i = 0; i < count; i++) out[i] += amp * genNoise2(static_cast<float>(x0 + i) * freq, zf, seed);
+        total += amp;
+        amp *= t->gain;
+        freq *= t->lacunarity;
+    }
+    const float scale = 2.0f / total;
+    #pragma omp simd
+    for (int i = 0; i < count; i++) out[i] = (t->base + t->amplitude * (out[i] * scale - 1.0f)) * static_cast<float>(size);
+}
+
+// Fills the box b of a size^3 terrain into out (box sized, x fastest); returns how many 3D samples it took
+static long long genTerrainBox(const GenTerrain* t, const int size, const VoxelBox& b, uint8_t* out)
+{
+    const int w = b.x1 - b.x0, h = b.y1 - b.y0;
+    const float inv_band = 1.0f / t->band, freq = 1.0f / t->cave_scale;
+    const uint32_t cave_seed = t->seed ^ 0xA511E9B3u;
+    std::vector<float> heights(w);
+    long long samples = 0;
+    for (int z = b.z0; z < b.z1; z++) {
+        genHeightRow(t, size, b.x0, z, w, heights.data());
+        const auto [lo, hi] = std::minmax_element(heights.begin(), heights.end());
+        const float below = *lo - t->band, above = *hi + t->band;
+        for (int y = b.y0; y < b.y1; y++) {
+            uint8_t* row = out + (static_cast<size_t>(z - b.z0) * h + (y - b.y0)) * w;
+            const float fy = static_cast<float>(y) + 0.5f;
+            if (fy <= below) memset(row, 1, w);
+            else if (fy >= above) memset(row, 0, w);
+            else
+                for (int i = 0; i < w; i++) {
+                    const float dist = heights[i] - fy;
+                    if (dist >= t->band) row[i] = 1;
+                    else if (dist <= -t->band) row[i] = 0;
+                    else {
+                        const float n = genNoise3(static_cast<float>(b.x0 + i) * freq, fy * freq, static_cast<float>(z) * freq, cave_seed);
+                        row[i] = dist * inv_band + t->overhang * (2.0f * n - 1.0f) > 0.0f;
+                        samples++;
+                    }
+                }
+        }
+    }
+    return samples;
+}
+
+// Whole size^3 grid, z slabs in parallel; returns the 3D sample count
+static long long genTerrain(const GenTerrain* t, uint8_t* data, const int size)
+{
+    long long samples = 0;
+    #pragma omp parallel for schedule(dynamic) reduction(+:samples)
+    for (int z = 0; z < size; z++)
+        samples += genTerrainBox(t, size, { 0, 0, z, size, size, z + 1 }, data + static_cast<size_t>(z) * size * size);
+    return samples;
+}
+
+// COARSE LATTICE SAMPLING
+// Smooth fields (the sponge noise spans 20 voxels per lattice cell) don't need a sample per voxel: the field
+// is evaluated every step voxels and trilinearly upsampled before thresholding, step^3 times fewer samples.
+// Each voxel row first blends its four surrounding lattice rows along y and z, then interpolates along x.
+// With an error report, every stride-th voxel per axis is also evaluated exactly and compared; the default
+// stride of 5 shares no factor with the usual steps, so checks land at every offset inside the cells.
+
+struct GenError
+{
+    float max_abs;     // largest |upsampled - exact| field difference seen
+    long long flipped; // sampled voxels that came out on the other side of the threshold
+    long long samples;
+};
+
+// Fills a size^3 grid (x fastest) with f(x, y, z) > threshold, f sampled every step voxels; f must be safe
+// to call from several threads. Returns the number of lattice samples.
+template <typename F>
+static long long genCoarse(uint8_t* data, const int size, const int step, const float threshold, const F& f,
+                           GenError* err = nullptr, const int stride = 5)
+{
+    const int m = (size - 1) / step + 2; // lattice points per axis, one past the last voxel
+    std::vector<float> lattice(static_cast<size_t>(m) * m * m);
+    #pragma omp parallel for schedule(dynamic)
+    for (int k = 0; k < m; k++)
+        for (int j = 0; j < m; j++)
+            for (int i = 0; i < m; i++)
+                lattice[(static_cast<size_t>(k) * m + j) * m + i] = f(static_cast<float>(i * step), static_cast<float>(j * step), static_cast<float>(k * step));
+
+    const float inv = 1.0f / static_cast<float>(step);
+    float max_abs = 0.0f;
+    long long flipped = 0, samples = 0;
+    #pragma omp parallel for schedule(dynamic) reduction(max:max_abs) reduction(+:flipped, samples)
+    for (int z = 0; z < size; z++) {
+        std::vector<float> blend(m), row(size);
+        const int kz = z / step;
+        const float tz = static_cast<float>(z - kz * step) * inv;
+        for (int y = 0; y < size; y++) {
+            const int ky = y / step;
+            const float ty = static_cast<float>(y - ky * step) * inv;
+            const float* l00 = &lattice[(static_cast<size_t>(kz) * m + ky) * m];
+            const float* l01 = l00 + m;
+            const float* l10 = l00 + static_cast<size_t>(m) * m;
+            const float* l11 = l10 + m;
+            #pragma omp simd
+            for (int i = 0; i < m; i++) {
+                const float a = l00[i] + (l01[i] - l00[i]) * ty, b = l10[i] + (l11[i] - l10[i]) * ty;
+                blend[i] = a + (b - a) * tz;
+            }
+            uint8_t* out = data + (static_cast<size_t>(z) * size + y) * size;
+            #pragma omp simd
+            for (int x = 0; x < size; x++) {
+                const int kx = x / step;
+                const float tx = static_cast<float>(x - kx * step) * inv;
+                row[x] = blend[kx] + (blend[kx + 1] - blend[kx]) * tx;
+                out[x] = row[x] > threshold;
+            }
+            if (err && z % stride == 0 && y % stride == 0)
+                for (int x = 0; x < size; x += stride) {
+                    const float exact = f(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z));
+                    max_abs = std::max(max_abs, fabsf(row[x] - exact));
+                    flipped += (exact > threshold) != (row[x] > threshold);
+                    samples++;
+                }
+        }
+    }
+    if (err) *err = { max_abs, flipped, samples };
+    return static_cast<long long>(m) * m * m;
+}
+
+// The sponge world from a lattice every step voxels
+static long long genSpongeCoarse(VoxelGrid* g, const int step, GenError* err = nullptr)
+{
+    return genCoarse(&g->data[0][0][0], g->size, step, SPONGE_THRESHOLD,
+                     [&](const float x, const float y, const float z) { return g->spongeNoise(x, y, z); }, err);
+}
+
+// CELLULAR NOISE
+// Worley noise with one feature point per cell, hashed from the cell coordinate. A box first lays out the
+// feature points of every cell it touches plus a ring around it, then walks each voxel row one cell-wide
+// segment at a time: the 27 candidate points are the same for the whole segment, so the distance updates
+// run as a simd loop across it, keeping the nearest and second nearest (F1, F2) without branches. Candidates
+// go nearest cell first and are skipped once they can't come closer than the segment's worst F2. Voxels
+// where F2 - F1 is under the wall thickness are solid, a honeycomb of membranes between the cells.
+
+struct GenWorley
+{
+    uint32_t seed;
+    int cell;   // cell edge in voxels, also the simd segment width
+    float wall; // solid where F2 - F1 is below this many voxels
+};
+
+static GenWorley genDefaultWorley()
+{
+    return { 7u, 16, 1.5f };
+}
+
+// The 27 cells around a cell, nearest first, so the early ones tighten F2 and the far ones get skipped
+static const int kGenNeighbours[27][3] = {
+    {0,0,0}, {-1,0,0}, {1,0,0}, {0,-1,0}, {0,1,0}, {0,0,-1}, {0,0,1},
+    {-1,-1,0}, {1,-1,0}, {-1,1,0}, {1,1,0}, {-1,0,-1}, {1,0,-1}, {-1,0,1}, {1,0,1}, {0,-1,-1}, {0,1,-1}, {0,-1,1}, {0,1,1},
+    {-1,-1,-1}, {1,-1,-1}, {-1,1,-1}, {1,1,-1}, {-1,-1,1}, {1,-1,1}, {-1,1,1}, {1,1,1},
+};
+
+static int genFloorDiv(const int v, const int d)
+{
+    return v >= 0 ? v / d : -((-v + d - 1) / d);
+}
+
+// Fills box b into out (box sized, x fastest)
+static void genWorleyBox(const GenWorley* w, const VoxelBox& b, uint8_t* out)
+{
+    const int c = w->cell, width = b.x1 - b.x0, height = b.y1 - b.y0;
+    const int cx0 = genFloorDiv(b.x0, c) - 1, cy0 = genFloorDiv(b.y0, c) - 1, cz0 = genFloorDiv(b.z0, c) - 1;
+    const int nx = genFloorDiv(b.x1 - 1, c) + 2 - cx0, ny = genFloorDiv(b.y1 - 1, c) + 2 - cy0, nz = genFloorDiv(b.z1 - 1, c) + 2 - cz0;
+    std::vector<float> points(static_cast<size_t>(nx) * ny * nz * 3);
+    for (int k = 0; k < nz; k++)
+        for (int j = 0; j < ny; j++)
+            for (int i = 0; i < nx; i++) {
+                float* p = &points[((static_cast<size_t>(k) * ny + j) * nx + i) * 3];
+                const int x = cx0 + i, y = cy0 + j, z = cz0 + k;
+                p[0] = (static_cast<float>(x) + genLattice(x, y, z, w->seed)) * c;
+                p[1] = (static_cast<float>(y) + genLattice(x, y, z, w->seed ^ 0x68E31DA4u)) * c;
+                p[2] = (static_cast<float>(z) + genLattice(x, y, z, w->seed ^ 0xB5297A4Du)) * c;
+            }
+
+    std::vector<float> f1(width), f2(width);
+    for (int z = b.z0; z < b.z1; z++)
+        for (int y = b.y0; y < b.y1; y++) {
+            const float fy = static_cast<float>(y) + 0.5f, fz = static_cast<float>(z) + 0.5f;
+            const int j = genFloorDiv(y, c) - cy0, k = genFloorDiv(z, c) - cz0;
+            std::fill(f1.begin(), f1.end(), 1e30f);
+            std::fill(f2.begin(), f2.end(), 1e30f);
+            for (int kx = genFloorDiv(b.x0, c); kx <= genFloorDiv(b.x1 - 1, c); kx++) {
+                const int xs = std::max(b.x0, kx * c), xe = std::min(b.x1, kx * c + c);
+                float* s1 = &f1[xs - b.x0];
+                float* s2 = &f2[xs - b.x0];
+                const int i = kx - cx0;
+                float worst = 1e30f; // largest F2 in the segment, candidates that can't beat it are skipped
+                for (const auto& o : kGenNeighbours) {
+                    const float* p = &points[((static_cast<size_t>(k + o[2]) * ny + (j + o[1])) * nx + (i + o[0])) * 3];
+                    const float ey = fy - p[1], ez = fz - p[2], yz = ey * ey + ez * ez;
+                    const float gap = std::max({ 0.0f, static_cast<float>(xs) + 0.5f - p[0], p[0] - static_cast<float>(xe) + 0.5f });
+                    if (yz + gap * gap >= worst) continue;
+                    const float px = p[0] - static_cast<float>(xs) - 0.5f;
+                    float most = 0.0f;
+                    #pragma omp simd reduction(max:most)
+                    for (int v = 0; v < xe - xs; v++) {
+                        const float ex = static_cast<float>(v) - px, d = ex * ex + yz;
+                        s2[v] = std::min(s2[v], std::max(s1[v], d));
+                        s1[v] = std::min(s1[v], d);
+                        most = std::max(most, s2[v]);
+                    }
+                    worst = most;
+                }
+            }
+            uint8_t* row = out + (static_cast<size_t>(z - b.z0) * height + (y - b.y0)) * width;
+            #pragma omp simd
+            for (int x = 0; x < width; x++) row[x] = sqrtf(f2[x]) - sqrtf(f1[x]) < w->wall;
+        }
+}
+
+// Whole size^3 grid, one CHUNK_SIZE slab per task so each shares its feature points
+static void genWorley(const GenWorley* w, uint8_t* data, const int size)
+{
+    const int slabs = (size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    #pragma omp parallel for schedule(dynamic)
+    for (int s = 0; s < slabs; s++) {
+        const int z0 = s * CHUNK_SIZE, z1 = std::min(z0 + CHUNK_SIZE, size);
+        genWorleyBox(w, { 0, 0, z0, size, size, z1 }, data + static_cast<size_t>(z0) * size * size);
+    }
+}
+
+// DOMAIN WARPED FBM
+// 3D fBm density whose lookup point is first pushed around by three more fBm fields, giving folded,
+// swirling shapes, with a vertical gradient so the result reads as terrain. Four fBm evaluations per sample
+// make it the most expensive field here, and also one of the smoothest, so it goes through genCoarse.
+
+struct GenWarp
+{
+    uint32_t seed;
+    float scale;  // feature size in voxels
+    int octaves;
+    float warp;   // displacement in voxels
+    float base;   // ground level as a fraction of the grid size
+    float slope;  // density change per grid height, larger is flatter
+    int step;     // coarse lattice spacing
+};
+
+static GenWarp genDefaultWarp()
+{
+    return { 99u, 48.0f, 4, 24.0f, 0.4f, 2.5f, 4 };
+}
+
+static float genFbm3(const float x, const float y, const float z, const uint32_t seed, const int octaves)
+{
+    float sum = 0.0f, amp = 1.0f, freq = 1.0f, total = 0.0f;
+    for (int o = 0; o < octaves; o++) {
+        sum += amp * genNoise3(x * freq, y * freq, z * freq, seed + static_cast<uint32_t>(o) * 0x9E3779B9u);
+        total += amp;
+        amp *= 0.5f;
+        freq *= 2.0f;
+    }
+    return sum / total;
+}
+
+static float genWarpDensity(const GenWarp* w, const int size, const float x, const float y, const float z)
+{
+    const float s = 1.0f / w->scale;
+    const float qx = x + w->warp * (2.0f * genFbm3(x * s, y * s, z * s, w->seed + 1, w->octaves) - 1.0f);
+    const float qy = y + w->warp * (2.0f * genFbm3(x * s, y * s, z * s, w->seed + 2, w->octaves) - 1.0f);
+    const float qz = z + w->warp * (2.0f * genFbm3(x * s, y * s, z * s, w->seed + 3, w->octaves) - 1.0f);
+    return genFbm3(qx * s, qy * s, qz * s, w->seed, w->octaves) - 0.5f + (w->base - y / static_cast<float>(size)) * w->slope;
+}
+
+// Whole size^3 grid; returns the number of lattice samples
+static long long genWarped(const GenWarp* w, uint8_t* data, const int size)
+{
+    return genCoarse(data, size, w->step, 0.0f, [&](const float x, const float y, const float z) { return genWarpDensity(w, size, x, y, z); });
+}
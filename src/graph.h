@@ -0,0 +1,465 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "voxel.h"
+#include "gen.h"
+
+// GENERATOR GRAPH
+// Worlds described as a DAG of float fields instead of hand written loops. Density is positive inside solid.
+// Leaves are constants, a height gradient and fBm noise whose lookup point can be pushed by three other
+// fields (domain warp); inner nodes add, multiply, move a surface (threshold), combine densities by CSG and
+// assign materials, the last of which falls through to another material node where its density is empty.
+// Nodes refer to earlier nodes only, so the list order is already a valid order and cycles can't be built.
+// Evaluation is per CHUNK_SIZE^3 chunk:
+// - noise nodes are the expensive part. Each is sampled on its own lattice (every step voxels, trilinear in
+//   between, as genCoarse does) and kept in a field cache keyed by what it computes (op, parameters and the
+//   same key of its inputs) plus the chunk, so equal subgraphs share one field and editing a parameter only
+//   recomputes what is downstream of it.
+// - everything between cached fields is fused into one program that runs over the chunk a slice at a time.
+//   Nodes are scheduled depth first from the root and their slices live in registers that are handed on as
+//   soon as the last reader ran, so intermediate values stay in cache instead of becoming chunk arrays.
+
+enum GraphOp : uint8_t
+{
+    GRAPH_CONST,     // a
+    GRAPH_HEIGHT,    // (a - y / scale) * b, a = ground level as a fraction of scale, b = slope
+    GRAPH_NOISE,     // fBm in [-1, 1], a = feature size, b = warp in voxels times inputs 0-2 (optional)
+    GRAPH_ADD,       // in0 + in1
+    GRAPH_MUL,       // in0 * in1
+    GRAPH_THRESHOLD, // in0 - a
+    GRAPH_UNION,     // max(in0, in1)
+    GRAPH_INTERSECT, // min(in0, in1)
+    GRAPH_SUBTRACT,  // min(in0, -in1)
+    GRAPH_MATERIAL,  // a where in0 > 0, else in1 (optional, air without it)
+};
+
+#define GRAPH_SLICE ((CHUNK_SIZE + 1) * (CHUNK_SIZE + 1))
+#define GRAPH_DEFAULT_CAPACITY (16 << 20) // cached floats, 64 MB
+
+struct GraphNode
+{
+    uint8_t op;
+    int in[3];     // input nodes, -1 unused
+    float a, b;
+    uint32_t seed; // noise
+    int octaves;   // noise
+    int step;      // noise lattice spacing, divides CHUNK_SIZE
+};
+
+struct GraphStep
+{
+    int node;
+    int reg;
+    int in[3];  // registers, -1 unused
+    int field;  // index into the program fields for a cached node read, else -1
+};
+
+// Points every spacing voxels, n per axis, evaluated a z slice at a time
+struct GraphProgram
+{
+    int spacing;
+    int n;
+    std::vector<GraphStep> steps;
+    std::vector<int> fields; // cached nodes sampled
+    int regs;
+    int result;              // register holding the root
+};
+
+struct GraphKey
+{
+    uint64_t sig;
+    int cx, cy, cz;
+    bool operator==(const GraphKey& o) const { return sig == o.sig && cx == o.cx && cy == o.cy && cz == o.cz; }
+};
+
+struct GraphKeyHash
+{
+    size_t operator()(const GraphKey& k) const
+    {
+        return static_cast<size_t>(k.sig ^ genHash(k.cx, k.cy, k.cz, static_cast<uint32_t>(k.sig >> 32)));
+    }
+};
+
+struct GraphEntry
+{
+    std::shared_ptr<const std::vector<float>> values; // (CHUNK_SIZE / step + 1)^3, x fastest
+    std::list<GraphKey>::iterator lru;
+};
+
+struct GeneratorGraph
+{
+    std::vector<GraphNode> nodes;
+    int output;
+    int scale; // world height the height gradients refer to
+
+    // Compiled
+    std::vector<uint64_t> sig;          // per node, equal for nodes computing the same field
+    std::vector<int> program;           // per node, index into programs for cached nodes, else -1
+    std::vector<GraphProgram> programs; // the output's program is last
+
+    // Field cache, shared by all threads
+    std::mutex lock;
+    std::unordered_map<GraphKey, GraphEntry, GraphKeyHash> cache;
+    std::list<GraphKey> lru; // most recent first
+    size_t capacity;         // floats
+    size_t floats;
+    long long hits, misses, evicted;
+};
+
+static uint64_t graphMix(uint64_t h, const uint64_t v)
+{
+    h ^= v + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+    h ^= h >> 31;
+    h *= 0xBF58476D1CE4E5B9ull;
+    return h ^ h >> 29;
+}
+
+// Inputs an op needs and inputs it may take
+static int graphInputs(const uint8_t op, const bool optional)
+{
+    switch (op) {
+        case GRAPH_NOISE: return optional ? 3 : 0;
+        case GRAPH_THRESHOLD: return 1;
+        case GRAPH_MATERIAL: return optional ? 2 : 1;
+        case GRAPH_ADD: case GRAPH_MUL: case GRAPH_UNION: case GRAPH_INTERSECT: case GRAPH_SUBTRACT: return 2;
+        default: return 0;
+    }
+}
+
+static void graphInit(GeneratorGraph* g, const size_t capacity = GRAPH_DEFAULT_CAPACITY)
+{
+    g->nodes.clear();
+    g->output = -1;
+    g->scale = 0;
+    g->cache.clear();
+    g->lru.clear();
+    g->capacity = capacity;
+    g->floats = 0;
+    g->hits = g->misses = g->evicted = 0;
+}
+
+// Schedules the nodes root needs into p; cached nodes other than compute are read from their fields
+static void graphBuild(const GeneratorGraph* g, const int root, const int compute, GraphProgram* p)
+{
+    std::vector<int> order;
+    std::vector<char> seen(g->nodes.size(), 0);
+    const auto visit = [&](const auto& self, const int v) -> void {
+        if (seen[v]) return;
+        seen[v] = 1;
+        if (v != compute && g->program[v] >= 0) {
+            order.push_back(v);
+            return;
+        }
+        for (const int i : g->nodes[v].in)
+            if (i >= 0) self(self, i);
+        order.push_back(v);
+    };
+    visit(visit, root);
+
+    std::vector<int> uses(g->nodes.size(), 0), reg(g->nodes.size(), -1), free_regs;
+    for (const int v : order)
+        if (v == compute || g->program[v] < 0)
+            for (const int i : g->nodes[v].in)
+                if (i >= 0) uses[i]++;
+    uses[root]++;
+
+    p->steps.clear();
+    p->fields.clear();
+    p->regs = 0;
+    for (const int v : order) {
+        GraphStep s = { v, -1, { -1, -1, -1 }, -1 };
+        if (v != compute && g->program[v] >= 0) {
+            s.field = static_cast<int>(p->fields.size());
+            p->fields.push_back(v);
+        }
+        else
+            for (int k = 0; k < 3; k++) {
+                const int i = g->nodes[v].in[k];
+                if (i < 0) continue;
+                s.in[k] = reg[i];
+                if (--uses[i] == 0) free_regs.push_back(reg[i]);
+            }
+        // Inputs are released first, so an elementwise node may write over one of them
+        if (!free_regs.empty()) {
+            s.reg = free_regs.back();
+            free_regs.pop_back();
+        }
+        else s.reg = p->regs++;
+        reg[v] = s.reg;
+        p->steps.push_back(s);
+    }
+    p->result = reg[root];
+}
+
+// Checks the graph and builds its programs; cached fields of unchanged nodes stay valid across recompiles.
+// Returns false for a malformed graph.
+static bool graphCompile(GeneratorGraph* g, const int scale)
+{
+    const int count = static_cast<int>(g->nodes.size());
+    if (g->output < 0 || g->output >= count) return false;
+    g->scale = scale;
+    g->sig.assign(count, 0);
+    g->program.assign(count, -1);
+    for (int v = 0; v < count; v++) {
+        const GraphNode& n = g->nodes[v];
+        if (n.op > GRAPH_MATERIAL) return false;
+        const int need = graphInputs(n.op, false), may = graphInputs(n.op, true);
+        for (int k = 0; k < 3; k++) {
+            const int i = n.in[k];
+            if ((k < need && i < 0) || i >= v || (i >= 0 && k >= may)) return false;
+        }
+        if (n.op == GRAPH_NOISE && (n.step < 1 || CHUNK_SIZE % n.step || n.octaves < 1 || n.a <= 0.0f)) return false;
+
+        uint32_t a, b;
+        memcpy(&a, &n.a, 4);
+        memcpy(&b, &n.b, 4);
+        uint64_t h = graphMix(n.op, a);
+        h = graphMix(h, b);
+        if (n.op == GRAPH_NOISE) h = graphMix(graphMix(graphMix(h, n.seed), n.octaves), n.step);
+        if (n.op == GRAPH_HEIGHT) h = graphMix(h, scale);
+        for (const int i : n.in) h = graphMix(h, i >= 0 ? g->sig[i] : 0);
+        g->sig[v] = h;
+    }
+
+    // Only noise reachable from the output gets a program; inputs come before their readers
+    std::vector<char> reach(count, 0);
+    reach[g->output] = 1;
+    for (int v = count - 1; v >= 0; v--)
+        if (reach[v])
+            for (const int i : g->nodes[v].in)
+                if (i >= 0) reach[i] = 1;
+    g->programs.clear();
+    for (int v = 0; v < count; v++)
+        if (reach[v] && g->nodes[v].op == GRAPH_NOISE) {
+            g->program[v] = static_cast<int>(g->programs.size());
+            g->programs.emplace_back();
+        }
+    for (int v = 0; v < count; v++) {
+        if (g->program[v] < 0) continue;
+        GraphProgram& p = g->programs[g->program[v]];
+        p.spacing = g->nodes[v].step;
+        p.n = CHUNK_SIZE / p.spacing + 1;
+        graphBuild(g, v, v, &p);
+    }
+    GraphProgram out;
+    out.spacing = 1;
+    out.n = CHUNK_SIZE;
+    graphBuild(g, g->output, -1, &out);
+    g->programs.push_back(std::move(out));
+    return true;
+}
+
+// Trilinear lookup of a field with lattice spacing fs at slice lz of a program with spacing sp and n points
+static void graphSample(const float* f, const int fs, const int sp, const int n, const int lz, float* out)
+{
+    const int m = CHUNK_SIZE / fs + 1;
+    const float inv = 1.0f / static_cast<float>(fs);
+    const int kz = std::min(lz * sp / fs, m - 2);
+    const float tz = static_cast<float>(lz * sp - kz * fs) * inv;
+    float plane[GRAPH_SLICE];
+    const float* a = f + static_cast<size_t>(kz) * m * m;
+    const float* b = a + m * m;
+    #pragma omp simd
+    for (int i = 0; i < m * m; i++) plane[i] = a[i] + (b[i] - a[i]) * tz;
+    for (int j = 0; j < n; j++) {
+        const int ky = std::min(j * sp / fs, m - 2);
+        const float ty = static_cast<float>(j * sp - ky * fs) * inv;
+        const float* r0 = plane + ky * m;
+        const float* r1 = r0 + m;
+        float* o = out + j * n;
+        #pragma omp simd
+        for (int i = 0; i < n; i++) {
+            const int kx = std::min(i * sp / fs, m - 2);
+            const float tx = static_cast<float>(i * sp - kx * fs) * inv;
+            const float lo = r0[kx] + (r0[kx + 1] - r0[kx]) * tx, hi = r1[kx] + (r1[kx + 1] - r1[kx]) * tx;
+            o[i] = lo + (hi - lo) * ty;
+        }
+    }
+}
+
+// One node over one slice of points starting at world (x0, y0, z)
+static void graphStep(const GeneratorGraph* g, const GraphProgram& p, const GraphStep& s, const float* const* fields,
+                      float* regs, const int x0, const int y0, const int z, const int lz)
+{
+    const GraphNode& n = g->nodes[s.node];
+    const int count = p.n * p.n, sp = p.spacing;
+    float* out = regs + static_cast<size_t>(s.reg) * GRAPH_SLICE;
+    const auto in = [&](const int k) { return s.in[k] >= 0 ? regs + static_cast<size_t>(s.in[k]) * GRAPH_SLICE : nullptr; };
+    const float* a = in(0);
+    const float* b = in(1);
+    if (s.field >= 0) {
+        graphSample(fields[s.field], n.step, sp, p.n, lz, out);
+        return;
+    }
+    switch (n.op) {
+        case GRAPH_CONST:
+            std::fill(out, out + count, n.a);
+            break;
+        case GRAPH_HEIGHT: {
+            const float inv = 1.0f / static_cast<float>(g->scale);
+            for (int j = 0; j < p.n; j++) std::fill(out + j * p.n, out + (j + 1) * p.n, (n.a - static_cast<float>(y0 + j * sp) * inv) * n.b);
+            break;
+        }
+        case GRAPH_NOISE: {
+            const float inv = 1.0f / n.a, fz = static_cast<float>(z);
+            const float* c = in(2);
+            for (int j = 0; j < p.n; j++) {
+                const float fy = static_cast<float>(y0 + j * sp);
+                #pragma omp simd
+                for (int i = 0; i < p.n; i++) {
+                    const int v = j * p.n + i;
+                    const float x = static_cast<float>(x0 + i * sp) + (a ? n.b * a[v] : 0.0f);
+                    const float y = fy + (b ? n.b * b[v] : 0.0f), zz = fz + (c ? n.b * c[v] : 0.0f);
+                    out[v] = 2.0f * genFbm3(x * inv, y * inv, zz * inv, n.seed, n.octaves) - 1.0f;
+                }
+            }
+            break;
+        }
+        case GRAPH_ADD:
+            #pragma omp simd
+            for (int v = 0; v < count; v++) out[v] = a[v] + b[v];
+            break;
+        case GRAPH_MUL:
+            #pragma omp simd
+            for (int v = 0; v < count; v++) out[v] = a[v] * b[v];
+            break;
+        case GRAPH_THRESHOLD:
+            #pragma omp simd
+            for (int v = 0; v < count; v++) out[v] = a[v] - n.a;
+            break;
+        case GRAPH_UNION:
+            #pragma omp simd
+            for (int v = 0; v < count; v++) out[v] = std::max(a[v], b[v]);
+            break;
+        case GRAPH_INTERSECT:
+            #pragma omp simd
+            for (int v = 0; v < count; v++) out[v] = std::min(a[v], b[v]);
+            break;
+        case GRAPH_SUBTRACT:
+            #pragma omp simd
+            for (int v = 0; v < count; v++) out[v] = std::min(a[v], -b[v]);
+            break;
+        case GRAPH_MATERIAL:
+            #pragma omp simd
+            for (int v = 0; v < count; v++) out[v] = a[v] > 0.0f ? n.a : b ? b[v] : 0.0f;
+            break;
+        default: break;
+    }
+}
+
+static std::shared_ptr<const std::vector<float>> graphField(GeneratorGraph* g, int node, int cx, int cy, int cz);
+
+// Runs a program over chunk (cx, cy, cz) into out (n^3, x fastest)
+static void graphRun(GeneratorGraph* g, const GraphProgram& p, const int cx, const int cy, const int cz, float* out)
+{
+    std::vector<std::shared_ptr<const std::vector<float>>> held(p.fields.size());
+    std::vector<const float*> fields(p.fields.size());
+    for (size_t i = 0; i < p.fields.size(); i++) {
+        held[i] = graphField(g, p.fields[i], cx, cy, cz);
+        fields[i] = held[i]->data();
+    }
+    std::vector<float> regs(static_cast<size_t>(p.regs) * GRAPH_SLICE);
+    const int count = p.n * p.n;
+    for (int lz = 0; lz < p.n; lz++) {
+        const int z = cz * CHUNK_SIZE + lz * p.spacing;
+        for (const GraphStep& s : p.steps) graphStep(g, p, s, fields.data(), regs.data(), cx * CHUNK_SIZE, cy * CHUNK_SIZE, z, lz);
+        memcpy(out + static_cast<size_t>(lz) * count, &regs[static_cast<size_t>(p.result) * GRAPH_SLICE], sizeof(float) * count);
+    }
+}
+
+// The lattice of a cached node over a chunk, computed on a miss; safe to call from several threads
+static std::shared_ptr<const std::vector<float>> graphField(GeneratorGraph* g, const int node, const int cx, const int cy, const int cz)
+{
+    const GraphKey key = { g->sig[node], cx, cy, cz };
+    {
+        std::lock_guard<std::mutex> guard(g->lock);
+        const auto it = g->cache.find(key);
+        if (it != g->cache.end()) {
+            g->hits++;
+            g->lru.splice(g->lru.begin(), g->lru, it->second.lru);
+            return it->second.values;
+        }
+        g->misses++;
+    }
+
+    const GraphProgram& p = g->programs[g->program[node]];
+    auto values = std::make_shared<std::vector<float>>(static_cast<size_t>(p.n) * p.n * p.n);
+    graphRun(g, p, cx, cy, cz, values->data());
+
+    std::lock_guard<std::mutex> guard(g->lock);
+    const auto it = g->cache.find(key);
+    if (it != g->cache.end()) return it->second.values;
+    while (g->floats + values->size() > g->capacity && !g->lru.empty()) {
+        const auto old = g->cache.find(g->lru.back());
+        g->floats -= old->second.values->size();
+        g->cache.erase(old);
+        g->lru.pop_back();
+        g->evicted++;
+    }
+    g->lru.push_front(key);
+    g->cache[key] = { values, g->lru.begin() };
+    g->floats += values->size();
+    return values;
+}
+
+// Chunk (cx, cy, cz) of the world into out (CHUNK_SIZE^3, x fastest): the output's material, or 1 where a
+// plain density output is positive
+static void graphChunk(GeneratorGraph* g, const int cx, const int cy, const int cz, uint8_t* out)
+{
+    float values[CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE];
+    graphRun(g, g->programs.back(), cx, cy, cz, values);
+    if (g->nodes[g->output].op == GRAPH_MATERIAL) {
+        #pragma omp simd
+        for (int i = 0; i < CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE; i++) out[i] = static_cast<uint8_t>(std::clamp(values[i], 0.0f, 255.0f));
+    }
+    else {
+        #pragma omp simd
+        for (int i = 0; i < CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE; i++) out[i] = values[i] > 0.0f;
+    }
+}
+
+// Whole size^3 grid (x fastest), chunks in parallel; the graph must be compiled
+static void graphFill(GeneratorGraph* g, uint8_t* data, const int size)
+{
+    constexpr int S = CHUNK_SIZE;
+    const int k = (size + S - 1) / S;
+    #pragma omp parallel for schedule(dynamic)
+    for (int c = 0; c < k * k * k; c++) {
+        const int cx = c % k, cy = c / k % k, cz = c / (k * k);
+        uint8_t chunk[S * S * S];
+        graphChunk(g, cx, cy, cz, chunk);
+        const int w = std::min(S, size - cx * S);
+        for (int z = 0; z < std::min(S, size - cz * S); z++)
+            for (int y = 0; y < std::min(S, size - cy * S); y++)
+                memcpy(data + (static_cast<size_t>(cz * S + z) * size + (cy * S + y)) * size + cx * S, &chunk[(z * S + y) * S], w);
+    }
+}
+
+// Warped hills with caves cut out of them and glowing ore (material 3, the lamp) scattered through the rock
+static void graphDefault(GeneratorGraph* g)
+{
+    g->nodes = {
+        { GRAPH_NOISE, { -1, -1, -1 }, 64.0f, 0.0f, 11u, 3, 8 },     // 0-2: warp offsets
+        { GRAPH_NOISE, { -1, -1, -1 }, 64.0f, 0.0f, 12u, 3, 8 },
+        { GRAPH_NOISE, { -1, -1, -1 }, 64.0f, 0.0f, 13u, 3, 8 },
+        { GRAPH_NOISE, { 0, 1, 2 }, 48.0f, 24.0f, 5u, 4, 4 },        // 3: hills
+        { GRAPH_HEIGHT, { -1, -1, -1 }, 0.45f, 3.0f, 0u, 0, 0 },     // 4
+        { GRAPH_ADD, { 3, 4, -1 }, 0.0f, 0.0f, 0u, 0, 0 },           // 5: ground
+        { GRAPH_NOISE, { 0, 1, 2 }, 20.0f, 8.0f, 21u, 2, 4 },        // 6: caves, same warp as the hills
+        { GRAPH_THRESHOLD, { 6, -1, -1 }, 0.3f, 0.0f, 0u, 0, 0 },    // 7
+        { GRAPH_SUBTRACT, { 5, 7, -1 }, 0.0f, 0.0f, 0u, 0, 0 },      // 8: rock
+        { GRAPH_NOISE, { -1, -1, -1 }, 6.0f, 0.0f, 31u, 1, 2 },      // 9: ore
+        { GRAPH_THRESHOLD, { 9, -1, -1 }, 0.75f, 0.0f, 0u, 0, 0 },   // 10
+        { GRAPH_INTERSECT, { 8, 10, -1 }, 0.0f, 0.0f, 0u, 0, 0 },    // 11: ore inside rock
+        { GRAPH_MATERIAL, { 8, -1, -1 }, 1.0f, 0.0f, 0u, 0, 0 },     // 12
+        { GRAPH_MATERIAL, { 11, 12, -1 }, 3.0f, 0.0f, 0u, 0, 0 },    // 13
+    };
+    g->output = 13;
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// IMAGE ENCODING
+// Minimal PPM and PNG writers for ARGB8888 frames. PNG uses stored (uncompressed) deflate blocks:
+// encoding is a straight copy plus checksums, which keeps it off the critical path of headless renders.
+
+static void encodePPM(std::vector<uint8_t>* out, const uint32_t* argb, const int width, const int height)
+{
+    char header[64];
+    const int n = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", width, height);
+    out->assign(header, header + n);
+    out->reserve(out->size() + static_cast<size_t>(width) * height * 3);
+    for (int i = 0; i < width * height; i++) {
+        out->push_back(static_cast<uint8_t>(argb[i] >> 16));
+        out->push_back(static_cast<uint8_t>(argb[i] >> 8));
+        out->push_back(static_cast<uint8_t>(argb[i]));
+    }
+}
+
+static uint32_t crc32Update(uint32_t crc, const uint8_t* data, const size_t size)
+{
+    static uint32_t table[256];
+    static const bool init = [] {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        return true;
+    }();
+    (void)init;
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void encodePNG(std::vector<uint8_t>* out, const uint32_t* argb, const int width, const int height)
+{
+    const auto put32 = [](std::vector<uint8_t>* v, const uint32_t x) {
+        const uint8_t b[4] = { static_cast<uint8_t>(x >> 24), static_cast<uint8_t>(x >> 16), static_cast<uint8_t>(x >> 8), static_cast<uint8_t>(x) };
+        v->insert(v->end(), b, b + 4);
+    };
+    const auto chunk = [&](const char* type, const std::vector<uint8_t>& data) {
+        put32(out, static_cast<uint32_t>(data.size()));
+        const size_t start = out->size();
+        out->insert(out->end(), type, type + 4);
+        out->insert(out->end(), data.begin(), data.end());
+        put32(out, crc32Update(0, out->data() + start, out->size() - start));
+    };
+
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    out->assign(signature, signature + 8);
+
+    std::vector<uint8_t> ihdr;
+    put32(&ihdr, static_cast<uint32_t>(width));
+    put32(&ihdr, static_cast<uint32_t>(height));
+    ihdr.insert(ihdr.end(), { 8, 2, 0, 0, 0 }); // 8 bit RGB
+    chunk("IHDR", ihdr);
+
+    // Filter byte 0 + RGB per row, wrapped in stored deflate blocks of at most 65535 bytes
+    const size_t row_bytes = static_cast<size_t>(width) * 3 + 1;
+    std::vector<uint8_t> raw(row_bytes * height);
+    for (int y = 0; y < height; y++) {
+        uint8_t* row = raw.data() + row_bytes * y;
+        row[0] = 0;
+        for (int x = 0; x < width; x++) {
+            const uint32_t c = argb[y * width + x];
+            row[1 + x * 3] = static_cast<uint8_t>(c >> 16);
+            row[2 + x * 3] = static_cast<uint8_t>(c >> 8);
+            row[3 + x * 3] = static_cast<uint8_t>(c);
+        }
+    }
+
+    std::vector<uint8_t> z;
+    z.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    z.push_back(0x78);
+    z.push_back(0x01);
+    for (size_t pos = 0; pos < raw.size(); pos += 65535) {
+        const size_t len = raw.size() - pos < 65535 ? raw.size() - pos : 65535;
+        z.push_back(pos + len == raw.size() ? 1 : 0);
+        z.push_back(static_cast<uint8_t>(len));
+        z.push_back(static_cast<uint8_t>(len >> 8));
+        z.push_back(static_cast<uint8_t>(~len));
+        z.push_back(static_cast<uint8_t>(~len >> 8));
+        z.insert(z.end(), raw.begin() + static_cast<ptrdiff_t>(pos), raw.begin() + static_cast<ptrdiff_t>(pos + len));
+    }
+
+    // Adler-32, reduced every 5552 bytes (the largest run that cannot overflow)
+    uint32_t a = 1, b = 0;
+    for (size_t pos = 0; pos < raw.size(); pos += 5552) {
+        const size_t end = raw.size() - pos < 5552 ? raw.size() : pos + 5552;
+        for (size_t i = pos; i < end; i++) {
+            a += raw[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    put32(&z, b << 16 | a);
+    chunk("IDAT", z);
+    chunk("IEND", {});
+}
+
+static bool writeFile(const char* path, const std::vector<uint8_t>& data)
+{
+    FILE* f = fopen(path, "wb");
+    if (!f) return false;
+    const bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+    return fclose(f) == 0 && ok;
+}
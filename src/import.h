@@ -0,0 +1,291 @@
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+#include <vector>
+#include "parallel.h"
+
+// HEIGHTMAP AND VOLUME IMPORT
+// voxely view <file> [--raw WxHxD] [--16] [--be] [--threshold N] [--levels N] [--height F]
+// Reads a binary PGM (P5, 8 or 16 bit) or headerless RAW samples, x fastest, into a size^3 grid. A depth
+// of 1 is a heightmap: image x and y become grid x and z and each column is filled up to the largest sample
+// it covers. Anything deeper is a volume stack: slices go along z and every voxel takes the mean of the
+// samples it covers, then is thresholded (levels 1) or quantized into levels materials: the lowest band is
+// material 1 and the rest start at IMPORT_FIRST_LEVEL, past the materials that behave specially (2 water,
+// 3 lamp), so a scan never turns into water or light sources. Sources of any size fit the grid with one
+// scale for all axes.
+// The file is streamed one grid slice's worth of rows or slices at a time and never held whole: a reader
+// thread fetches the next slab while the current one is reduced on all threads, so on a cold file the
+// reduction hides behind the disk.
+
+#define IMPORT_FIRST_LEVEL 4 // material of the second quantized band
+#define IMPORT_MAX_LEVELS (255 - IMPORT_FIRST_LEVEL + 2)
+
+struct ImportSource
+{
+    FILE* file;  // positioned at the first sample
+    int width, height, depth;
+    int bytes;   // per sample, 1 or 2
+    bool big_endian;
+    int max_value;
+};
+
+struct ImportOptions
+{
+    const char* path;
+    int raw[3];      // RAW dimensions, all 0 to read a PGM
+    int bytes;       // RAW sample size
+    bool big_endian; // RAW byte order, PGM is always big endian
+    int threshold;   // volume sample value that counts as solid, -1 = half the range
+    int levels;      // volume materials, 1..IMPORT_MAX_LEVELS
+    float height;    // heightmap: grid height the largest value reaches, as a fraction
+};
+
+static int importToken(FILE* f)
+{
+    int c = fgetc(f);
+    while (c == '#' || isspace(c)) {
+        if (c == '#')
+            while (c != '\n' && c != EOF) c = fgetc(f);
+        c = fgetc(f);
+    }
+    int v = 0, digits = 0;
+    for (; c >= '0' && c <= '9' && digits < 9; c = fgetc(f), digits++) v = v * 10 + (c - '0');
+    return digits && isspace(c) ? v : -1; // the whitespace after the last field is the one byte before the samples
+}
+
+static bool importOpenPGM(ImportSource* src, const char* path)
+{
+    src->file = fopen(path, "rb");
+    if (!src->file) return false;
+    const bool magic = fgetc(src->file) == 'P' && fgetc(src->file) == '5';
+    src->width = importToken(src->file);
+    src->height = importToken(src->file);
+    src->max_value = importToken(src->file);
+    src->depth = 1;
+    src->bytes = src->max_value > 255 ? 2 : 1;
+    src->big_endian = true;
+    if (magic && src->width > 0 && src->height > 0 && src->max_value > 0 && src->max_value < 65536) return true;
+    fclose(src->file);
+    src->file = nullptr;
+    return false;
+}
+
+static bool importOpenRaw(ImportSource* src, const char* path, const int width, const int height, const int depth, const int bytes, const bool big_endian)
+{
+    std::error_code ec;
+    const auto size = std::filesystem::file_size(path, ec);
+    if (ec || (bytes != 1 && bytes != 2) || width <= 0 || height <= 0 || depth <= 0) return false;
+    if (size != static_cast<uintmax_t>(width) * height * depth * bytes) {
+        fprintf(stderr, "%s: %ju bytes, expected %dx%dx%d x %d\n", path, size, width, height, depth, bytes);
+        return false;
+    }
+    src->file = fopen(path, "rb");
+    src->width = width;
+    src->height = height;
+    src->depth = depth;
+    src->bytes = bytes;
+    src->big_endian = big_endian;
+    src->max_value = bytes == 2 ? 65535 : 255;
+    return src->file != nullptr;
+}
+
+static void importClose(ImportSource* src)
+{
+    if (src->file) fclose(src->file);
+    src->file = nullptr;
+}
+
+// Calls f(i, value) for samples i0..i1-1 of a row, with the sample format picked once per row
+template <typename F>
+static void importRow(const ImportSource* src, const uint8_t* p, const int i0, const int i1, const F& f)
+{
+    if (src->bytes == 1) {
+        #pragma omp simd
+        for (int i = i0; i < i1; i++) f(i, static_cast<int>(p[i]));
+    }
+    else if (src->big_endian) {
+        #pragma omp simd
+        for (int i = i0; i < i1; i++) f(i, p[i * 2] << 8 | p[i * 2 + 1]);
+    }
+    else {
+        #pragma omp simd
+        for (int i = i0; i < i1; i++) f(i, p[i * 2 + 1] << 8 | p[i * 2]);
+    }
+}
+
+// Source records grid index g covers when span records fill size cells: at least one, so small sources
+// repeat rather than leave gaps
+static void importRange(const int g, const int span, const int size, int* a, int* b)
+{
+    *a = static_cast<int>(static_cast<long long>(g) * span / size);
+    *b = std::max(*a + 1, static_cast<int>(static_cast<long long>(g + 1) * span / size));
+}
+
+// Streams the count records of the source (record bytes each) in the groups grid slices 0..size-1 cover
+// and calls f(g, records, n) per slice, n = 0 past the end of the source. Records are read once, in order,
+// the next group on a reader thread while f runs.
+template <typename F>
+static bool importStream(ImportSource* src, const int count, const size_t record, const int size, const int span, const F& f)
+{
+    std::vector<uint8_t> cur, next;
+    int cur_a = -1, next_a = -1;
+    bool next_ok = true;
+    std::thread reader;
+    const auto fetch = [&](const int from) {
+        for (int g = from; g < size; g++) {
+            int a, b;
+            importRange(g, span, size, &a, &b);
+            if (a >= count) return;
+            if (a == cur_a) continue;
+            next_a = a;
+            next.resize((std::min(b, count) - a) * record);
+            reader = std::thread([&] { next_ok = fread(next.data(), 1, next.size(), src->file) == next.size(); });
+            return;
+        }
+    };
+
+    fetch(0);
+    for (int g = 0; g < size; g++) {
+        int a, b;
+        importRange(g, span, size, &a, &b);
+        if (a >= count) {
+            f(g, nullptr, 0);
+            continue;
+        }
+        if (a != cur_a) {
+            reader.join();
+            if (!next_ok) return false;
+            std::swap(cur, next);
+            cur_a = next_a;
+            fetch(g + 1);
+        }
+        f(g, cur.data(), std::min(b, count) - a);
+    }
+    if (reader.joinable()) reader.join();
+    return true;
+}
+
+// Heightmap into a size^3 grid (x fastest, y up), material 1
+static bool importHeightmap(ImportSource* src, uint8_t* data, const int size, const float height)
+{
+    const int w = src->width, span = std::max(src->width, src->height);
+    const float scale = height * static_cast<float>(size) / static_cast<float>(src->max_value);
+    const size_t record = static_cast<size_t>(w) * src->bytes;
+    constexpr int block = 4096; // columns per task
+    std::vector<int> column(w), top(size);
+    return importStream(src, src->height, record, size, span, [&](const int z, const uint8_t* rows, const int n) {
+        // Column maxima over the rows first, read straight through, then the grid columns over those
+        #pragma omp parallel for
+        for (int i0 = 0; i0 < w; i0 += block) {
+            const int i1 = std::min(i0 + block, w);
+            std::fill(column.begin() + i0, column.begin() + i1, -1);
+            for (int r = 0; r < n; r++) importRow(src, rows + r * record, i0, i1, [&](const int i, const int v) { column[i] = std::max(column[i], v); });
+        }
+        for (int x = 0; x < size; x++) {
+            int a, b;
+            importRange(x, span, size, &a, &b);
+            int m = -1;
+            for (int i = a; i < std::min(b, w); i++) m = std::max(m, column[i]);
+            top[x] = m < 0 ? 0 : std::clamp(static_cast<int>(static_cast<float>(m) * scale + 0.5f), 1, size);
+        }
+        #pragma omp parallel for
+        for (int y = 0; y < size; y++) {
+            uint8_t* row = data + (static_cast<size_t>(z) * size + y) * size;
+            for (int x = 0; x < size; x++) row[x] = y < top[x];
+        }
+    });
+}
+
+// Volume stack into a size^3 grid (x fastest): mean of each voxel's samples, threshold and levels as in
+// ImportOptions
+static bool importVolume(ImportSource* src, uint8_t* data, const int size, const int threshold, const int levels)
+{
+    const int w = src->width, h = src->height, span = std::max({ w, h, src->depth });
+    const size_t slice = static_cast<size_t>(w) * h;
+    const float range = static_cast<float>(src->max_value + 1 - threshold) / static_cast<float>(levels);
+    return importStream(src, src->depth, slice * src->bytes, size, span, [&](const int z, const uint8_t* slices, const int n) {
+        // Per grid row: column sums over its source rows in every slice, then the grid voxels over those
+        #pragma omp parallel for schedule(dynamic)
+        for (int y = 0; y < size; y++) {
+            uint8_t* row = data + (static_cast<size_t>(z) * size + y) * size;
+            int ya, yb;
+            importRange(y, span, size, &ya, &yb);
+            yb = std::min(yb, h);
+            if (!n || ya >= yb) {
+                memset(row, 0, size);
+                continue;
+            }
+            std::vector<long long> column(w, 0);
+            for (int s = 0; s < n; s++)
+                for (int r = ya; r < yb; r++)
+                    importRow(src, slices + (s * slice + static_cast<size_t>(r) * w) * src->bytes, 0, w, [&](const int i, const int v) { column[i] += v; });
+            for (int x = 0; x < size; x++) {
+                int xa, xb;
+                importRange(x, span, size, &xa, &xb);
+                xb = std::min(xb, w);
+                if (xa >= xb) {
+                    row[x] = 0;
+                    continue;
+                }
+                long long sum = 0;
+                for (int i = xa; i < xb; i++) sum += column[i];
+                const float mean = static_cast<float>(sum) / static_cast<float>(static_cast<long long>(n) * (yb - ya) * (xb - xa));
+                if (mean < static_cast<float>(threshold)) {
+                    row[x] = 0;
+                    continue;
+                }
+                const int band = std::min(levels - 1, static_cast<int>((mean - static_cast<float>(threshold)) / range));
+                row[x] = static_cast<uint8_t>(band ? IMPORT_FIRST_LEVEL - 1 + band : 1);
+            }
+        }
+    });
+}
+
+static bool importParseArgs(ImportOptions* o, const int argc, char** argv)
+{
+    *o = {};
+    o->bytes = 1;
+    o->threshold = -1;
+    o->levels = 1;
+    o->height = 1.0f;
+    for (int i = 0; i < argc; i++) {
+        if (!strcmp(argv[i], "--raw") && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%dx%d", &o->raw[0], &o->raw[1], &o->raw[2]) != 3) return false;
+        }
+        else if (!strcmp(argv[i], "--16")) o->bytes = 2;
+        else if (!strcmp(argv[i], "--be")) o->big_endian = true;
+        else if (!strcmp(argv[i], "--threshold") && i + 1 < argc) o->threshold = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--levels") && i + 1 < argc) o->levels = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--height") && i + 1 < argc) o->height = static_cast<float>(atof(argv[++i]));
+        else if (!o->path && argv[i][0] != '-') o->path = argv[i];
+        else return false;
+    }
+    return o->path && o->levels >= 1 && o->levels <= IMPORT_MAX_LEVELS && o->height > 0.0f;
+}
+
+// Opens, fills and reports; the grid is left as it was on failure to open
+static bool importRun(const ImportOptions* o, uint8_t* data, const int size)
+{
+    ImportSource src = {};
+    const bool open = o->raw[0] ? importOpenRaw(&src, o->path, o->raw[0], o->raw[1], o->raw[2], o->bytes, o->big_endian)
+                                : importOpenPGM(&src, o->path);
+    if (!open) {
+        fprintf(stderr, "import: can't read %s\n", o->path);
+        return false;
+    }
+    const double t0 = nowMs();
+    const int threshold = o->threshold < 0 ? (src.max_value + 1) / 2 : std::min(o->threshold, src.max_value);
+    const bool ok = src.depth == 1 ? importHeightmap(&src, data, size, o->height) : importVolume(&src, data, size, threshold, o->levels);
+    const double ms = nowMs() - t0;
+    const double mb = static_cast<double>(src.width) * src.height * src.depth * src.bytes / 1e6;
+    importClose(&src);
+    if (!ok) fprintf(stderr, "import: %s is shorter than its header says\n", o->path);
+    else printf("import: %s %dx%dx%d, %.0f MB in %.1f ms (%.0f MB/s)\n", o->path, src.width, src.height, src.depth, mb, ms, mb / ms * 1000.0);
+    return ok;
+}
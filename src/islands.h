@@ -0,0 +1,237 @@
+#pragma once
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <vector>
+#include "voxel.h"
+
+// VOXEL ISLANDS
+// 6-connected components of solid voxels. Every CHUNK_SIZE^3 chunk is labeled on its own first (local
+// union-find, parallel over chunks); the chunk-local components then become nodes of a global union-find that
+// is joined across chunk borders with lock-free unions. After an edit only chunks flagged dirty are relabeled,
+// the node graph is cheap enough to rebuild every time. Every nonzero voxel is solid, so touching voxels of
+// different materials form one island.
+
+struct Island
+{
+    int size;
+    VoxelBox bounds;
+};
+
+struct IslandChunk
+{
+    std::vector<uint16_t> label; // CHUNK_SIZE^3, 0 = air, else local component + 1; empty if all air
+    std::vector<Island> local;   // local components, bounds in grid coordinates
+    int base;                    // first global node of this chunk
+    bool dirty;
+};
+
+struct IslandMap
+{
+    int size;
+    int chunks;                      // per axis
+    std::vector<IslandChunk> chunk;  // chunks^3, x fastest
+    std::vector<int> parent;         // global union-find over chunk-local components
+    std::vector<int> node_island;    // node -> island id
+    std::vector<Island> islands;
+    int largest;                     // island id with the most voxels, -1 if none
+};
+
+static int islandFind(std::vector<int>& parent, int x)
+{
+    while (true) {
+        int p = std::atomic_ref<int>(parent[x]).load(std::memory_order_relaxed);
+        if (p == x) return x;
+        const int g = std::atomic_ref<int>(parent[p]).load(std::memory_order_relaxed);
+        if (g != p) std::atomic_ref<int>(parent[x]).compare_exchange_weak(p, g, std::memory_order_relaxed); // path halving
+        x = g;
+    }
+}
+
+// Links the larger root under the smaller one, retrying if another thread re-rooted it first
+static void islandUnite(std::vector<int>& parent, int a, int b)
+{
+    while (true) {
+        a = islandFind(parent, a);
+        b = islandFind(parent, b);
+        if (a == b) return;
+        if (a < b) std::swap(a, b);
+        int expected = a;
+        if (std::atomic_ref<int>(parent[a]).compare_exchange_strong(expected, b, std::memory_order_relaxed)) return;
+    }
+}
+
+static void islandsLabelChunk(IslandChunk* c, const uint8_t* data, const int size, const int cx, const int cy, const int cz)
+{
+    constexpr int S = CHUNK_SIZE;
+    const int x0 = cx * S, y0 = cy * S, z0 = cz * S;
+    const int x1 = std::min(x0 + S, size), y1 = std::min(y0 + S, size), z1 = std::min(z0 + S, size);
+
+    // Runs along x inherit the left voxel's set; the voxel above (or behind) only needs a union when its left
+    // neighbour did not already connect the two
+    int parent[S * S * S];
+    const auto join = [&](int a, int b) {
+        while (parent[a] != a) a = parent[a] = parent[parent[a]];
+        while (parent[b] != b) b = parent[b] = parent[parent[b]];
+        if (a != b) parent[std::max(a, b)] = std::min(a, b);
+    };
+    bool any = false;
+    for (int z = z0; z < z1; z++)
+    for (int y = y0; y < y1; y++) {
+        const uint8_t* row = data + (static_cast<size_t>(z) * size + y) * size;
+        const uint8_t* below = y > y0 ? row - size : nullptr;
+        const uint8_t* back = z > z0 ? row - static_cast<size_t>(size) * size : nullptr;
+        for (int x = x0; x < x1; x++) {
+            if (!row[x]) continue;
+            const int i = ((z - z0) * S + (y - y0)) * S + (x - x0);
+            const bool left = x > x0 && row[x - 1];
+            parent[i] = left ? parent[i - 1] : i;
+            any = true;
+            if (below && below[x] && !(left && below[x - 1])) join(i, i - S);
+            if (back && back[x] && !(left && back[x - 1])) join(i, i - S * S);
+        }
+    }
+
+    c->local.clear();
+    if (!any) {
+        c->label.clear();
+        return;
+    }
+    c->label.assign(S * S * S, 0);
+
+    // Parents always have a smaller index, so one forward pass points every voxel at its root and roots
+    // are met before their members. Runs along x share a label, so sizes and bounds are folded in per run.
+    for (int z = z0; z < z1; z++)
+    for (int y = y0; y < y1; y++) {
+        const uint8_t* row = data + (static_cast<size_t>(z) * size + y) * size;
+        for (int x = x0; x < x1;) {
+            if (!row[x]) {
+                x++;
+                continue;
+            }
+            const int start = x;
+            uint16_t l = 0;
+            for (; x < x1 && row[x]; x++) {
+                const int i = ((z - z0) * S + (y - y0)) * S + (x - x0);
+                const int r = parent[i] = parent[parent[i]];
+                if (r == i) c->local.push_back({ 0, { x, y, z, x + 1, y + 1, z + 1 } });
+                l = r == i ? static_cast<uint16_t>(c->local.size()) : c->label[r];
+                c->label[i] = l;
+            }
+
+            Island& s = c->local[l - 1];
+            s.size += x - start;
+            s.bounds = { std::min(s.bounds.x0, start), std::min(s.bounds.y0, y), std::min(s.bounds.z0, z),
+                         std::max(s.bounds.x1, x), std::max(s.bounds.y1, y + 1), std::max(s.bounds.z1, z + 1) };
+        }
+    }
+}
+
+// Relabels dirty chunks and rebuilds the island list, returns how many chunks were relabeled
+static int islandsUpdate(IslandMap* m, const uint8_t* data)
+{
+    constexpr int S = CHUNK_SIZE;
+    const int n = m->chunks;
+    std::vector<int> dirty;
+    for (int i = 0; i < static_cast<int>(m->chunk.size()); i++)
+        if (m->chunk[i].dirty) dirty.push_back(i);
+
+    const int count = static_cast<int>(dirty.size());
+    #pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < count; i++) {
+        const int index = dirty[i];
+        islandsLabelChunk(&m->chunk[index], data, m->size, index % n, index / n % n, index / (n * n));
+        m->chunk[index].dirty = false;
+    }
+
+    int nodes = 0;
+    for (IslandChunk& c : m->chunk) {
+        c.base = nodes;
+        nodes += static_cast<int>(c.local.size());
+    }
+    m->parent.resize(nodes);
+    for (int i = 0; i < nodes; i++) m->parent[i] = i;
+
+    // Join touching components across the +X, +Y and +Z face of every chunk
+    const int total = n * n * n;
+    #pragma omp parallel for schedule(dynamic, 16)
+    for (int index = 0; index < total; index++) {
+        const IslandChunk& a = m->chunk[index];
+        if (a.label.empty()) continue;
+        const int cx = index % n, cy = index / n % n, cz = index / (n * n);
+        for (int axis = 0; axis < 3; axis++) {
+            const int c[3] = { cx + (axis == 0), cy + (axis == 1), cz + (axis == 2) };
+            if (c[axis] >= n) continue;
+            const IslandChunk& b = m->chunk[(c[2] * n + c[1]) * n + c[0]];
+            if (b.label.empty()) continue;
+
+            // Face cells (u, v): voxel on the far side of a, and the matching near side voxel of b
+            const int step[3] = { 1, S, S * S };
+            const int su = step[(axis + 1) % 3], sv = step[(axis + 2) % 3];
+            const int far = step[axis] * (S - 1);
+            int last_a = -1, last_b = -1;
+            for (int v = 0; v < S; v++)
+            for (int u = 0; u < S; u++) {
+                const int la = a.label[far + u * su + v * sv], lb = b.label[u * su + v * sv];
+                if (!la || !lb || (la == last_a && lb == last_b)) continue;
+                last_a = la;
+                last_b = lb;
+                islandUnite(m->parent, a.base + la - 1, b.base + lb - 1);
+            }
+        }
+    }
+
+    // Roots -> compact island ids, then fold in the local sizes and bounds. Other threads are still finding
+    // through these slots, so the flattening store is atomic too.
+    #pragma omp parallel for
+    for (int i = 0; i < nodes; i++) std::atomic_ref<int>(m->parent[i]).store(islandFind(m->parent, i), std::memory_order_relaxed);
+
+    m->node_island.assign(nodes, -1);
+    m->islands.clear();
+    m->largest = -1;
+    for (const IslandChunk& c : m->chunk)
+        for (int l = 0; l < static_cast<int>(c.local.size()); l++) {
+            const int node = c.base + l, root = m->parent[node];
+            if (m->node_island[root] < 0) {
+                m->node_island[root] = static_cast<int>(m->islands.size());
+                m->islands.push_back({ 0, { INT_MAX, INT_MAX, INT_MAX, INT_MIN, INT_MIN, INT_MIN } });
+            }
+            const int id = m->node_island[node] = m->node_island[root];
+            const Island& s = c.local[l];
+            Island& d = m->islands[id];
+            d.size += s.size;
+            d.bounds = { std::min(d.bounds.x0, s.bounds.x0), std::min(d.bounds.y0, s.bounds.y0), std::min(d.bounds.z0, s.bounds.z0),
+                         std::max(d.bounds.x1, s.bounds.x1), std::max(d.bounds.y1, s.bounds.y1), std::max(d.bounds.z1, s.bounds.z1) };
+            if (m->largest < 0 || d.size > m->islands[m->largest].size) m->largest = id;
+        }
+    return count;
+}
+
+static void islandsInit(IslandMap* m, const uint8_t* data, const int size)
+{
+    m->size = size;
+    m->chunks = (size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    m->chunk.assign(static_cast<size_t>(m->chunks) * m->chunks * m->chunks, {});
+    for (IslandChunk& c : m->chunk) c.dirty = true;
+    islandsUpdate(m, data);
+}
+
+// Chunks overlapping box need relabeling (no neighbour growth: borders are rejoined on every update)
+static void islandsMarkDirty(IslandMap* m, const VoxelBox& box)
+{
+    if (box.empty()) return;
+    const int last = m->size - 1;
+    for (int cz = std::max(box.z0, 0) / CHUNK_SIZE; cz <= std::min(box.z1 - 1, last) / CHUNK_SIZE; cz++)
+    for (int cy = std::max(box.y0, 0) / CHUNK_SIZE; cy <= std::min(box.y1 - 1, last) / CHUNK_SIZE; cy++)
+    for (int cx = std::max(box.x0, 0) / CHUNK_SIZE; cx <= std::min(box.x1 - 1, last) / CHUNK_SIZE; cx++)
+        m->chunk[(cz * m->chunks + cy) * m->chunks + cx].dirty = true;
+}
+
+// Island id of a voxel, -1 for air
+static int islandAt(const IslandMap* m, const int x, const int y, const int z)
+{
+    const IslandChunk& c = m->chunk[((z / CHUNK_SIZE) * m->chunks + y / CHUNK_SIZE) * m->chunks + x / CHUNK_SIZE];
+    if (c.label.empty()) return -1;
+    const int l = c.label[((z % CHUNK_SIZE) * CHUNK_SIZE + y % CHUNK_SIZE) * CHUNK_SIZE + x % CHUNK_SIZE];
+    return l ? m->node_island[c.base + l - 1] : -1;
+}
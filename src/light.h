@@ -0,0 +1,397 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+#include "voxel.h"
+
+// VOXEL LIGHT
+// Two light levels (0..15) per voxel packed into one byte: sky light in the high nibble, block light in
+// the low one. Sky light is 15 in every cell that sees the sky straight up and loses one level per step
+// from there; block light starts at 15 in LIGHT_LAMP voxels. Solid voxels stop both.
+// Both spread breadth first, chunk by chunk: every round the chunks with queued cells run their own BFS in
+// parallel, writing only their own cells and spilling into per direction outboxes; the outboxes are then
+// merged in parallel by the receiving chunk. Edits relight incrementally: light around the edited chunks is
+// removed with a reverse BFS, and whatever still lights its border is spread back in.
+// The grid is x fastest with y up, sky light falls from y = size - 1; cell indices are kept in 32 bits.
+
+#define LIGHT_MAX 15
+#define LIGHT_LAMP 3 // emitting material
+#define LIGHT_SKY 4  // nibble shifts
+#define LIGHT_BLOCK 0
+
+struct LightChunk
+{
+    std::vector<uint16_t> queue;  // local cells to spread from, x fastest with CHUNK_SIZE strides
+    std::vector<uint16_t> out[6]; // spill into the neighbour chunk per direction: local cell << 4 | level
+    std::vector<uint8_t> before;  // levels before the running update, empty if untouched
+    bool dirty;                   // voxels edited since the last update
+    bool changed;                 // light changed, the mesh around it needs rebaking
+};
+
+struct LightMap
+{
+    int size;
+    int chunks; // per axis
+    std::vector<uint8_t> level; // sky << 4 | block
+    std::vector<LightChunk> chunk;
+    std::vector<int> active;    // scratch
+    std::vector<uint8_t> pending;
+    bool tracking;              // snapshot touched chunks to find the ones that changed
+};
+
+static const int kLightStep[6][3] = { {-1,0,0}, {1,0,0}, {0,-1,0}, {0,1,0}, {0,0,-1}, {0,0,1} };
+
+static size_t lightIndex(const LightMap* m, const int x, const int y, const int z)
+{
+    return (static_cast<size_t>(z) * m->size + y) * m->size + x;
+}
+
+static int lightChunkIndex(const LightMap* m, const int x, const int y, const int z)
+{
+    return ((z / CHUNK_SIZE) * m->chunks + y / CHUNK_SIZE) * m->chunks + x / CHUNK_SIZE;
+}
+
+static int lightLocal(const int x, const int y, const int z)
+{
+    return ((z % CHUNK_SIZE) * CHUNK_SIZE + y % CHUNK_SIZE) * CHUNK_SIZE + x % CHUNK_SIZE;
+}
+
+// Keeps a copy of the chunk's levels the first time an update writes to it
+static void lightTouch(LightMap* m, const int index)
+{
+    LightChunk& c = m->chunk[index];
+    if (!m->tracking || !c.before.empty()) return;
+    const int n = m->size, cx = index % m->chunks, cy = index / m->chunks % m->chunks, cz = index / (m->chunks * m->chunks);
+    const int x0 = cx * CHUNK_SIZE, x1 = std::min(x0 + CHUNK_SIZE, n);
+    c.before.resize(CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE);
+    for (int z = cz * CHUNK_SIZE; z < std::min(cz * CHUNK_SIZE + CHUNK_SIZE, n); z++)
+    for (int y = cy * CHUNK_SIZE; y < std::min(cy * CHUNK_SIZE + CHUNK_SIZE, n); y++)
+        memcpy(&c.before[lightLocal(x0, y, z)], &m->level[lightIndex(m, x0, y, z)], x1 - x0);
+}
+
+static void lightPush(LightMap* m, const int x, const int y, const int z)
+{
+    m->chunk[lightChunkIndex(m, x, y, z)].queue.push_back(static_cast<uint16_t>(lightLocal(x, y, z)));
+}
+
+// Level a neighbour gets from a cell at level L: sky light keeps full strength going down
+static int lightNext(const int shift, const int dir, const int L)
+{
+    return shift == LIGHT_SKY && dir == 2 && L == LIGHT_MAX ? LIGHT_MAX : L - 1;
+}
+
+// Drains one chunk's queue inside the chunk, spilling across its faces into the outboxes
+static void lightSpreadChunk(LightMap* m, const uint8_t* data, const int shift, const int index)
+{
+    LightChunk& c = m->chunk[index];
+    lightTouch(m, index);
+    const int n = m->size;
+    const int x0 = index % m->chunks * CHUNK_SIZE, y0 = index / m->chunks % m->chunks * CHUNK_SIZE, z0 = index / (m->chunks * m->chunks) * CHUNK_SIZE;
+    const int x1 = std::min(x0 + CHUNK_SIZE, n), y1 = std::min(y0 + CHUNK_SIZE, n), z1 = std::min(z0 + CHUNK_SIZE, n);
+    const uint8_t mask = static_cast<uint8_t>(LIGHT_MAX << shift);
+
+    for (size_t head = 0; head < c.queue.size(); head++) {
+        const int l = c.queue[head];
+        const int x = x0 + l % CHUNK_SIZE, y = y0 + l / CHUNK_SIZE % CHUNK_SIZE, z = z0 + l / (CHUNK_SIZE * CHUNK_SIZE);
+        const int L = m->level[lightIndex(m, x, y, z)] >> shift & LIGHT_MAX;
+        if (L <= 1) continue;
+        for (int d = 0; d < 6; d++) {
+            const int nx = x + kLightStep[d][0], ny = y + kLightStep[d][1], nz = z + kLightStep[d][2];
+            if (nx < 0 || ny < 0 || nz < 0 || nx >= n || ny >= n || nz >= n) continue;
+            const size_t ni = lightIndex(m, nx, ny, nz);
+            if (data[ni]) continue;
+            const int nl = lightNext(shift, d, L);
+            if (nx < x0 || ny < y0 || nz < z0 || nx >= x1 || ny >= y1 || nz >= z1) {
+                c.out[d].push_back(static_cast<uint16_t>(lightLocal(nx, ny, nz) << 4 | nl));
+                continue;
+            }
+            uint8_t& v = m->level[ni];
+            if ((v >> shift & LIGHT_MAX) >= nl) continue;
+            v = static_cast<uint8_t>((v & ~mask) | nl << shift);
+            c.queue.push_back(static_cast<uint16_t>(lightLocal(nx, ny, nz)));
+        }
+    }
+    c.queue.clear();
+}
+
+// Takes the spills aimed at this chunk, queues the cells they raised
+static void lightMergeChunk(LightMap* m, const int shift, const int index)
+{
+    const int k = m->chunks;
+    const int cx = index % k, cy = index / k % k, cz = index / (k * k);
+    const int x0 = cx * CHUNK_SIZE, y0 = cy * CHUNK_SIZE, z0 = cz * CHUNK_SIZE;
+    const uint8_t mask = static_cast<uint8_t>(LIGHT_MAX << shift);
+    LightChunk& c = m->chunk[index];
+
+    for (int d = 0; d < 6; d++) {
+        const int sx = cx - kLightStep[d][0], sy = cy - kLightStep[d][1], sz = cz - kLightStep[d][2];
+        if (sx < 0 || sy < 0 || sz < 0 || sx >= k || sy >= k || sz >= k) continue;
+        std::vector<uint16_t>& in = m->chunk[(sz * k + sy) * k + sx].out[d];
+        if (in.empty()) continue;
+        lightTouch(m, index);
+        for (const uint16_t e : in) {
+            const int l = e >> 4, nl = e & LIGHT_MAX;
+            uint8_t& v = m->level[lightIndex(m, x0 + l % CHUNK_SIZE, y0 + l / CHUNK_SIZE % CHUNK_SIZE, z0 + l / (CHUNK_SIZE * CHUNK_SIZE))];
+            if ((v >> shift & LIGHT_MAX) >= nl) continue;
+            v = static_cast<uint8_t>((v & ~mask) | nl << shift);
+            c.queue.push_back(static_cast<uint16_t>(l));
+        }
+        in.clear();
+    }
+}
+
+// Runs BFS rounds of one channel until no chunk has queued cells
+static void lightSpread(LightMap* m, const uint8_t* data, const int shift)
+{
+    const int k = m->chunks, total = static_cast<int>(m->chunk.size());
+    m->pending.assign(total, 0);
+    while (true) {
+        m->active.clear();
+        for (int i = 0; i < total; i++)
+            if (!m->chunk[i].queue.empty()) m->active.push_back(i);
+        if (m->active.empty()) return;
+
+        int count = static_cast<int>(m->active.size());
+        #pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < count; i++) lightSpreadChunk(m, data, shift, m->active[i]);
+
+        // Receivers: the six neighbours of every chunk that ran
+        for (int i = 0; i < count; i++) {
+            const int index = m->active[i];
+            const int cx = index % k, cy = index / k % k, cz = index / (k * k);
+            for (int d = 0; d < 6; d++) {
+                const int nx = cx + kLightStep[d][0], ny = cy + kLightStep[d][1], nz = cz + kLightStep[d][2];
+                if (nx < 0 || ny < 0 || nz < 0 || nx >= k || ny >= k || nz >= k) continue;
+                const int ni = (nz * k + ny) * k + nx;
+                if (!m->pending[ni]) m->active.push_back(ni);
+                m->pending[ni] = 1;
+            }
+        }
+        const int receivers = static_cast<int>(m->active.size()) - count;
+        #pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < receivers; i++) {
+            const int index = m->active[count + i];
+            lightMergeChunk(m, shift, index);
+            m->pending[index] = 0;
+        }
+    }
+}
+
+// Relights the whole grid; no chunk is left flagged changed, the caller rebakes every mesh chunk anyway
+static void lightRelight(LightMap* m, const uint8_t* data)
+{
+    const int n = m->size;
+    m->tracking = false;
+
+    // Sky columns from the top down to the first solid voxel, lamps at full block light
+    #pragma omp parallel for
+    for (int z = 0; z < n; z++)
+        for (int x = 0; x < n; x++) {
+            bool open = true;
+            for (int y = n - 1; y >= 0; y--) {
+                const size_t i = lightIndex(m, x, y, z);
+                open = open && !data[i];
+                m->level[i] = static_cast<uint8_t>((open ? LIGHT_MAX << LIGHT_SKY : 0) | (data[i] == LIGHT_LAMP ? LIGHT_MAX : 0));
+            }
+        }
+
+    // Sky light only spreads from column cells next to air that is not lit straight from above
+    const int total = static_cast<int>(m->chunk.size()), k = m->chunks;
+    #pragma omp parallel for schedule(dynamic)
+    for (int index = 0; index < total; index++) {
+        const int x0 = index % k * CHUNK_SIZE, y0 = index / k % k * CHUNK_SIZE, z0 = index / (k * k) * CHUNK_SIZE;
+        for (int z = z0; z < std::min(z0 + CHUNK_SIZE, n); z++)
+        for (int y = y0; y < std::min(y0 + CHUNK_SIZE, n); y++)
+        for (int x = x0; x < std::min(x0 + CHUNK_SIZE, n); x++) {
+            if ((m->level[lightIndex(m, x, y, z)] >> LIGHT_SKY) != LIGHT_MAX) continue;
+            for (int d = 0; d < 6; d++) {
+                const int nx = x + kLightStep[d][0], ny = y + kLightStep[d][1], nz = z + kLightStep[d][2];
+                if (nx < 0 || ny < 0 || nz < 0 || nx >= n || ny >= n || nz >= n) continue;
+                const size_t ni = lightIndex(m, nx, ny, nz);
+                if (data[ni] || (m->level[ni] >> LIGHT_SKY) == LIGHT_MAX) continue;
+                lightPush(m, x, y, z);
+                break;
+            }
+        }
+    }
+    lightSpread(m, data, LIGHT_SKY);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int index = 0; index < total; index++) {
+        const int x0 = index % k * CHUNK_SIZE, y0 = index / k % k * CHUNK_SIZE, z0 = index / (k * k) * CHUNK_SIZE;
+        for (int z = z0; z < std::min(z0 + CHUNK_SIZE, n); z++)
+        for (int y = y0; y < std::min(y0 + CHUNK_SIZE, n); y++)
+        for (int x = x0; x < std::min(x0 + CHUNK_SIZE, n); x++)
+            if (data[lightIndex(m, x, y, z)] == LIGHT_LAMP) lightPush(m, x, y, z);
+    }
+    lightSpread(m, data, LIGHT_BLOCK);
+
+    for (LightChunk& c : m->chunk) {
+        c.dirty = false;
+        c.changed = false;
+    }
+}
+
+static void lightInit(LightMap* m, const uint8_t* data, const int size)
+{
+    m->size = size;
+    m->chunks = (size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    m->level.assign(static_cast<size_t>(size) * size * size, 0);
+    m->chunk.assign(static_cast<size_t>(m->chunks) * m->chunks * m->chunks, {});
+    lightRelight(m, data);
+}
+
+// Removes one channel around the dirty chunks and spreads back what still reaches them
+static void lightUpdateChannel(LightMap* m, const uint8_t* data, const int shift, const std::vector<int>& dirty)
+{
+    const int n = m->size, k = m->chunks;
+    const uint8_t mask = static_cast<uint8_t>(LIGHT_MAX << shift);
+    std::vector<std::pair<uint32_t, uint8_t>> removed;
+    const auto get = [&](const size_t i) { return m->level[i] >> shift & LIGHT_MAX; };
+    const auto set = [&](const size_t i, const int v) { m->level[i] = static_cast<uint8_t>((m->level[i] & ~mask) | v << shift); };
+    const auto remove = [&](const int x, const int y, const int z) {
+        const size_t i = lightIndex(m, x, y, z);
+        if (!get(i)) return;
+        lightTouch(m, lightChunkIndex(m, x, y, z));
+        removed.push_back({ static_cast<uint32_t>(i), static_cast<uint8_t>(get(i)) });
+        set(i, 0);
+    };
+
+    // Column tops over the dirty chunks: cells below a new top lose their sky light
+    std::vector<int> tops;
+    if (shift == LIGHT_SKY)
+        for (const int index : dirty) {
+            const int x0 = index % k * CHUNK_SIZE, z0 = index / (k * k) * CHUNK_SIZE;
+            for (int z = z0; z < std::min(z0 + CHUNK_SIZE, n); z++)
+            for (int x = x0; x < std::min(x0 + CHUNK_SIZE, n); x++) {
+                int top = n;
+                while (top > 0 && !data[lightIndex(m, x, top - 1, z)]) top--;
+                tops.push_back(top);
+                for (int y = 0; y < top; y++)
+                    if (get(lightIndex(m, x, y, z)) == LIGHT_MAX) remove(x, y, z);
+            }
+        }
+
+    for (const int index : dirty) {
+        const int x0 = index % k * CHUNK_SIZE, y0 = index / k % k * CHUNK_SIZE, z0 = index / (k * k) * CHUNK_SIZE;
+        for (int z = z0; z < std::min(z0 + CHUNK_SIZE, n); z++)
+        for (int y = y0; y < std::min(y0 + CHUNK_SIZE, n); y++)
+        for (int x = x0; x < std::min(x0 + CHUNK_SIZE, n); x++) remove(x, y, z);
+    }
+
+    // Reverse BFS: darker neighbours were lit through the removed cells, brighter ones relight the hole.
+    // Sky cells still at full level all sit in open columns now, so they always count as brighter.
+    for (size_t head = 0; head < removed.size(); head++) {
+        const size_t i = removed[head].first;
+        const int L = removed[head].second;
+        const int x = static_cast<int>(i % n), y = static_cast<int>(i / n % n), z = static_cast<int>(i / (static_cast<size_t>(n) * n));
+        for (int d = 0; d < 6; d++) {
+            const int nx = x + kLightStep[d][0], ny = y + kLightStep[d][1], nz = z + kLightStep[d][2];
+            if (nx < 0 || ny < 0 || nz < 0 || nx >= n || ny >= n || nz >= n) continue;
+            const int nl = get(lightIndex(m, nx, ny, nz));
+            if (!nl) continue;
+            if (nl < L) remove(nx, ny, nz);
+            else lightPush(m, nx, ny, nz);
+        }
+    }
+
+    // Sources inside the region
+    if (shift == LIGHT_SKY) {
+        int t = 0;
+        for (const int index : dirty) {
+            const int x0 = index % k * CHUNK_SIZE, z0 = index / (k * k) * CHUNK_SIZE;
+            for (int z = z0; z < std::min(z0 + CHUNK_SIZE, n); z++)
+            for (int x = x0; x < std::min(x0 + CHUNK_SIZE, n); x++)
+                for (int y = tops[t++]; y < n; y++) {
+                    const size_t i = lightIndex(m, x, y, z);
+                    if (get(i) == LIGHT_MAX) continue;
+                    lightTouch(m, lightChunkIndex(m, x, y, z));
+                    set(i, LIGHT_MAX);
+                    lightPush(m, x, y, z);
+                }
+        }
+    } else {
+        for (const int index : dirty) {
+            const int x0 = index % k * CHUNK_SIZE, y0 = index / k % k * CHUNK_SIZE, z0 = index / (k * k) * CHUNK_SIZE;
+            for (int z = z0; z < std::min(z0 + CHUNK_SIZE, n); z++)
+            for (int y = y0; y < std::min(y0 + CHUNK_SIZE, n); y++)
+            for (int x = x0; x < std::min(x0 + CHUNK_SIZE, n); x++) {
+                const size_t i = lightIndex(m, x, y, z);
+                if (data[i] != LIGHT_LAMP) continue;
+                lightTouch(m, index);
+                set(i, LIGHT_MAX);
+                lightPush(m, x, y, z);
+            }
+        }
+    }
+    lightSpread(m, data, shift);
+}
+
+// Relights around the chunks flagged dirty and flags exactly the chunks whose light changed in this update.
+// Returns how many were dirty.
+static int lightUpdate(LightMap* m, const uint8_t* data)
+{
+    std::vector<int> dirty;
+    for (int i = 0; i < static_cast<int>(m->chunk.size()); i++)
+        if (m->chunk[i].dirty) dirty.push_back(i);
+    if (dirty.empty()) return 0;
+
+    m->tracking = true;
+    lightUpdateChannel(m, data, LIGHT_SKY, dirty);
+    lightUpdateChannel(m, data, LIGHT_BLOCK, dirty);
+
+    const int n = m->size, k = m->chunks, total = static_cast<int>(m->chunk.size());
+    #pragma omp parallel for schedule(dynamic)
+    for (int index = 0; index < total; index++) {
+        LightChunk& c = m->chunk[index];
+        c.dirty = false;
+        c.changed = false;
+        if (c.before.empty()) continue;
+        const int x0 = index % k * CHUNK_SIZE, y0 = index / k % k * CHUNK_SIZE, z0 = index / (k * k) * CHUNK_SIZE;
+        const int x1 = std::min(x0 + CHUNK_SIZE, n);
+        for (int z = z0; z < std::min(z0 + CHUNK_SIZE, n) && !c.changed; z++)
+        for (int y = y0; y < std::min(y0 + CHUNK_SIZE, n) && !c.changed; y++)
+            c.changed = memcmp(&c.before[lightLocal(x0, y, z)], &m->level[lightIndex(m, x0, y, z)], x1 - x0) != 0;
+        c.before.clear();
+    }
+    return static_cast<int>(dirty.size());
+}
+
+// Brighter of the two channels, full sky outside the grid
+static int lightAt(const LightMap* m, const int x, const int y, const int z)
+{
+    if (x < 0 || y < 0 || z < 0 || x >= m->size || y >= m->size || z >= m->size) return LIGHT_MAX;
+    const uint8_t v = m->level[lightIndex(m, x, y, z)];
+    return std::max(v >> LIGHT_SKY, v & LIGHT_MAX);
+}
+
+// Corner levels of a face (4 bits each, kFaceQuad order): the average of the non-solid cells in front of the
+// face that share the corner, so light fades smoothly across faces
+static uint16_t lightFaceCorners(const LightMap* m, const uint8_t* data, const int x, const int y, const int z, const int dir)
+{
+    const int axis = dir >> 1, u = (axis + 1) % 3, v = (axis + 2) % 3;
+    int front[3] = { x, y, z };
+    front[axis] += dir & 1 ? 1 : -1;
+
+    static const int kCorner[6][4] = { {0,4,6,2}, {1,3,7,5}, {0,1,5,4}, {2,6,7,3}, {0,2,3,1}, {4,5,7,6} };
+    uint16_t packed = 0;
+    for (int k = 0; k < 4; k++) {
+        const int c = kCorner[dir][k];
+        const int bit[3] = { c & 1, c >> 1 & 1, c >> 2 & 1 };
+        int sum = 0, count = 0;
+        for (int j = 0; j < 2; j++)
+        for (int i = 0; i < 2; i++) {
+            int p[3] = { front[0], front[1], front[2] };
+            p[u] += bit[u] - 1 + i;
+            p[v] += bit[v] - 1 + j;
+            const bool inside = p[0] >= 0 && p[1] >= 0 && p[2] >= 0 && p[0] < m->size && p[1] < m->size && p[2] < m->size;
+            if (inside && data[lightIndex(m, p[0], p[1], p[2])] && !(i == 1 - bit[u] && j == 1 - bit[v])) continue;
+            sum += lightAt(m, p[0], p[1], p[2]);
+            count++;
+        }
+        const int level = count ? (sum + count / 2) / count : 0;
+        packed = static_cast<uint16_t>(packed | level << (k * 4));
+    }
+    return packed;
+}
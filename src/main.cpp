@@ -1,6 +1,7 @@
 #include "../lib/SDL/include/SDL3/SDL.h"
 #include "../lib/imgui/imgui.h"
 #include <iostream>
+#include <random>
 
 #define CORE_IMPLEMENTATION
 #define MATH_IMPLEMENTATION
@@ -11,215 +12,385 @@
 #define RENDER3D_IMPLEMENTATION
 #include "../lib/wrapper/core.h"
 
-#define GRID_SIZE 200
+#include "voxel.h"
+#include "raster.h"
+#include "mesh.h"
+#include "csg.h"
+#include "islands.h"
+#include "debris.h"
+#include "fluid.h"
+#include "light.h"
+#include "collide.h"
+#include "query.h"
+#include "path.h"
+#include "stats.h"
+#include "clock.h"
+#include "gen.h"
+#include "store.h"
+#include "graph.h"
+#include "import.h"
+#include "automata.h"
+#include "batch.h"
+#include "serve.h"
+#include "split.h"
+#include "bench.h"
+
 #define WIDTH 2100
 #define HEIGHT 1300
 
-// VOXEL DATA STRUCTURE
-struct VoxelGrid
-{
-    uint8_t data[GRID_SIZE][GRID_SIZE][GRID_SIZE];
-    int size;
+struct State {
+    Window_t win;
+    Renderer r;
+    SDL_Texture* texture;
+    Camera cam;
+    Input input;
+    Player player;
+    VoxelGrid voxels;
+    VoxelMesh* mesh;
+    CsgBatch* csg;
+    IslandMap* islands;
+    DebrisWorld* debris;
+    CaGrid* ca;
+    FluidGrid* fluid;
+    LightMap* light;
+    QueryWorld* query;
+    PathGraph* paths;
+    PathService* path_service;
+    WorldStats* stats;
+    ChunkStore* store;
+    GeneratorGraph* graph;
+    int world_kind; // 0 = terrain from the store, 1 = sponge, 2 = sponge from a coarse lattice, 3 = cells, 4 = warped fBm, 5 = graph
+    int world_seed;
+    int world_origin[3]; // voxel the grid's corner shows of the generated world
+    bool streaming;                    // the grid is a terrain window still being filled from the store
+    uint8_t streamed[CHUNKS * CHUNKS]; // chunk columns (cz * CHUNKS + cx) filled so far
+    int stream_origin[3];              // world_origin when the window was generated
+    int stream_radius;                 // in chunks around the camera
+    SimClock clock;
+    long long sim_ticks; // fixed ticks simulated so far
+    Vec3 sim_pos;      // camera position after the last tick
+    Vec3 sim_prev_pos; // and the tick before, the frame shows a blend of both
+    float light_angle;
+    float light_prev;
+    float sim_ms;
+    Framebuffer fb;
+    RasterScratch* raster;
+    uint32_t* aa_color;
+    float fov;
+    float ortho_scale;
+    float raster_ms;
+    float aa_ms;
+    int brush_shape;
+    int brush_radius;
+    uint32_t mouse_prev;
+    double edit_start_ms;
+    float edit_ms;
+    float remesh_ms;
+    int remesh_chunks;
+    int scatter;
+    float csg_ms;
+    float islands_ms;
+    float debris_ms;
+    int ca_rule; // 0 = off, else kCaRules index + 1
+    int ca_gens;
+    float ca_ms;
+    float fluid_ms;
+    int fluid_ticks;
+    float light_ms;
+    int path_rate; // random queries kept in flight
+    int path_found;
+    int path_done;
+    float path_ms;
+    float path_query_ms;
+    bool running;
+    bool faster;
+    bool light_rot;
+    bool soft;
+    bool aa;
+    bool ortho;
+    bool edit_pending;
+    bool track_islands;
+    bool debris_on;
+    bool lighting;
+    bool pathing;
+    bool walk; // player movement with collision instead of free flight
+    bool ca_stale; // grid edited outside the automaton, reload before the next generation
+};
 
-    void init()
-    {
-        size = GRID_SIZE;
-        memset(data, 0, sizeof(data));
-    }
+static State state = {};
 
-    void setSphere(const float radius)
-    {
-        for (int z = 0; z < size; z++)
-        for (int y = 0; y < size; y++)
-        for (int x = 0; x < size; x++)
-            data[z][y][x] = ((x - size * 0.5f)*(x - size * 0.5f) + (y - size * 0.5f)*(y - size * 0.5f) + (z - size * 0.5f)*(z - size * 0.5f) < radius*radius) ? 1 : 0;
+// Ray through the cursor (or the screen center while the mouse is grabbed), in voxel coordinates
+static void screenRay(const float mx, const float my, float origin[3], float dir[3])
+{
+    const Vec3 f = state.cam.front, r = state.cam.right;
+    const Vec3 u = vec3(r.y * f.z - r.z * f.y, r.z * f.x - r.x * f.z, r.x * f.y - r.y * f.x);
+    const float half = state.voxels.size * 0.5f;
+    const bool center = isMouseGrabbed(&state.input);
+    const float sx = center ? 0.0f : mx - state.win.width * 0.5f;
+    const float sy = center ? 0.0f : state.win.height * 0.5f - my;
+
+    Vec3 o = state.cam.position, d = f;
+    if (state.soft && state.ortho) {
+        o = vec3(o.x + (r.x * sx + u.x * sy) / state.ortho_scale, o.y + (r.y * sx + u.y * sy) / state.ortho_scale, o.z + (r.z * sx + u.z * sy) / state.ortho_scale);
+    } else {
+        const float focal = state.win.height * 0.5f / tanf(state.fov * 0.5f * 3.14159265f / 180.0f);
+        d = norm(vec3(f.x + (r.x * sx + u.x * sy) / focal, f.y + (r.y * sx + u.y * sy) / focal, f.z + (r.z * sx + u.z * sy) / focal));
     }
 
-    void setCube(const int cx, const int cy, const int cz, int size)
-    {
-        const int half = size / 2;
-        for (int z = cz - half; z <= cz + half; z++)
-        for (int y = cy - half; y <= cy + half; y++)
-        for (int x = cx - half; x <= cx + half; x++)
-            if (x >= 0 && x < this->size &&
-                y >= 0 && y < this->size &&
-                z >= 0 && z < this->size)
-                data[z][y][x] = 1;
-    }
+    origin[0] = o.x + half; origin[1] = o.y + half; origin[2] = o.z + half;
+    dir[0] = d.x; dir[1] = d.y; dir[2] = d.z;
+}
 
-    // Helper functions
-    static float clamp(const float x, const float min, const float max) {
-        return fmaxf(min, fminf(max, x));
+// Left click adds, right click removes, at the voxel under the cursor
+static void applyBrush(const bool add, const float mx, const float my)
+{
+    float origin[3], dir[3];
+    int hit[3], normal[3];
+    screenRay(mx, my, origin, dir);
+    const QueryRay ray = { { origin[0], origin[1], origin[2] }, { dir[0], dir[1], dir[2] }, 1e4f };
+    QueryHit h;
+    if (!queryRaycast(state.query, ray, &h)) return;
+    for (int a = 0; a < 3; a++) {
+        hit[a] = h.voxel[a];
+        normal[a] = h.normal[a];
     }
 
-    static float mix(const float a, const float b, const float t)
-    {
-        return a + t * (b - a);
+    // Water pours into the air in front of the hit, or drains around it
+    if (state.brush_shape == 4) {
+        fluidFill(state.fluid, &state.voxels, static_cast<float>(hit[0] + normal[0]), static_cast<float>(hit[1] + normal[1]),
+                  static_cast<float>(hit[2] + normal[2]), state.brush_radius + 0.5f, add ? FLUID_FULL : 0);
+        return;
     }
 
-    static float smoothstep(const float edge0, const float edge1, float x)
-    {
-        x = clamp((x - edge0) / (edge1 - edge0), 0.0f, 1.0f);
-        return x * x * (3 - 2 * x);
+    const int cx = hit[0] + (add ? normal[0] : 0);
+    const int cy = hit[1] + (add ? normal[1] : 0);
+    const int cz = hit[2] + (add ? normal[2] : 0);
+    const uint8_t value = add ? (state.brush_shape == 5 ? LIGHT_LAMP : 1) : 0;
+    const float x = static_cast<float>(cx), y = static_cast<float>(cy), z = static_cast<float>(cz);
+    const float radius = state.brush_radius + 0.5f;
+    VoxelBox box;
+    switch (state.brush_shape) {
+        case 0: case 5: box = state.voxels.stampSphere(x, y, z, radius, value); break;
+        case 1: box = state.voxels.setCube(cx, cy, cz, state.brush_radius * 2 + 1, value); break;
+        case 2: box = state.voxels.stampCylinder(x, z, radius, cy - state.brush_radius, cy + state.brush_radius + 1, value); break;
+        default: {
+            // Capsule along the camera's right vector
+            const float a[3] = { x - state.cam.right.x * state.brush_radius, y - state.cam.right.y * state.brush_radius, z - state.cam.right.z * state.brush_radius };
+            const float b[3] = { x + state.cam.right.x * state.brush_radius, y + state.cam.right.y * state.brush_radius, z + state.cam.right.z * state.brush_radius };
+            box = state.voxels.stampCapsule(a, b, radius * 0.5f, value);
+        }
     }
 
-    static float fract(const float x)
-    {
-        return x - floorf(x);
-    }
+    meshMarkDirty(state.mesh, box);
+    if (!state.edit_pending) state.edit_start_ms = nowMs();
+    state.edit_pending = true;
+    state.ca_stale = true;
+}
 
-    static float hash3(const float x, const float y, const float z)
-    {
-        return fract(sin(dot(vec3(x, y, z), vec3(12.9898, 78.233, 45.164))) * 43758.5453);
+// Queues count small random CSG edits (union or subtract, random primitive and orientation) as one batch
+static void scatterEdits(const int count)
+{
+    static std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (int i = 0; i < count; i++) {
+        const float pos[3] = { unit(rng) * GRID_SIZE, unit(rng) * GRID_SIZE, unit(rng) * GRID_SIZE };
+        const float rot[3] = { unit(rng) * 360.0f, unit(rng) * 360.0f, unit(rng) * 360.0f };
+        const float scale[3] = { 1.5f + unit(rng) * 3.0f, 1.5f + unit(rng) * 3.0f, 1.5f + unit(rng) * 3.0f };
+        const auto shape = static_cast<uint8_t>(rng() % 4);
+        const uint8_t op = rng() % 2 ? CSG_UNION : CSG_SUBTRACT;
+        csgPush(state.csg, csgEdit(shape, op, 1, pos, rot, scale));
     }
 
-    float noise3(const float x, const float y, const float z)
-    {
-        const int ix = static_cast<int>(floorf(x));
-        const int iy = static_cast<int>(floorf(y));
-        const int iz = static_cast<int>(floorf(z));
-
-        const float fx = x - ix;
-        const float fy = y - iy;
-        const float fz = z - iz;
-
-        const float n000 = hash3(ix, iy, iz);
-        const float n100 = hash3(ix + 1, iy, iz);
-        const float n010 = hash3(ix, iy + 1, iz);
-        const float n110 = hash3(ix + 1, iy + 1, iz);
-        const float n001 = hash3(ix, iy, iz + 1);
-        const float n101 = hash3(ix + 1, iy, iz + 1);
-        const float n011 = hash3(ix, iy + 1, iz + 1);
-        const float n111 = hash3(ix + 1, iy + 1, iz + 1);
-
-        const float u = smoothstep(0.0f, 1.0f, fx);
-        const float v = smoothstep(0.0f, 1.0f, fy);
-        const float w = smoothstep(0.0f, 1.0f, fz);
-
-        const float nx00 = mix(n000, n100, u);
-        const float nx10 = mix(n010, n110, u);
-        const float nx01 = mix(n001, n101, u);
-        const float nx11 = mix(n011, n111, u);
-
-        const float ny0 = mix(nx00, nx10, v);
-        const float ny1 = mix(nx01, nx11, v);
-
-        return mix(ny0, ny1, w);
-    }
+    const double t = nowMs();
+    csgApply(state.csg, &state.voxels, state.mesh);
+    state.ca_stale = true;
+    state.csg_ms = static_cast<float>(nowMs() - t);
+}
 
-    void setRandomNoiseSponge()
-    {
-        memset(data, 0, sizeof(data));
-        constexpr float scale = 10.0f;
-
-        for (int z = 0; z < size; z++)
-        for (int y = 0; y < size; y++)
-        for (int x = 0; x < size; x++) {
-            const float nx = static_cast<float>(x) / size;
-            const float ny = static_cast<float>(y) / size;
-            const float nz = static_cast<float>(z) / size;
-            if (noise3(nx * scale, ny * scale, nz * scale) > 0.4f) data[z][y][x] = 1;
-        }
+// Terrain is shown from world_origin, pulling chunks from the store (a new seed starts a new store). The grid
+// starts as air and streamTerrain fills it in around the camera. The other generators fill the grid directly.
+// Every system follows the mesh dirty flags, so marking all chunks dirty rebuilds them over the next frame.
+// Water and debris belong to the old world and are dropped.
+static void generateWorld()
+{
+    if (state.world_kind == 0) {
+        GenTerrain t = genDefaultTerrain();
+        t.seed = static_cast<uint32_t>(state.world_seed);
+        if (state.store->gen.seed != t.seed || !state.store->capacity) storeInit(state.store, t, state.voxels.size, CHUNKS * CHUNKS * CHUNKS * 2);
+        memset(state.voxels.data, 0, sizeof(state.voxels.data));
+        memcpy(state.stream_origin, state.world_origin, sizeof(state.stream_origin));
+        memset(state.streamed, 0, sizeof(state.streamed));
     }
-
-    [[nodiscard]] bool at(const int x, const int y, const int z) const
-    {
-        if (x < 0 || y < 0 || z < 0) return false;
-        if (x >= size || y >= size || z >= size) return false;
-        return data[z][y][x] != 0;
+    state.streaming = state.world_kind == 0;
+    if (state.world_kind == 1) state.voxels.setRandomNoiseSponge();
+    else if (state.world_kind == 2) genSpongeCoarse(&state.voxels, 4);
+    else if (state.world_kind == 3) {
+        const GenWorley w = genDefaultWorley();
+        genWorley(&w, &state.voxels.data[0][0][0], state.voxels.size);
     }
-};
-
-struct State {
-    Window_t win;
-    Renderer r;
-    SDL_Texture* texture;
-    Camera cam;
-    Input input;
-    VoxelGrid voxels;
-    Model voxelModel;
-    bool running;
-    bool faster;
-    bool light_rot;
-};
-
-static State state = {};
+    else if (state.world_kind == 4) {
+        const GenWarp w = genDefaultWarp();
+        genWarped(&w, &state.voxels.data[0][0][0], state.voxels.size);
+    }
+    else if (state.world_kind == 5 && graphCompile(state.graph, state.voxels.size)) graphFill(state.graph, &state.voxels.data[0][0][0], state.voxels.size);
+    for (MeshChunk& c : state.mesh->chunks) c.dirty = true;
+    fluidFree(state.fluid);
+    fluidInit(state.fluid, state.voxels.size);
+    for (MeshChunk& c : state.fluid->mesh.chunks) c.dirty = true;
+    debrisFree(state.debris);
+    state.ca_stale = true;
+}
 
-static void buildVoxelModel(Model* m, const VoxelGrid* g)
+// Generates the terrain window a few chunk columns per frame, nearest the camera first, so chunks that are
+// never within stream_radius cost nothing. Columns are whole height so nothing streams in floating; edits,
+// water and debris already in a column are kept and the terrain fills in around them.
+static void streamTerrain()
 {
-    auto V = [&](const float x, const float y, const float z) {
-        return vec3(x - g->size * 0.5f, y - g->size * 0.5f, z - g->size * 0.5f);
-    };
-
-    int tri_count = 0;
-    const int offsets[6][3] = { {-1,0,0}, {1,0,0}, {0,-1,0}, {0,1,0}, {0,0,-1}, {0,0,1} };
-
-    for (int z = 0; z < g->size; z++)
-    for (int y = 0; y < g->size; y++)
-    for (int x = 0; x < g->size; x++) {
-        if (!g->at(x, y, z)) continue;
-        for (const auto offset : offsets) {
-            const int nx = x + offset[0];
-            const int ny = y + offset[1];
-            const int nz = z + offset[2];
-            if (!g->at(nx, ny, nz)) tri_count += 2; // 2 triangles per face
+    constexpr int kColumnsPerFrame = 4;
+    if (!state.streaming) return;
+    const float half = state.voxels.size * 0.5f;
+    const float px = std::clamp(state.cam.position.x + half, 0.0f, state.voxels.size - 1.0f) / CHUNK_SIZE;
+    const float pz = std::clamp(state.cam.position.z + half, 0.0f, state.voxels.size - 1.0f) / CHUNK_SIZE;
+    std::vector<std::pair<float, int>> near;
+    for (int cz = 0; cz < CHUNKS; cz++)
+        for (int cx = 0; cx < CHUNKS; cx++) {
+            const float dx = cx + 0.5f - px, dz = cz + 0.5f - pz, d = dx * dx + dz * dz;
+            if (!state.streamed[cz * CHUNKS + cx] && d <= state.stream_radius * state.stream_radius) near.push_back({ d, cz * CHUNKS + cx });
         }
+    const int n = std::min(static_cast<int>(near.size()), kColumnsPerFrame);
+    std::partial_sort(near.begin(), near.begin() + n, near.end());
+    for (int i = 0; i < n; i++) {
+        const int cx = near[i].second % CHUNKS, cz = near[i].second / CHUNKS;
+        const int size = state.voxels.size;
+        const VoxelBox box = { cx * CHUNK_SIZE, 0, cz * CHUNK_SIZE, std::min((cx + 1) * CHUNK_SIZE, size), size, std::min((cz + 1) * CHUNK_SIZE, size) };
+        storeFill(state.store, state.stream_origin, &state.voxels.data[0][0][0], size, box);
+        meshMarkDirty(state.mesh, box);
+        state.streamed[near[i].second] = 1;
+        state.ca_stale = true;
     }
+}
 
-    // Free old data
-    if (m->transformed_triangles) {
-        free(m->transformed_triangles);
-        m->transformed_triangles = nullptr;
+// One fixed step of everything that moves on its own: camera or player, light rotation, scatter edits,
+// the automaton, debris and water. Camera speeds are per second, 2 and 4 units per tick at 60 Hz.
+static void simTick(const float dt)
+{
+    state.sim_prev_pos = state.sim_pos;
+    state.light_prev = state.light_angle;
+    state.sim_ticks++;
+
+    const float run = state.faster ? 2.0f : 1.0f;
+    if (state.walk) {
+        // Walk on the ground plane of the view, the camera sits at eye height of the player
+        const float fx = state.cam.front.x, fz = state.cam.front.z, rx = state.cam.right.x, rz = state.cam.right.z;
+        const float fl = sqrtf(fx * fx + fz * fz) + 1e-6f, rl = sqrtf(rx * rx + rz * rz) + 1e-6f;
+        const float f = (isKeyDown(&state.input, KEY_W) ? 1.0f : 0.0f) - (isKeyDown(&state.input, KEY_S) ? 1.0f : 0.0f);
+        const float r = (isKeyDown(&state.input, KEY_D) ? 1.0f : 0.0f) - (isKeyDown(&state.input, KEY_A) ? 1.0f : 0.0f);
+        const float walk = 8.0f * run;
+        playerStep(&state.player, &state.voxels, (fx / fl * f + rx / rl * r) * walk, (fz / fl * f + rz / rl * r) * walk, std::min(dt, 0.05f));
+        const float half = state.voxels.size * 0.5f;
+        state.cam.position = vec3(state.player.pos[0] - half, state.player.pos[1] + PLAYER_EYE - half, state.player.pos[2] - half);
+    } else {
+        const float speed = 120.0f * run * dt;
+        if (isKeyDown(&state.input, KEY_W)) cameraMove(&state.cam, state.cam.front, speed);
+        if (isKeyDown(&state.input, KEY_S)) cameraMove(&state.cam, mul(state.cam.front, -1), speed);
+        if (isKeyDown(&state.input, KEY_A)) cameraMove(&state.cam, mul(state.cam.right, -1), speed);
+        if (isKeyDown(&state.input, KEY_D)) cameraMove(&state.cam, state.cam.right, speed);
     }
-
-    // Early exit if no geometry
-    if (tri_count == 0) {
-        m->num_triangles = 0;
-        return;
+    state.sim_pos = state.cam.position;
+    if (state.light_rot) state.light_angle += dt * 0.2f;
+
+    if (state.scatter) scatterEdits(state.scatter);
+    if (state.ca_rule) {
+        const double t = nowMs();
+        if (state.ca->size != state.voxels.size) {
+            caInit(state.ca, state.voxels.size);
+            state.ca_stale = true;
+        }
+        if (state.ca_stale) caLoad(state.ca, &state.voxels.data[0][0][0]);
+        state.ca_stale = false;
+        for (int g = 0; g < state.ca_gens; g++) caStep(state.ca, kCaRules[state.ca_rule - 1]);
+        caStore(state.ca, &state.voxels, state.mesh);
+        state.ca_ms = static_cast<float>(nowMs() - t);
     }
+    if (!state.debris->bodies.empty()) {
+        const double t = nowMs();
+        debrisStep(state.debris, &state.voxels, dt);
+        state.debris_ms = static_cast<float>(nowMs() - t);
+    }
+    {
+        const double t = nowMs();
+        const bool ticked = fluidUpdate(state.fluid, &state.voxels, state.sim_ticks, state.clock.hz);
+        state.fluid_ticks += ticked;
+        if (ticked) state.fluid_ms = static_cast<float>(nowMs() - t);
+    }
+}
 
-    m->transformed_triangles = static_cast<Triangle*>(malloc(sizeof(Triangle) * tri_count));
-    m->num_triangles = 0;
-
-    // Face vertex indices (matches your P[8] layout)
-    const int faces[6][6] = {
-        {0,4,6, 0,6,2}, // -X
-        {1,3,7, 1,7,5}, // +X
-        {0,1,5, 0,5,4}, // -Y
-        {2,6,7, 2,7,3}, // +Y
-        {0,2,3, 0,3,1}, // -Z
-        {4,5,7, 4,7,6}  // +Z
-    };
-
-    for (int z = 0; z < g->size; z++)
-    for (int y = 0; y < g->size; y++)
-    for (int x = 0; x < g->size; x++) {
-        if (!g->at(x, y, z)) continue;
-        Vec3 voxel_color = {1.0f, 1.0f, 1.0f};
-
-        // Build voxel corners
-        const Vec3 P[8] = { V(x, y, z), V(x+1, y, z), V(x, y+1, z), V(x+1, y+1, z), V(x, y, z+1), V(x+1, y, z+1), V(x, y+1, z+1), V(x+1, y+1, z+1) };
-
-        // Emit visible faces
-        for (int f = 0; f < 6; f++) {
-            const int nx = x + offsets[f][0];
-            const int ny = y + offsets[f][1];
-            const int nz = z + offsets[f][2];
-            if (!g->at(nx, ny, nz)) {
-                m->transformed_triangles[m->num_triangles++] = { P[faces[f][0]], P[faces[f][1]], P[faces[f][2]], voxel_color };
-                m->transformed_triangles[m->num_triangles++] = { P[faces[f][3]], P[faces[f][4]], P[faces[f][5]], voxel_color };
-            }
-        }
+// Software path: voxel rasterizer + optional face-id anti-aliasing, presented through the streaming texture
+static void renderSoftware()
+{
+    RasterView view;
+    rasterViewInit(&view, state.cam.position, state.cam.front, state.cam.right, state.fov, state.voxels.size * 0.5f);
+    view.light_dir = state.r.light_dir;
+    view.light = state.r.light;
+    view.ortho = state.ortho;
+    view.ortho_scale = state.ortho_scale;
+
+    double t = nowMs();
+    static std::vector<RasterBatch> batches;
+    batches.assign(state.mesh->batches.begin(), state.mesh->batches.end());
+    batches.insert(batches.end(), state.fluid->mesh.batches.begin(), state.fluid->mesh.batches.end());
+    debrisAppendBatches(state.debris, &batches);
+    rasterRender(&state.fb, state.raster, batches.data(), static_cast<int>(batches.size()), &view, 0, state.fb.height);
+    state.raster_ms = static_cast<float>(nowMs() - t);
+
+    const uint32_t* pixels = state.fb.color;
+    state.aa_ms = 0.0f;
+    if (state.aa) {
+        t = nowMs();
+        rasterAntiAlias(&state.fb, state.aa_color, 0, state.fb.height, 0);
+        state.aa_ms = static_cast<float>(nowMs() - t);
+        pixels = state.aa_color;
     }
 
-    // Safety check
-    assert(m->num_triangles == tri_count);
+    ASSERT(SDL_UpdateTexture(state.texture, nullptr, pixels, state.fb.width * static_cast<int>(sizeof(uint32_t))));
+    ASSERT(SDL_RenderTexture(state.win.renderer, state.texture, nullptr, nullptr));
 }
 
-int main()
+int main(int argc, char** argv)
 {
     memset(&state, 0, sizeof(state));
 
+    // Headless modes: build the world once, no window
+    if (argc > 1 && (!strcmp(argv[1], "batch") || !strcmp(argv[1], "serve") || !strcmp(argv[1], "split"))) {
+        state.voxels.init();
+        state.voxels.setRandomNoiseSponge();
+
+        auto* mesh = new VoxelMesh();
+        std::vector<VoxelFace> faces;
+        meshInit(mesh, &state.voxels);
+        meshFlatten(mesh, &faces);
+        meshFree(mesh);
+        delete mesh;
+
+        const int num_faces = static_cast<int>(faces.size());
+        const float half = state.voxels.size * 0.5f;
+        if (!strcmp(argv[1], "batch")) return batchRender(argc - 2, argv + 2, faces.data(), num_faces, half);
+        if (!strcmp(argv[1], "serve")) return serveRun(argc - 2, argv + 2, faces.data(), num_faces, half);
+        return splitRender(argc - 2, argv + 2, &state.voxels.data[0][0][0], state.voxels.size, faces.data(), num_faces);
+    }
+    if (argc > 1 && !strcmp(argv[1], "request")) return serveClient(argc - 2, argv + 2);
+    if (argc > 1 && !strcmp(argv[1], "bench")) {
+        state.voxels.init();
+        state.voxels.setRandomNoiseSponge();
+        return benchRun(argc - 2, argv + 2, &state.voxels);
+    }
+    ImportOptions import = {};
+    const bool view = argc > 1 && !strcmp(argv[1], "view");
+    if (view && !importParseArgs(&import, argc - 2, argv + 2)) {
+        fprintf(stderr, "usage: voxely view <file.pgm | file.raw --raw WxHxD> [--16] [--be] [--threshold N] [--levels N] [--height F]\n");
+        return 1;
+    }
+
     windowInit(&state.win);
     state.win.width = WIDTH;
     state.win.height = HEIGHT;
@@ -247,15 +418,46 @@ int main()
 
     state.voxels.init();
     state.voxels.setRandomNoiseSponge();
-
-    memset(&state.voxelModel, 0, sizeof(state.voxelModel));
-    buildVoxelModel(&state.voxelModel, &state.voxels);
+    if (view && !importRun(&import, &state.voxels.data[0][0][0], state.voxels.size)) return 1;
+
+    state.mesh = new VoxelMesh();
+    meshInit(state.mesh, &state.voxels);
+    state.csg = new CsgBatch();
+    state.islands = new IslandMap();
+    state.debris = new DebrisWorld();
+    state.fluid = new FluidGrid();
+    state.light = new LightMap();
+    state.query = new QueryWorld();
+    queryInit(state.query, &state.voxels.data[0][0][0], state.voxels.size);
+    state.paths = new PathGraph();
+    state.path_service = new PathService();
+    state.path_rate = 100;
+    state.stats = new WorldStats();
+    statsInit(state.stats, &state.voxels.data[0][0][0], state.voxels.size);
+    state.store = new ChunkStore();
+    state.graph = new GeneratorGraph();
+    graphInit(state.graph);
+    graphDefault(state.graph);
+    state.world_seed = static_cast<int>(genDefaultTerrain().seed % 1000);
+    state.stream_radius = 6;
+    fluidInit(state.fluid, state.voxels.size);
+    state.ca = new CaGrid();
+    state.ca_gens = 1;
+
+    framebufferInit(&state.fb, state.win.bWidth, state.win.bHeight);
+    state.raster = new RasterScratch();
+    state.aa_color = static_cast<uint32_t*>(malloc(sizeof(uint32_t) * state.fb.width * state.fb.height));
+    state.fov = 60.0f;
+    state.ortho_scale = 3.0f;
+    state.brush_radius = 3;
 
     renderInit(&state.r, &state.win, &state.cam);
 
     state.r.light_dir = vec3(0.3f, -1.0f, 0.5f);
     state.running = true;
     state.light_rot = true;
+    clockInit(&state.clock);
+    state.sim_pos = state.sim_prev_pos = state.cam.position;
 
     while (state.running)
     {
@@ -268,43 +470,266 @@ int main()
             else if (!isMouseGrabbed(&state.input)) grabMouse(state.win.window, state.win.width, state.win.height, &state.input);
 
             state.faster = isKeyDown(&state.input, KEY_LSHIFT);
-            const float speed = state.faster ? 4.0f : 2.0f;
 
             int dx, dy;
             getMouseDelta(&state.input, &dx, &dy);
             cameraRotate(&state.cam, dx * 0.3f, -dy * 0.3f);
 
-            if (isKeyDown(&state.input, KEY_W)) cameraMove(&state.cam, state.cam.front, speed);
-            if (isKeyDown(&state.input, KEY_S)) cameraMove(&state.cam, mul(state.cam.front, -1), speed);
-            if (isKeyDown(&state.input, KEY_A)) cameraMove(&state.cam, mul(state.cam.right, -1), speed);
-            if (isKeyDown(&state.input, KEY_D)) cameraMove(&state.cam, state.cam.right, speed);
+            float mx, my;
+            const SDL_MouseButtonFlags buttons = SDL_GetMouseState(&mx, &my);
+            const SDL_MouseButtonFlags pressed = buttons & ~state.mouse_prev;
+            state.mouse_prev = buttons;
+            if (!ImGui::GetIO().WantCaptureMouse) {
+                if (pressed & SDL_BUTTON_LMASK) applyBrush(true, mx, my);
+                if (pressed & SDL_BUTTON_RMASK) applyBrush(false, mx, my);
+            }
+            streamTerrain();
         }
         {
-            if (state.light_rot)
+            // Simulation runs at the clock's rate; the camera and light shown are blended between the last two ticks
+            const double sim_start = nowMs();
+            const int steps = clockAdvance(&state.clock, getDelta(&state.win));
+            state.cam.position = state.sim_pos;
+            if (steps) state.fluid_ticks = 0;
+            for (int i = 0; i < steps; i++) simTick(clockDt(&state.clock));
+            if (steps) state.sim_ms = static_cast<float>(nowMs() - sim_start);
+            const float a = state.clock.alpha;
+            const Vec3 p0 = state.sim_prev_pos, p1 = state.sim_pos;
+            state.cam.position = vec3(p0.x + (p1.x - p0.x) * a, p0.y + (p1.y - p0.y) * a, p0.z + (p1.z - p0.z) * a);
+            if (state.light_rot) {
+                const float angle = state.light_prev + (state.light_angle - state.light_prev) * a;
+                state.r.light_dir = norm(vec3(-cosf(angle), -0.35f, -sinf(angle)));
+            }
+            // Grid edits wake the water around them and may uncover or hide its surface
+            for (size_t i = 0; i < state.mesh->chunks.size(); i++)
+                if (state.mesh->chunks[i].dirty) {
+                    state.fluid->awake[i] = 1;
+                    state.fluid->calm[i] = 0;
+                    state.fluid->mesh.chunks[i].dirty = true;
+                }
+            if (state.track_islands) {
+                // Same chunk layout as the mesh, so its dirty flags say which chunks to relabel
+                const double t = nowMs();
+                bool any = false;
+                for (size_t i = 0; i < state.mesh->chunks.size(); i++)
+                    if (state.mesh->chunks[i].dirty) any = state.islands->chunk[i].dirty = true;
+                if (any) {
+                    islandsUpdate(state.islands, &state.voxels.data[0][0][0]);
+                    state.islands_ms = static_cast<float>(nowMs() - t);
+                    if (state.debris_on && debrisDetach(state.debris, &state.voxels, state.islands, state.mesh)) state.ca_stale = true;
+                }
+            }
+            if (state.lighting) {
+                // Relight around edited chunks, then rebake the faces next to any light that changed
+                const double t = nowMs();
+                for (size_t i = 0; i < state.mesh->chunks.size(); i++)
+                    if (state.mesh->chunks[i].dirty) state.light->chunk[i].dirty = true;
+                if (lightUpdate(state.light, &state.voxels.data[0][0][0])) {
+                    for (int i = 0; i < static_cast<int>(state.light->chunk.size()); i++) {
+                        if (!state.light->chunk[i].changed) continue;
+                        const int x0 = i % CHUNKS * CHUNK_SIZE, y0 = i / CHUNKS % CHUNKS * CHUNK_SIZE, z0 = i / (CHUNKS * CHUNKS) * CHUNK_SIZE;
+                        const VoxelBox box = { x0, y0, z0, x0 + CHUNK_SIZE, y0 + CHUNK_SIZE, z0 + CHUNK_SIZE };
+                        meshMarkDirty(state.mesh, box);
+                        meshMarkDirty(&state.fluid->mesh, box);
+                        state.light->chunk[i].changed = false;
+                    }
+                    state.light_ms = static_cast<float>(nowMs() - t);
+                }
+            }
+            // Keep the query pyramid in step with every chunk that is about to be remeshed
+            for (int i = 0; i < static_cast<int>(state.mesh->chunks.size()); i++)
+                if (state.mesh->chunks[i].dirty) {
+                    const int x0 = i % CHUNKS * CHUNK_SIZE, y0 = i / CHUNKS % CHUNKS * CHUNK_SIZE, z0 = i / (CHUNKS * CHUNKS) * CHUNK_SIZE;
+                    queryUpdate(state.query, { x0, y0, z0, x0 + CHUNK_SIZE, y0 + CHUNK_SIZE, z0 + CHUNK_SIZE });
+                }
+            for (size_t i = 0; i < state.mesh->chunks.size(); i++)
+                if (state.mesh->chunks[i].dirty) state.stats->chunk[i].dirty = true;
+            statsUpdate(state.stats, &state.voxels.data[0][0][0]);
+            if (state.pathing) {
+                // Clusters share the chunk layout too; results come back from the workers a frame or more later
+                static std::mt19937 rng(5);
+                static std::vector<PathResult> results;
+                const double t = nowMs();
+                for (size_t i = 0; i < state.mesh->chunks.size(); i++)
+                    if (state.mesh->chunks[i].dirty) state.paths->cluster[i].dirty = true;
+                if (pathUpdate(state.paths, &state.voxels.data[0][0][0])) state.path_ms = static_cast<float>(nowMs() - t);
+                results.clear();
+                const int queued = pathPoll(state.path_service, &results);
+                if (!results.empty()) {
+                    float ms = 0.0f;
+                    state.path_found = 0;
+                    for (const PathResult& r : results) {
+                        state.path_found += r.found;
+                        ms += r.ms;
+                    }
+                    state.path_done = static_cast<int>(results.size());
+                    state.path_query_ms = ms / state.path_done;
+                }
+                for (int i = queued; i < state.path_rate; i++) {
+                    PathCell a, b;
+                    if (pathRandomCell(state.paths, &rng, &a) && pathRandomCell(state.paths, &rng, &b)) pathRequest(state.path_service, a, b);
+                }
+            }
             {
-                static float lightAngle = 0.0f;
-                lightAngle += getDelta(&state.win) * 0.2f;
-                state.r.light_dir = norm(vec3(-cosf(lightAngle), -0.35f, -sinf(lightAngle)));
+                const double t = nowMs();
+                const int chunks = meshUpdate(state.mesh, &state.voxels);
+                if (chunks) {
+                    debrisWake(state.debris);
+                    state.remesh_ms = static_cast<float>(nowMs() - t);
+                    state.remesh_chunks = chunks;
+                }
             }
-            renderClear(&state.r);
-            renderModel(&state.r, &state.voxelModel);
 
-            ASSERT(updateFramebuffer(&state.win, state.texture));
+            if (state.soft) renderSoftware();
+            else {
+                renderClear(&state.r);
+                for (MeshChunk& c : state.mesh->chunks)
+                    if (c.model.num_triangles) renderModel(&state.r, &c.model);
+                for (MeshChunk& c : state.fluid->mesh.chunks)
+                    if (c.model.num_triangles) renderModel(&state.r, &c.model);
+                for (DebrisBody& b : state.debris->bodies)
+                    if (b.model.num_triangles) renderModel(&state.r, &b.model);
+                ASSERT(updateFramebuffer(&state.win, state.texture));
+            }
 
             imguiNewFrame();
                 ImGui::Begin("voxely");
                 ImGui::Text("Pos: %.1f, %.1f, %.1f", state.cam.position.x, state.cam.position.y, state.cam.position.z);
                 ImGui::Text("FPS: %.1f (%.2fms)", getFPS(&state.win), getDelta(&state.win) * 1000);
                 ImGui::Text("Grid: %dx%dx%d", GRID_SIZE, GRID_SIZE, GRID_SIZE);
-                ImGui::Text("Tris: %d", state.voxelModel.num_triangles);
+                ImGui::Text("Tris: %d", state.mesh->num_faces * 2);
+                {
+                    const WorldStats* st = state.stats;
+                    ImGui::Text("Solid: %llu voxels, %llu faces", static_cast<unsigned long long>(st->solid), static_cast<unsigned long long>(st->faces));
+                    if (!st->bounds.empty())
+                        ImGui::Text("Bounds: %d-%d, %d-%d, %d-%d", st->bounds.x0, st->bounds.x1, st->bounds.y0, st->bounds.y1, st->bounds.z0, st->bounds.z1);
+                    if (ImGui::TreeNode("Materials", "Materials: %d", st->num_materials)) {
+                        for (int m = 1; m < STATS_MATERIALS; m++)
+                            if (st->material[m]) ImGui::Text("%3d: %llu", m, static_cast<unsigned long long>(st->material[m]));
+                        ImGui::TreePop();
+                    }
+                }
+                ImGui::SliderInt("Tick Hz", &state.clock.hz, 10, 240);
+                ImGui::SliderInt("Max catch-up", &state.clock.max_steps, 1, 32);
+                ImGui::Text("Sim: %d steps (%.2fms), %lld dropped", state.clock.steps, state.sim_ms, state.clock.dropped);
                 ImGui::Separator();
                 ImGui::Checkbox("Close", &state.running);
                 ImGui::Checkbox("Light", &state.r.light);
                 ImGui::Checkbox("Light rotate", &state.light_rot);
+                ImGui::Separator();
+                ImGui::Checkbox("Voxel raster", &state.soft);
+                if (state.soft) {
+                    ImGui::Checkbox("AA", &state.aa);
+                    ImGui::Checkbox("Ortho", &state.ortho);
+                    if (state.ortho) {
+                        ImGui::SliderFloat("Zoom", &state.ortho_scale, 0.5f, 20.0f);
+                        if (ImGui::Button("Isometric")) {
+                            state.cam.yaw = -135.0f;
+                            state.cam.pitch = -35.264f;
+                            cameraUpdate(&state.cam);
+                        }
+                    }
+                    else ImGui::SliderFloat("FOV", &state.fov, 30.0f, 110.0f);
+                    ImGui::Text("Raster: %.2fms  AA: %.2fms", state.raster_ms, state.aa_ms);
+                }
+                ImGui::Separator();
+                static const char* shapes[] = { "Sphere", "Cube", "Cylinder", "Capsule", "Water", "Lamp" };
+                ImGui::Combo("Brush", &state.brush_shape, shapes, 6);
+                ImGui::SliderInt("Radius", &state.brush_radius, 0, 32);
+                ImGui::Text("Edit: %.2fms (remesh %.2fms, %d chunks)", state.edit_ms, state.remesh_ms, state.remesh_chunks);
+                static const char* worlds[] = { "Terrain", "Sponge", "Coarse sponge", "Cells", "Warped fBm", "Graph" };
+                ImGui::Combo("World", &state.world_kind, worlds, 6);
+                if (state.world_kind == 0) {
+                    ImGui::SliderInt("Seed", &state.world_seed, 0, 1000);
+                    ImGui::SliderInt("World X", &state.world_origin[0], -4096, 4096);
+                    ImGui::SliderInt("World Z", &state.world_origin[2], -4096, 4096);
+                    ImGui::SliderInt("Stream radius", &state.stream_radius, 1, CHUNKS * 2);
+                }
+                if (state.world_kind == 5) {
+                    // Thresholds sit below the cached noise, so moving one only reruns the fused programs
+                    for (size_t i = 0; i < state.graph->nodes.size(); i++) {
+                        if (state.graph->nodes[i].op != GRAPH_THRESHOLD) continue;
+                        char label[32];
+                        snprintf(label, sizeof(label), "Threshold %d", static_cast<int>(i));
+                        ImGui::SliderFloat(label, &state.graph->nodes[i].a, -1.0f, 1.0f);
+                    }
+                }
+                if (ImGui::Button("Generate")) {
+                    const double t = nowMs();
+                    generateWorld();
+                    state.edit_start_ms = t;
+                    state.edit_pending = true;
+                }
+                if (state.store->capacity)
+                    ImGui::Text("Store: %d chunks, %lld generated, %lld evicted", static_cast<int>(state.store->index.size()), state.store->generated, state.store->evicted);
+                if (state.graph->hits + state.graph->misses)
+                    ImGui::Text("Graph: %d fields, %lld hits, %lld computed", static_cast<int>(state.graph->cache.size()), state.graph->hits, state.graph->misses);
+                ImGui::SliderInt("Scatter/tick", &state.scatter, 0, 1000);
+                if (state.scatter) ImGui::Text("CSG: %.2fms", state.csg_ms);
+                static const char* automata[] = { "Off", kCaRules[0].name, kCaRules[1].name, kCaRules[2].name, kCaRules[3].name };
+                ImGui::Combo("Automaton", &state.ca_rule, automata, 5);
+                if (state.ca_rule) {
+                    ImGui::SliderInt("Generations/tick", &state.ca_gens, 1, 8);
+                    ImGui::Text("Automaton: %.2fms", state.ca_ms);
+                }
+                if (ImGui::Checkbox("Walk", &state.walk) && state.walk) {
+                    // Drop the player from where the camera is
+                    const float half = state.voxels.size * 0.5f;
+                    state.player = {};
+                    state.player.pos[0] = state.cam.position.x + half;
+                    state.player.pos[1] = state.cam.position.y + half - PLAYER_EYE;
+                    state.player.pos[2] = state.cam.position.z + half;
+                }
+                if (ImGui::Checkbox("Lighting", &state.lighting)) {
+                    const double t = nowMs();
+                    if (state.lighting) lightInit(state.light, &state.voxels.data[0][0][0], state.voxels.size);
+                    state.light_ms = static_cast<float>(nowMs() - t);
+                    state.mesh->light = state.fluid->mesh.light = state.lighting ? state.light : nullptr;
+                    for (MeshChunk& c : state.mesh->chunks) c.dirty = true;
+                    for (MeshChunk& c : state.fluid->mesh.chunks) c.dirty = true;
+                }
+                if (state.lighting) ImGui::Text("Light: %.2fms", state.light_ms);
+                if (ImGui::Checkbox("Paths", &state.pathing)) {
+                    if (state.pathing) {
+                        const double t = nowMs();
+                        pathInit(state.paths, &state.voxels.data[0][0][0], state.voxels.size);
+                        state.path_ms = static_cast<float>(nowMs() - t);
+                        pathServiceStart(state.path_service, state.paths, std::max(1, threadCount() - 1));
+                    }
+                    else pathServiceStop(state.path_service);
+                }
+                if (state.pathing) {
+                    ImGui::SliderInt("Paths in flight", &state.path_rate, 0, 500);
+                    ImGui::Text("Paths: %d/%d found, %.3fms each, graph %.2fms", state.path_found, state.path_done, state.path_query_ms, state.path_ms);
+                }
+                if (ImGui::Checkbox("Islands", &state.track_islands) && state.track_islands) {
+                    const double t = nowMs();
+                    islandsInit(state.islands, &state.voxels.data[0][0][0], state.voxels.size);
+                    state.islands_ms = static_cast<float>(nowMs() - t);
+                }
+                if (ImGui::Checkbox("Debris", &state.debris_on) && state.debris_on) {
+                    if (!state.track_islands) islandsInit(state.islands, &state.voxels.data[0][0][0], state.voxels.size);
+                    state.track_islands = true;
+                    if (debrisDetach(state.debris, &state.voxels, state.islands, state.mesh)) state.ca_stale = true;
+                }
+                if (!state.debris->bodies.empty()) {
+                    int awake = 0;
+                    for (const DebrisBody& b : state.debris->bodies) awake += !b.asleep;
+                    ImGui::Text("Bodies: %d (%d awake), sim %.2fms", static_cast<int>(state.debris->bodies.size()), awake, state.debris_ms);
+                    if (ImGui::Button("Clear debris")) debrisFree(state.debris);
+                }
+                ImGui::Text("Water: %d active chunks, %d ticks (%.2fms)", fluidActiveChunks(state.fluid), state.fluid->ticks, state.fluid_ms);
+                if (state.track_islands)
+                    ImGui::Text("Islands: %d, largest %d voxels (%.2fms)", static_cast<int>(state.islands->islands.size()),
+                                state.islands->largest >= 0 ? state.islands->islands[state.islands->largest].size : 0, state.islands_ms);
                 ImGui::End();
             imguiEndFrame(&state.win);
 
             SDL_RenderPresent(state.win.renderer);
+            if (state.edit_pending) {
+                state.edit_ms = static_cast<float>(nowMs() - state.edit_start_ms);
+                state.edit_pending = false;
+            }
             updateFrame(&state.win);
         }
     }
@@ -312,11 +737,26 @@ int main()
     // Cleanup
     renderFree(&state.r);
 
-    if (state.voxelModel.transformed_triangles) {
-        free(state.voxelModel.transformed_triangles);
-        state.voxelModel.transformed_triangles = nullptr;
-        state.voxelModel.num_triangles = 0;
-    }
+    meshFree(state.mesh);
+    delete state.mesh;
+    delete state.csg;
+    delete state.islands;
+    debrisFree(state.debris);
+    delete state.debris;
+    delete state.ca;
+    fluidFree(state.fluid);
+    delete state.fluid;
+    delete state.light;
+    delete state.query;
+    if (state.pathing) pathServiceStop(state.path_service);
+    delete state.path_service;
+    delete state.paths;
+    delete state.stats;
+    delete state.store;
+    delete state.graph;
+    free(state.aa_color);
+    framebufferFree(&state.fb);
+    delete state.raster;
 
     SDL_DestroyTexture(state.texture);
     destroyWindow(&state.win);
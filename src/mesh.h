@@ -0,0 +1,156 @@
+#pragma once
+#include <cstdlib>
+#include <vector>
+#include "voxel.h"
+#include "raster.h"
+#include "light.h"
+
+// CHUNKED VOXEL MESH
+// Exposed faces are kept per CHUNK_SIZE^3 chunk, each chunk with its own wrapper Model so the triangle
+// path can draw it directly. Edits only mark chunks dirty; meshUpdate rebuilds those in parallel.
+// With a light map attached, faces carry its corner levels (the triangle path gets them per triangle).
+
+struct MeshChunk
+{
+    std::vector<VoxelFace> faces;
+    Model model;
+    bool dirty;
+};
+
+struct VoxelMesh
+{
+    std::vector<MeshChunk> chunks;    // CHUNKS^3, x fastest
+    std::vector<RasterBatch> batches; // non-empty chunks, rebuilt by meshUpdate
+    int num_faces;
+    const LightMap* light = nullptr;  // baked into the faces when set
+};
+
+static int meshChunkIndex(const int cx, const int cy, const int cz)
+{
+    return (cz * CHUNKS + cy) * CHUNKS + cx;
+}
+
+static void meshChunkFaces(std::vector<VoxelFace>* out, const VoxelGrid* g, const int cx, const int cy, const int cz, const LightMap* light = nullptr)
+{
+    const int offsets[6][3] = { {-1,0,0}, {1,0,0}, {0,-1,0}, {0,1,0}, {0,0,-1}, {0,0,1} };
+    out->clear();
+
+    const int x0 = cx * CHUNK_SIZE, y0 = cy * CHUNK_SIZE, z0 = cz * CHUNK_SIZE;
+    const int x1 = std::min(x0 + CHUNK_SIZE, g->size), y1 = std::min(y0 + CHUNK_SIZE, g->size), z1 = std::min(z0 + CHUNK_SIZE, g->size);
+    for (int z = z0; z < z1; z++)
+    for (int y = y0; y < y1; y++)
+    for (int x = x0; x < x1; x++) {
+        const uint8_t material = g->data[z][y][x];
+        if (!material) continue;
+        for (int f = 0; f < 6; f++)
+            if (!g->at(x + offsets[f][0], y + offsets[f][1], z + offsets[f][2])) {
+                out->push_back({ static_cast<int16_t>(x), static_cast<int16_t>(y), static_cast<int16_t>(z), static_cast<uint8_t>(f), material });
+                if (light) out->back().light = lightFaceCorners(light, &g->data[0][0][0], x, y, z, f);
+            }
+    }
+}
+
+// Two triangles per face, same corner layout and winding as the face tables in raster.h
+static void meshChunkModel(Model* m, const std::vector<VoxelFace>& faces, const float half)
+{
+    if (m->transformed_triangles) {
+        free(m->transformed_triangles);
+        m->transformed_triangles = nullptr;
+    }
+    m->num_triangles = 0;
+    if (faces.empty()) return;
+
+    m->transformed_triangles = static_cast<Triangle*>(malloc(sizeof(Triangle) * faces.size() * 2));
+    for (const VoxelFace& f : faces) {
+        Vec3 P[4];
+        for (int k = 0; k < 4; k++) {
+            const int c = kFaceQuad[f.dir][k];
+            P[k] = vec3(f.x + (c & 1) - half, f.y + (c >> 1 & 1) - half, f.z + (c >> 2 & 1) - half);
+        }
+        const Vec3 color = materialColor(f.material);
+        if (f.light == 0xFFFF) {
+            m->transformed_triangles[m->num_triangles++] = { P[0], P[1], P[2], color };
+            m->transformed_triangles[m->num_triangles++] = { P[0], P[2], P[3], color };
+            continue;
+        }
+        float l[4];
+        for (int k = 0; k < 4; k++) l[k] = rasterLightScale(f.light >> (k * 4));
+        const float a = (l[0] + l[1] + l[2]) / 3.0f, b = (l[0] + l[2] + l[3]) / 3.0f;
+        m->transformed_triangles[m->num_triangles++] = { P[0], P[1], P[2], vec3(color.x * a, color.y * a, color.z * a) };
+        m->transformed_triangles[m->num_triangles++] = { P[0], P[2], P[3], vec3(color.x * b, color.y * b, color.z * b) };
+    }
+}
+
+// Marks every chunk whose faces can change when voxels inside box change (box grown by one for neighbours)
+static void meshMarkDirty(VoxelMesh* mesh, const VoxelBox& box)
+{
+    if (box.empty()) return;
+    const int x0 = std::max(box.x0 - 1, 0) / CHUNK_SIZE, x1 = std::min(box.x1, GRID_SIZE - 1) / CHUNK_SIZE;
+    const int y0 = std::max(box.y0 - 1, 0) / CHUNK_SIZE, y1 = std::min(box.y1, GRID_SIZE - 1) / CHUNK_SIZE;
+    const int z0 = std::max(box.z0 - 1, 0) / CHUNK_SIZE, z1 = std::min(box.z1, GRID_SIZE - 1) / CHUNK_SIZE;
+    for (int cz = z0; cz <= z1; cz++)
+    for (int cy = y0; cy <= y1; cy++)
+    for (int cx = x0; cx <= x1; cx++)
+        mesh->chunks[meshChunkIndex(cx, cy, cz)].dirty = true;
+}
+
+static void meshRebuildBatches(VoxelMesh* mesh)
+{
+    mesh->batches.clear();
+    mesh->num_faces = 0;
+    for (const MeshChunk& c : mesh->chunks) {
+        if (c.faces.empty()) continue;
+        mesh->batches.push_back({ c.faces.data(), static_cast<int>(c.faces.size()) });
+        mesh->num_faces += static_cast<int>(c.faces.size());
+    }
+}
+
+// Remeshes dirty chunks, returns how many were rebuilt
+static int meshUpdate(VoxelMesh* mesh, const VoxelGrid* g)
+{
+    std::vector<int> dirty;
+    for (int i = 0; i < static_cast<int>(mesh->chunks.size()); i++)
+        if (mesh->chunks[i].dirty) dirty.push_back(i);
+    if (dirty.empty()) return 0;
+
+    const int count = static_cast<int>(dirty.size());
+    const float half = g->size * 0.5f;
+    #pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < count; i++) {
+        const int index = dirty[i];
+        MeshChunk& c = mesh->chunks[index];
+        meshChunkFaces(&c.faces, g, index % CHUNKS, index / CHUNKS % CHUNKS, index / (CHUNKS * CHUNKS), mesh->light);
+        meshChunkModel(&c.model, c.faces, half);
+        c.dirty = false;
+    }
+
+    meshRebuildBatches(mesh);
+    return count;
+}
+
+static void meshInit(VoxelMesh* mesh, const VoxelGrid* g)
+{
+    mesh->chunks.resize(CHUNKS * CHUNKS * CHUNKS);
+    for (MeshChunk& c : mesh->chunks) c.dirty = true;
+    meshUpdate(mesh, g);
+}
+
+static void meshFree(VoxelMesh* mesh)
+{
+    for (MeshChunk& c : mesh->chunks) {
+        free(c.model.transformed_triangles);
+        c.model.transformed_triangles = nullptr;
+        c.model.num_triangles = 0;
+    }
+    mesh->chunks.clear();
+    mesh->batches.clear();
+    mesh->num_faces = 0;
+}
+
+// One contiguous face list, for the headless renderers
+static void meshFlatten(const VoxelMesh* mesh, std::vector<VoxelFace>* out)
+{
+    out->clear();
+    out->reserve(mesh->num_faces);
+    for (const RasterBatch& b : mesh->batches) out->insert(out->end(), b.faces, b.faces + b.count);
+}
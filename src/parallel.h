@@ -0,0 +1,30 @@
+#pragma once
+#include <chrono>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// OpenMP helpers that still compile (serially) when OpenMP is not found
+static int threadCount()
+{
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+static int threadIndex()
+{
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+static double nowMs()
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,628 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include "voxel.h"
+#include "parallel.h"
+
+// PATHFINDING
+// Agents are two voxels tall: a cell is walkable when the voxel below is solid (or it is the bottom layer)
+// and it and the voxel above it are air. A step goes to one of the four horizontal neighbours, at most
+// one voxel up or down, with a third voxel of headroom over the lower of the two cells.
+// HPA*: the grid is cut into CHUNK_SIZE^3 clusters. Steps between two clusters are grouped into entrances,
+// each entrance becomes a pair of nodes (one per side, cost 1 between them), and nodes of one cluster are
+// joined by their BFS distance inside it. A query searches the small node graph, then fills in the cells
+// cluster by cluster. Edits only rebuild the entrances of dirty clusters and the edges of their neighbours.
+// The graph keeps its own bit-packed copy of walkability, so queries on worker threads never read the grid;
+// they share a reader lock that pathUpdate takes exclusively.
+
+struct PathCell
+{
+    int16_t x, y, z;
+};
+
+struct PathEdge
+{
+    int to;
+    int cost;
+};
+
+struct PathNode
+{
+    PathCell cell;
+    int cluster;
+    int partner;                 // node on the other side of the entrance, -1 if free
+    std::vector<PathEdge> edges; // partner first, then nodes of the same cluster
+};
+
+struct PathCluster
+{
+    std::vector<int> nodes;
+    bool dirty;
+};
+
+struct PathGraph
+{
+    int size;
+    int clusters; // per axis
+    int words;    // per row
+    std::vector<uint64_t> walk;  // walkable cells, 64 per word along x
+    std::vector<uint64_t> clear; // third voxel of headroom is air
+    std::vector<PathCluster> cluster;
+    std::vector<PathNode> nodes;
+    std::vector<int> free_nodes;
+    std::shared_mutex lock;
+};
+
+// Per thread search state, sized lazily
+struct PathScratch
+{
+    std::vector<int> g, prev;   // abstract search, per node
+    std::vector<uint32_t> seen; // epoch per node
+    uint32_t epoch;
+    std::vector<std::pair<int, int>> heap; // (-f, node)
+    int local_dist[CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE];
+    int local_prev[CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE];
+    std::vector<int> queue;
+};
+
+static size_t pathWord(const PathGraph* g, const int x, const int y, const int z)
+{
+    return (static_cast<size_t>(z) * g->size + y) * g->words + (x >> 6);
+}
+
+static bool pathWalkable(const PathGraph* g, const int x, const int y, const int z)
+{
+    if (x < 0 || y < 0 || z < 0 || x >= g->size || y >= g->size || z >= g->size) return false;
+    return g->walk[pathWord(g, x, y, z)] >> (x & 63) & 1;
+}
+
+static bool pathClear(const PathGraph* g, const int x, const int y, const int z)
+{
+    return g->clear[pathWord(g, x, y, z)] >> (x & 63) & 1;
+}
+
+static int pathClusterOf(const PathGraph* g, const int x, const int y, const int z)
+{
+    return ((z / CHUNK_SIZE) * g->clusters + y / CHUNK_SIZE) * g->clusters + x / CHUNK_SIZE;
+}
+
+// Cells reachable in one step from (x, y, z), returns how many were written
+static int pathSteps(const PathGraph* g, const PathCell c, PathCell out[12])
+{
+    static const int kDir[4][2] = { {1,0}, {-1,0}, {0,1}, {0,-1} };
+    int n = 0;
+    for (const auto& d : kDir)
+        for (int dy = -1; dy <= 1; dy++) {
+            const int x = c.x + d[0], y = c.y + dy, z = c.z + d[1];
+            if (!pathWalkable(g, x, y, z)) continue;
+            if (dy > 0 && !pathClear(g, c.x, c.y, c.z)) continue;
+            if (dy < 0 && !pathClear(g, x, y, z)) continue;
+            out[n++] = { static_cast<int16_t>(x), static_cast<int16_t>(y), static_cast<int16_t>(z) };
+        }
+    return n;
+}
+
+// Recomputes walkability of cells in box from the grid, returns true if any bit changed
+static bool pathExtract(PathGraph* g, const uint8_t* data, const VoxelBox& box)
+{
+    const int n = g->size;
+    const auto solid = [&](const int x, const int y, const int z) { return y < 0 || (y < n && data[(static_cast<size_t>(z) * n + y) * n + x] != 0); };
+    bool changed = false;
+    for (int z = std::max(box.z0, 0); z < std::min(box.z1, n); z++)
+        for (int y = std::max(box.y0, 0); y < std::min(box.y1, n); y++)
+            for (int x = std::max(box.x0, 0); x < std::min(box.x1, n); x++) {
+                const uint64_t bit = 1ull << (x & 63);
+                const size_t w = pathWord(g, x, y, z);
+                const bool walk = solid(x, y - 1, z) && !solid(x, y, z) && !solid(x, y + 1, z);
+                const bool clear = !solid(x, y + 2, z);
+                const uint64_t wv = walk ? g->walk[w] | bit : g->walk[w] & ~bit;
+                const uint64_t cv = clear ? g->clear[w] | bit : g->clear[w] & ~bit;
+                changed |= wv != g->walk[w] || cv != g->clear[w];
+                g->walk[w] = wv;
+                g->clear[w] = cv;
+            }
+    return changed;
+}
+
+static VoxelBox pathClusterBox(const PathGraph* g, const int index)
+{
+    const int k = g->clusters;
+    const int x0 = index % k * CHUNK_SIZE, y0 = index / k % k * CHUNK_SIZE, z0 = index / (k * k) * CHUNK_SIZE;
+    return { x0, y0, z0, std::min(x0 + CHUNK_SIZE, g->size), std::min(y0 + CHUNK_SIZE, g->size), std::min(z0 + CHUNK_SIZE, g->size) };
+}
+
+static int pathLocalIndex(const PathCell c)
+{
+    return ((c.z % CHUNK_SIZE) * CHUNK_SIZE + c.y % CHUNK_SIZE) * CHUNK_SIZE + c.x % CHUNK_SIZE;
+}
+
+// BFS inside one cluster from a cell; stops early once target (local index) is reached, -1 = full flood.
+// Distances land in s->local_dist (-1 unreached), parents in s->local_prev.
+static void pathLocalBfs(const PathGraph* g, PathScratch* s, const int cluster, const PathCell from, const int target)
+{
+    constexpr int S = CHUNK_SIZE;
+    std::fill(s->local_dist, s->local_dist + S * S * S, -1);
+    const VoxelBox b = pathClusterBox(g, cluster);
+    s->queue.clear();
+    s->queue.push_back(pathLocalIndex(from));
+    s->local_dist[pathLocalIndex(from)] = 0;
+    s->local_prev[pathLocalIndex(from)] = -1;
+
+    PathCell next[12];
+    for (size_t head = 0; head < s->queue.size(); head++) {
+        const int l = s->queue[head];
+        if (l == target) return;
+        const PathCell c = { static_cast<int16_t>(b.x0 + l % S), static_cast<int16_t>(b.y0 + l / S % S), static_cast<int16_t>(b.z0 + l / (S * S)) };
+        const int n = pathSteps(g, c, next);
+        for (int i = 0; i < n; i++) {
+            const PathCell& d = next[i];
+            if (d.x < b.x0 || d.y < b.y0 || d.z < b.z0 || d.x >= b.x1 || d.y >= b.y1 || d.z >= b.z1) continue;
+            const int dl = pathLocalIndex(d);
+            if (s->local_dist[dl] >= 0) continue;
+            s->local_dist[dl] = s->local_dist[l] + 1;
+            s->local_prev[dl] = l;
+            s->queue.push_back(dl);
+        }
+    }
+}
+
+// Appends the cells after from up to and including to (both in cluster), false if not connected inside it
+static bool pathLocalPath(const PathGraph* g, PathScratch* s, const int cluster, const PathCell from, const PathCell to, std::vector<PathCell>* out)
+{
+    constexpr int S = CHUNK_SIZE;
+    const int target = pathLocalIndex(to);
+    pathLocalBfs(g, s, cluster, from, target);
+    if (s->local_dist[target] < 0) return false;
+
+    const VoxelBox b = pathClusterBox(g, cluster);
+    const size_t base = out->size();
+    for (int l = target; s->local_prev[l] >= 0; l = s->local_prev[l])
+        out->push_back({ static_cast<int16_t>(b.x0 + l % S), static_cast<int16_t>(b.y0 + l / S % S), static_cast<int16_t>(b.z0 + l / (S * S)) });
+    std::reverse(out->begin() + static_cast<long>(base), out->end());
+    return true;
+}
+
+// GRAPH UPDATES
+
+struct PathEntrance
+{
+    PathCell a, b; // a in cluster ca, b in cluster cb, ca < cb
+    int ca, cb;
+};
+
+static bool pathEntranceLess(const PathEntrance& e, const PathEntrance& f)
+{
+    const auto key = [](const PathEntrance& v) { return std::make_tuple(v.ca, v.cb, v.a.z, v.a.y, v.a.x, v.b.z, v.b.y, v.b.x); };
+    return key(e) < key(f);
+}
+
+static bool pathIsStep(const PathGraph* g, const PathCell from, const PathCell to)
+{
+    PathCell next[12];
+    const int n = pathSteps(g, from, next);
+    for (int i = 0; i < n; i++)
+        if (next[i].x == to.x && next[i].y == to.y && next[i].z == to.z) return true;
+    return false;
+}
+
+// Entrances of one cluster: steps into each neighbour, grouped into runs of crossings in the same direction
+// whose cells are one step apart on both sides, one entrance in the middle of every run. A run is then
+// connected inside each cluster, whichever crossing stands for it. Crossings are kept from the lower cluster's side and
+// sorted, so both sides agree on the result. Pairs with another dirty cluster are only built from the lower one.
+static void pathClusterEntrances(const PathGraph* g, const int index, std::vector<PathEntrance>* out)
+{
+    out->clear();
+    const VoxelBox b = pathClusterBox(g, index);
+    std::vector<PathEntrance> crossings;
+    PathCell next[12];
+    for (int z = b.z0; z < b.z1; z++)
+        for (int y = b.y0; y < b.y1; y++)
+            for (int x = b.x0; x < b.x1; x++) {
+                const PathCell c = { static_cast<int16_t>(x), static_cast<int16_t>(y), static_cast<int16_t>(z) };
+                if (!pathWalkable(g, x, y, z)) continue;
+                const int n = pathSteps(g, c, next);
+                for (int i = 0; i < n; i++) {
+                    const int other = pathClusterOf(g, next[i].x, next[i].y, next[i].z);
+                    if (other == index || (g->cluster[other].dirty && other < index)) continue;
+                    if (index < other) crossings.push_back({ c, next[i], index, other });
+                    else crossings.push_back({ next[i], c, other, index });
+                }
+            }
+    std::sort(crossings.begin(), crossings.end(), pathEntranceLess);
+
+    const int count = static_cast<int>(crossings.size());
+    std::vector<int> parent(count);
+    const auto root = [&](int i) {
+        while (parent[i] != i) i = parent[i] = parent[parent[i]];
+        return i;
+    };
+    for (int i = 0; i < count; i++) {
+        parent[i] = i;
+        const PathEntrance& e = crossings[i];
+        for (int j = i - 1; j >= 0 && crossings[j].ca == e.ca && crossings[j].cb == e.cb; j--) {
+            const PathEntrance& f = crossings[j];
+            if (f.b.x - f.a.x != e.b.x - e.a.x || f.b.z - f.a.z != e.b.z - e.a.z) continue;
+            if (abs(f.a.x - e.a.x) > 1 || abs(f.a.y - e.a.y) > 1 || abs(f.a.z - e.a.z) > 1) continue;
+            const bool same_a = f.a.x == e.a.x && f.a.y == e.a.y && f.a.z == e.a.z;
+            const bool same_b = f.b.x == e.b.x && f.b.y == e.b.y && f.b.z == e.b.z;
+            if ((same_a || pathIsStep(g, f.a, e.a)) && (same_b || pathIsStep(g, f.b, e.b))) parent[root(i)] = root(j);
+        }
+    }
+    std::vector<int> members(count, 0), seen(count, 0);
+    for (int i = 0; i < count; i++) members[root(i)]++;
+    for (int i = 0; i < count; i++) {
+        const int r = root(i);
+        if (seen[r]++ == members[r] / 2) out->push_back(crossings[i]);
+    }
+}
+
+static int pathNewNode(PathGraph* g, const PathCell c, const int cluster)
+{
+    int id;
+    if (!g->free_nodes.empty()) {
+        id = g->free_nodes.back();
+        g->free_nodes.pop_back();
+    } else {
+        id = static_cast<int>(g->nodes.size());
+        g->nodes.emplace_back();
+    }
+    PathNode& n = g->nodes[id];
+    n.cell = c;
+    n.cluster = cluster;
+    n.partner = -1;
+    n.edges.clear();
+    g->cluster[cluster].nodes.push_back(id);
+    return id;
+}
+
+static void pathFreeNode(PathGraph* g, const int id)
+{
+    PathNode& n = g->nodes[id];
+    std::vector<int>& list = g->cluster[n.cluster].nodes;
+    list.erase(std::find(list.begin(), list.end(), id));
+    n.partner = -1;
+    n.edges.clear();
+    g->free_nodes.push_back(id);
+}
+
+// Edges of every node in one cluster: its partner, then BFS distances to the other nodes
+static void pathClusterEdges(PathGraph* g, PathScratch* s, const int index)
+{
+    const std::vector<int>& ids = g->cluster[index].nodes;
+    for (const int id : ids) {
+        PathNode& n = g->nodes[id];
+        n.edges.clear();
+        if (n.partner >= 0) n.edges.push_back({ n.partner, 1 });
+        pathLocalBfs(g, s, index, n.cell, -1);
+        for (const int other : ids) {
+            const int d = s->local_dist[pathLocalIndex(g->nodes[other].cell)];
+            if (other != id && d >= 0) n.edges.push_back({ other, d });
+        }
+    }
+}
+
+// Rebuilds the graph around dirty clusters, returns how many clusters were dirty
+static int pathUpdate(PathGraph* g, const uint8_t* data)
+{
+    std::unique_lock<std::shared_mutex> guard(g->lock);
+    const int total = static_cast<int>(g->cluster.size()), k = g->clusters;
+
+    // Walkability of a cell depends on the voxel below and the two above, so refresh a margin and dirty
+    // the clusters where it changed
+    std::vector<int> dirty;
+    for (int i = 0; i < total; i++)
+        if (g->cluster[i].dirty) dirty.push_back(i);
+    if (dirty.empty()) return 0;
+    for (const int index : dirty) {
+        const VoxelBox b = pathClusterBox(g, index);
+        pathExtract(g, data, b);
+        if (b.y0 > 0 && pathExtract(g, data, { b.x0, b.y0 - 2, b.z0, b.x1, b.y0, b.z1 })) g->cluster[index - k].dirty = true;
+        if (b.y1 < g->size && pathExtract(g, data, { b.x0, b.y1, b.z0, b.x1, b.y1 + 1, b.z1 })) g->cluster[index + k].dirty = true;
+    }
+    dirty.clear();
+    for (int i = 0; i < total; i++)
+        if (g->cluster[i].dirty) dirty.push_back(i);
+
+    for (const int index : dirty)
+        while (!g->cluster[index].nodes.empty()) {
+            const int id = g->cluster[index].nodes.back();
+            if (g->nodes[id].partner >= 0) pathFreeNode(g, g->nodes[id].partner);
+            pathFreeNode(g, id);
+        }
+
+    const int count = static_cast<int>(dirty.size());
+    std::vector<std::vector<PathEntrance>> entrances(count);
+    #pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < count; i++) pathClusterEntrances(g, dirty[i], &entrances[i]);
+    for (int i = 0; i < count; i++)
+        for (const PathEntrance& e : entrances[i]) {
+            const int a = pathNewNode(g, e.a, e.ca);
+            const int b = pathNewNode(g, e.b, e.cb);
+            g->nodes[a].partner = b;
+            g->nodes[b].partner = a;
+        }
+
+    // Node sets changed in the dirty clusters and in the neighbours they shared entrances with
+    std::vector<uint8_t> rebuild(total, 0);
+    for (const int index : dirty) {
+        const int cx = index % k, cy = index / k % k, cz = index / (k * k);
+        for (int dz = -1; dz <= 1; dz++)
+        for (int dy = -1; dy <= 1; dy++)
+        for (int dx = -1; dx <= 1; dx++) {
+            const int x = cx + dx, y = cy + dy, z = cz + dz;
+            if (x >= 0 && y >= 0 && z >= 0 && x < k && y < k && z < k) rebuild[(z * k + y) * k + x] = 1;
+        }
+    }
+    std::vector<int> list;
+    for (int i = 0; i < total; i++)
+        if (rebuild[i]) list.push_back(i);
+    const int num = static_cast<int>(list.size());
+    #pragma omp parallel
+    {
+        auto* s = new PathScratch();
+        #pragma omp for schedule(dynamic)
+        for (int i = 0; i < num; i++) pathClusterEdges(g, s, list[i]);
+        delete s;
+    }
+
+    for (const int index : dirty) g->cluster[index].dirty = false;
+    return count;
+}
+
+static void pathInit(PathGraph* g, const uint8_t* data, const int size)
+{
+    g->size = size;
+    g->clusters = (size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    g->words = (size + 63) / 64;
+    g->walk.assign(static_cast<size_t>(size) * size * g->words, 0);
+    g->clear.assign(static_cast<size_t>(size) * size * g->words, 0);
+    g->cluster.assign(static_cast<size_t>(g->clusters) * g->clusters * g->clusters, {});
+    g->nodes.clear();
+    g->free_nodes.clear();
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int z = 0; z < size; z++) pathExtract(g, data, { 0, 0, z, size, size, z + 1 });
+    for (PathCluster& c : g->cluster) c.dirty = true;
+
+    // Entrances and edges of all clusters at once; walkability is already current
+    std::unique_lock<std::shared_mutex> guard(g->lock);
+    const int total = static_cast<int>(g->cluster.size());
+    std::vector<std::vector<PathEntrance>> entrances(total);
+    #pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < total; i++) pathClusterEntrances(g, i, &entrances[i]);
+    for (int i = 0; i < total; i++)
+        for (const PathEntrance& e : entrances[i]) {
+            const int a = pathNewNode(g, e.a, e.ca);
+            const int b = pathNewNode(g, e.b, e.cb);
+            g->nodes[a].partner = b;
+            g->nodes[b].partner = a;
+        }
+    #pragma omp parallel
+    {
+        auto* s = new PathScratch();
+        #pragma omp for schedule(dynamic)
+        for (int i = 0; i < total; i++) pathClusterEdges(g, s, i);
+        delete s;
+    }
+    for (PathCluster& c : g->cluster) c.dirty = false;
+}
+
+// Clusters overlapping box need their entrances rebuilt
+static void pathMarkDirty(PathGraph* g, const VoxelBox& box)
+{
+    if (box.empty()) return;
+    const int last = g->size - 1;
+    for (int cz = std::max(box.z0, 0) / CHUNK_SIZE; cz <= std::min(box.z1 - 1, last) / CHUNK_SIZE; cz++)
+    for (int cy = std::max(box.y0, 0) / CHUNK_SIZE; cy <= std::min(box.y1 - 1, last) / CHUNK_SIZE; cy++)
+    for (int cx = std::max(box.x0, 0) / CHUNK_SIZE; cx <= std::min(box.x1 - 1, last) / CHUNK_SIZE; cx++)
+        g->cluster[(cz * g->clusters + cy) * g->clusters + cx].dirty = true;
+}
+
+// QUERIES
+
+// Finds a walkable path from start to goal (inclusive), false if there is none. Caller holds the reader lock.
+static bool pathFind(const PathGraph* g, PathScratch* s, const PathCell start, const PathCell goal, std::vector<PathCell>* out)
+{
+    out->clear();
+    if (!pathWalkable(g, start.x, start.y, start.z) || !pathWalkable(g, goal.x, goal.y, goal.z)) return false;
+    out->push_back(start);
+    const int cs = pathClusterOf(g, start.x, start.y, start.z), cg = pathClusterOf(g, goal.x, goal.y, goal.z);
+    if (cs == cg && pathLocalPath(g, s, cs, start, goal, out)) return true;
+
+    // Goal side: BFS distances from the goal to the nodes of its cluster
+    const int nodes = static_cast<int>(g->nodes.size());
+    if (static_cast<int>(s->g.size()) < nodes) {
+        s->g.resize(nodes);
+        s->prev.resize(nodes);
+        s->seen.assign(nodes, 0);
+        s->epoch = 0;
+    }
+    std::vector<std::pair<int, int>> exits; // (node, cost to goal)
+    pathLocalBfs(g, s, cg, goal, -1);
+    for (const int id : g->cluster[cg].nodes) {
+        const int d = s->local_dist[pathLocalIndex(g->nodes[id].cell)];
+        if (d >= 0) exits.push_back({ id, d });
+    }
+    if (exits.empty()) return false;
+
+    const auto h = [&](const PathCell c) { return std::max(abs(c.x - goal.x) + abs(c.z - goal.z), abs(c.y - goal.y)); };
+    const auto later = [](const std::pair<int, int>& a, const std::pair<int, int>& b) { return a.first < b.first; };
+    const uint32_t epoch = ++s->epoch;
+    s->heap.clear();
+    pathLocalBfs(g, s, cs, start, -1);
+    for (const int id : g->cluster[cs].nodes) {
+        const int d = s->local_dist[pathLocalIndex(g->nodes[id].cell)];
+        if (d < 0) continue;
+        s->seen[id] = epoch;
+        s->g[id] = d;
+        s->prev[id] = -1;
+        s->heap.push_back({ -(d + h(g->nodes[id].cell)), id });
+        std::push_heap(s->heap.begin(), s->heap.end(), later);
+    }
+
+    // A* over nodes; a goal-side node offers the goal at its total cost, done once nothing cheaper is open
+    int best = -1, best_cost = 0;
+    while (!s->heap.empty()) {
+        std::pop_heap(s->heap.begin(), s->heap.end(), later);
+        const auto [f, id] = s->heap.back();
+        s->heap.pop_back();
+        if (best >= 0 && -f >= best_cost) break;
+        const int gid = s->g[id];
+        if (-f > gid + h(g->nodes[id].cell)) continue; // stale
+        for (const auto& [node, cost] : exits)
+            if (node == id && (best < 0 || gid + cost < best_cost)) {
+                best = id;
+                best_cost = gid + cost;
+            }
+        for (const PathEdge& e : g->nodes[id].edges) {
+            const int ng = gid + e.cost;
+            if (s->seen[e.to] == epoch && s->g[e.to] <= ng) continue;
+            s->seen[e.to] = epoch;
+            s->g[e.to] = ng;
+            s->prev[e.to] = id;
+            s->heap.push_back({ -(ng + h(g->nodes[e.to].cell)), e.to });
+            std::push_heap(s->heap.begin(), s->heap.end(), later);
+        }
+    }
+    if (best < 0) return false;
+
+    // Refine: cells inside each cluster, single steps across entrances
+    std::vector<int> chain;
+    for (int id = best; id >= 0; id = s->prev[id]) chain.push_back(id);
+    std::reverse(chain.begin(), chain.end());
+    PathCell at = start;
+    int cluster = cs;
+    for (const int id : chain) {
+        const PathNode& n = g->nodes[id];
+        if (n.cluster != cluster) {
+            out->push_back(n.cell); // entrance step
+            cluster = n.cluster;
+        } else if (at.x != n.cell.x || at.y != n.cell.y || at.z != n.cell.z) {
+            if (!pathLocalPath(g, s, cluster, at, n.cell, out)) return false;
+        }
+        at = n.cell;
+    }
+    if ((at.x != goal.x || at.y != goal.y || at.z != goal.z) && !pathLocalPath(g, s, cluster, at, goal, out)) return false;
+    return true;
+}
+
+// A walkable cell in a random column, the highest one found in up to 64 tries
+static bool pathRandomCell(const PathGraph* g, std::mt19937* rng, PathCell* out)
+{
+    std::uniform_int_distribution<int> coord(0, g->size - 1);
+    for (int t = 0; t < 64; t++) {
+        const int x = coord(*rng), z = coord(*rng);
+        for (int y = g->size - 1; y >= 0; y--)
+            if (pathWalkable(g, x, y, z)) {
+                *out = { static_cast<int16_t>(x), static_cast<int16_t>(y), static_cast<int16_t>(z) };
+                return true;
+            }
+    }
+    return false;
+}
+
+// ASYNC SERVICE
+// Requests queue up from any thread; worker threads answer them under the graph's reader lock and park
+// the results until pathPoll collects them.
+
+struct PathRequest
+{
+    int id;
+    PathCell start, goal;
+};
+
+struct PathResult
+{
+    int id;
+    bool found;
+    float ms;
+    std::vector<PathCell> cells;
+};
+
+struct PathService
+{
+    PathGraph* graph;
+    std::mutex lock;
+    std::condition_variable cv;
+    std::deque<PathRequest> pending;
+    std::vector<PathResult> done;
+    std::vector<std::thread> workers;
+    std::atomic<bool> stop;
+    int next_id;
+};
+
+static void pathWorker(PathService* ps)
+{
+    auto* s = new PathScratch();
+    while (true) {
+        PathRequest q;
+        {
+            std::unique_lock<std::mutex> guard(ps->lock);
+            ps->cv.wait(guard, [&] { return ps->stop.load() || !ps->pending.empty(); });
+            if (ps->stop.load()) break;
+            q = ps->pending.front();
+            ps->pending.pop_front();
+        }
+
+        PathResult r;
+        r.id = q.id;
+        const double t = nowMs();
+        {
+            std::shared_lock<std::shared_mutex> guard(ps->graph->lock);
+            r.found = pathFind(ps->graph, s, q.start, q.goal, &r.cells);
+        }
+        r.ms = static_cast<float>(nowMs() - t);
+
+        std::lock_guard<std::mutex> guard(ps->lock);
+        ps->done.push_back(std::move(r));
+    }
+    delete s;
+}
+
+static void pathServiceStart(PathService* ps, PathGraph* g, const int workers)
+{
+    ps->graph = g;
+    ps->stop = false;
+    ps->next_id = 0;
+    for (int i = 0; i < workers; i++) ps->workers.emplace_back(pathWorker, ps);
+}
+
+// Queues a query, returns its id
+static int pathRequest(PathService* ps, const PathCell start, const PathCell goal)
+{
+    std::lock_guard<std::mutex> guard(ps->lock);
+    const int id = ps->next_id++;
+    ps->pending.push_back({ id, start, goal });
+    ps->cv.notify_one();
+    return id;
+}
+
+// Moves the finished results into out (appending), returns how many are still queued
+static int pathPoll(PathService* ps, std::vector<PathResult>* out)
+{
+    std::lock_guard<std::mutex> guard(ps->lock);
+    for (PathResult& r : ps->done) out->push_back(std::move(r));
+    ps->done.clear();
+    return static_cast<int>(ps->pending.size());
+}
+
+static void pathServiceStop(PathService* ps)
+{
+    {
+        std::lock_guard<std::mutex> guard(ps->lock);
+        ps->stop = true;
+        ps->pending.clear();
+    }
+    ps->cv.notify_all();
+    for (std::thread& t : ps->workers) t.join();
+    ps->workers.clear();
+}
@@ -0,0 +1,395 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "voxel.h"
+
+// SPATIAL QUERIES
+// Batched raycasts, line of sight, box overlaps, solid counts and nearest-solid lookups over a uint8 grid
+// (x fastest). An occupancy pyramid keeps solid voxel counts per 2^l cube for every level l >= 1, up to
+// one cell: rays jump over the largest empty cube around them, region counts take whole cubes at once and
+// only popcount the bit-packed rows of partly covered small cubes, and nearest-solid searches descend
+// non-empty cubes closest first. Batches run in parallel and write into caller provided arrays.
+
+#define QUERY_SCAN_LEVEL 6 // partly covered cubes up to this level (one word wide) are counted row by row
+
+struct QueryLevel
+{
+    int dim; // cells per axis
+    std::vector<uint32_t> count;
+};
+
+struct QueryWorld
+{
+    const uint8_t* data;
+    int size;
+    int words;                      // per row
+    std::vector<uint64_t> bits;     // occupancy, 64 voxels per word along x
+    std::vector<QueryLevel> levels; // levels[i] is pyramid level i + 1
+};
+
+struct QueryRay
+{
+    float origin[3];
+    float dir[3]; // normalized
+    float max_dist;
+};
+
+struct QueryHit
+{
+    int voxel[3];
+    int normal[3]; // face the ray entered through, zero if it started inside the voxel
+    float dist;
+    bool hit;
+};
+
+struct QueryNearest
+{
+    int voxel[3];
+    float dist; // from the point to the voxel's cube
+    bool found;
+};
+
+static uint32_t queryCell(const QueryWorld* w, const int level, const int x, const int y, const int z)
+{
+    const QueryLevel& L = w->levels[level - 1];
+    return L.count[(static_cast<size_t>(z) * L.dim + y) * L.dim + x];
+}
+
+static bool querySolid(const QueryWorld* w, const int x, const int y, const int z)
+{
+    return w->data[(static_cast<size_t>(z) * w->size + y) * w->size + x] != 0;
+}
+
+// Recomputes the pyramid cells covering box (voxel coordinates), level by level
+static void queryUpdate(QueryWorld* w, const VoxelBox& box)
+{
+    if (box.empty()) return;
+    VoxelBox b = { std::max(box.x0, 0), std::max(box.y0, 0), std::max(box.z0, 0), std::min(box.x1, w->size), std::min(box.y1, w->size), std::min(box.z1, w->size) };
+
+    #pragma omp parallel for if ((b.z1 - b.z0) * (b.y1 - b.y0) > 256)
+    for (int z = b.z0; z < b.z1; z++)
+        for (int y = b.y0; y < b.y1; y++) {
+            const uint8_t* row = w->data + (static_cast<size_t>(z) * w->size + y) * w->size;
+            uint64_t* bits = &w->bits[(static_cast<size_t>(z) * w->size + y) * w->words];
+            for (int k = b.x0 >> 6; k <= (b.x1 - 1) >> 6; k++) {
+                uint64_t word = 0;
+                for (int x = k * 64; x < std::min(k * 64 + 64, w->size); x++) word |= static_cast<uint64_t>(row[x] != 0) << (x & 63);
+                bits[k] = word;
+            }
+        }
+    for (int l = 1; l <= static_cast<int>(w->levels.size()); l++) {
+        QueryLevel& L = w->levels[l - 1];
+        b = { b.x0 >> 1, b.y0 >> 1, b.z0 >> 1, (b.x1 + 1) >> 1, (b.y1 + 1) >> 1, (b.z1 + 1) >> 1 };
+        const int child = l == 1 ? w->size : w->levels[l - 2].dim;
+
+        #pragma omp parallel for if ((b.z1 - b.z0) * (b.y1 - b.y0) > 256)
+        for (int z = b.z0; z < b.z1; z++)
+            for (int y = b.y0; y < b.y1; y++)
+                for (int x = b.x0; x < b.x1; x++) {
+                    uint32_t sum = 0;
+                    for (int k = 0; k < 8; k++) {
+                        const int cx = 2 * x + (k & 1), cy = 2 * y + (k >> 1 & 1), cz = 2 * z + (k >> 2);
+                        if (cx >= child || cy >= child || cz >= child) continue;
+                        sum += l == 1 ? querySolid(w, cx, cy, cz) : queryCell(w, l - 1, cx, cy, cz);
+                    }
+                    L.count[(static_cast<size_t>(z) * L.dim + y) * L.dim + x] = sum;
+                }
+    }
+}
+
+static void queryInit(QueryWorld* w, const uint8_t* data, const int size)
+{
+    w->data = data;
+    w->size = size;
+    w->words = (size + 63) / 64;
+    w->bits.assign(static_cast<size_t>(size) * size * w->words, 0);
+    w->levels.clear();
+    for (int dim = (size + 1) / 2;; dim = (dim + 1) / 2) {
+        w->levels.push_back({ dim, std::vector<uint32_t>(static_cast<size_t>(dim) * dim * dim) });
+        if (dim == 1) break;
+    }
+    queryUpdate(w, { 0, 0, 0, size, size, size });
+}
+
+// RAYCASTS
+
+static bool queryRaycast(const QueryWorld* w, const QueryRay& r, QueryHit* h)
+{
+    const int top = static_cast<int>(w->levels.size());
+    const float* o = r.origin;
+    const float* d = r.dir;
+    h->hit = false;
+
+    // Clip to the grid like VoxelGrid::raycast
+    float t = 0.0f, t1 = r.max_dist;
+    int entry_axis = -1;
+    for (int a = 0; a < 3; a++) {
+        if (fabsf(d[a]) < 1e-12f) {
+            if (o[a] < 0.0f || o[a] >= static_cast<float>(w->size)) return false;
+            continue;
+        }
+        float ta = (0.0f - o[a]) / d[a];
+        float tb = (static_cast<float>(w->size) - o[a]) / d[a];
+        if (ta > tb) std::swap(ta, tb);
+        if (ta > t) { t = ta; entry_axis = a; }
+        t1 = std::min(t1, tb);
+    }
+    if (t > t1) return false;
+
+    int cell[3], step[3], normal[3] = { 0, 0, 0 };
+    float inv[3];
+    for (int a = 0; a < 3; a++) {
+        cell[a] = std::clamp(static_cast<int>(floorf(o[a] + d[a] * t)), 0, w->size - 1);
+        step[a] = d[a] > 0.0f ? 1 : -1;
+        inv[a] = fabsf(d[a]) > 1e-12f ? 1.0f / d[a] : 0.0f;
+    }
+    if (entry_axis >= 0) normal[entry_axis] = -step[entry_axis];
+
+    while (true) {
+        if (querySolid(w, cell[0], cell[1], cell[2])) {
+            h->hit = true;
+            h->dist = t;
+            for (int a = 0; a < 3; a++) {
+                h->voxel[a] = cell[a];
+                h->normal[a] = normal[a];
+            }
+            return true;
+        }
+
+        // Largest empty cube around the cell, then leave it through the nearest face
+        int l = 0;
+        while (l < top && !queryCell(w, l + 1, cell[0] >> (l + 1), cell[1] >> (l + 1), cell[2] >> (l + 1))) l++;
+        int lo[3], hi[3], axis = 0;
+        float exit = 1e30f;
+        for (int a = 0; a < 3; a++) {
+            lo[a] = cell[a] >> l << l;
+            hi[a] = std::min(lo[a] + (1 << l), w->size);
+            if (!inv[a]) continue;
+            const float te = (static_cast<float>(step[a] > 0 ? hi[a] : lo[a]) - o[a]) * inv[a];
+            if (te < exit) { exit = te; axis = a; }
+        }
+        if (exit > t1) return false;
+
+        t = std::max(t, exit);
+        for (int a = 0; a < 3; a++)
+            if (a != axis) cell[a] = std::clamp(static_cast<int>(floorf(o[a] + d[a] * t)), lo[a], hi[a] - 1);
+        cell[axis] = step[axis] > 0 ? hi[axis] : lo[axis] - 1;
+        if (cell[axis] < 0 || cell[axis] >= w->size) return false;
+        normal[0] = normal[1] = normal[2] = 0;
+        normal[axis] = -step[axis];
+    }
+}
+
+static void queryRaycasts(const QueryWorld* w, const QueryRay* rays, const int count, QueryHit* out)
+{
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int i = 0; i < count; i++) queryRaycast(w, rays[i], &out[i]);
+}
+
+// LINE OF SIGHT
+
+// Interleaves the low 21 bits of x, y and z
+static uint64_t queryMorton(const uint32_t x, const uint32_t y, const uint32_t z)
+{
+    const auto spread = [](uint64_t v) {
+        v &= 0x1FFFFF;
+        v = (v | v << 32) & 0x1F00000000FFFFull;
+        v = (v | v << 16) & 0x1F0000FF0000FFull;
+        v = (v | v << 8) & 0x100F00F00F00F00Full;
+        v = (v | v << 4) & 0x10C30C30C30C30C3ull;
+        v = (v | v << 2) & 0x1249249249249249ull;
+        return v;
+    };
+    return spread(x) | spread(y) << 1 | spread(z) << 2;
+}
+
+// Point indices ordered along a Morton curve, so neighbouring entries are close in space; points outside
+// the size^3 grid sort as if clamped onto it
+static std::vector<int> queryMortonOrder(const float (*points)[3], const int count, const int size)
+{
+    std::vector<std::pair<uint64_t, int>> keys(count);
+    const float top = static_cast<float>(size - 1);
+    for (int i = 0; i < count; i++) {
+        const auto c = [&](const int a) { return static_cast<uint32_t>(fminf(fmaxf(points[i][a], 0.0f), top)); };
+        keys[i] = { queryMorton(c(0), c(1), c(2)), i };
+    }
+    std::sort(keys.begin(), keys.end());
+    std::vector<int> order(count);
+    for (int i = 0; i < count; i++) order[i] = keys[i].second;
+    return order;
+}
+
+// Whether the segment from a to b crosses no solid voxel; a point inside a solid voxel sees nothing
+static bool queryVisible(const QueryWorld* w, const float a[3], const float b[3])
+{
+    const float d[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    const float len = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    if (len < 1e-6f) {
+        int c[3];
+        for (int k = 0; k < 3; k++) {
+            if (!(a[k] >= 0.0f && a[k] < static_cast<float>(w->size))) return true; // outside the grid is air
+            c[k] = static_cast<int>(a[k]);
+        }
+        return !querySolid(w, c[0], c[1], c[2]);
+    }
+    const QueryRay r = { { a[0], a[1], a[2] }, { d[0] / len, d[1] / len, d[2] / len }, len };
+    QueryHit h;
+    return !queryRaycast(w, r, &h);
+}
+
+// 64 bit words per row of a visibility matrix with count targets
+static int queryVisibilityWords(const int count)
+{
+    return (count + 63) / 64;
+}
+
+// Visibility between every observer and target: bit t of row o (queryVisibilityWords(targets) words per
+// row) is set when target t is in sight of observer o. Both sets are walked in Morton order, so rays that
+// follow each other share most of the pyramid cells they skip through; each thread owns whole rows.
+static void queryVisibility(const QueryWorld* w, const float (*observers)[3], const int num_observers,
+                            const float (*targets)[3], const int num_targets, uint64_t* bits)
+{
+    const int words = queryVisibilityWords(num_targets);
+    const std::vector<int> rows = queryMortonOrder(observers, num_observers, w->size);
+    const std::vector<int> cols = queryMortonOrder(targets, num_targets, w->size);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int i = 0; i < num_observers; i++) {
+        const int o = rows[i];
+        uint64_t* row = bits + static_cast<size_t>(o) * words;
+        std::fill(row, row + words, 0);
+        for (const int t : cols)
+            if (queryVisible(w, observers[o], targets[t])) row[t >> 6] |= 1ull << (t & 63);
+    }
+}
+
+// REGION COUNTS AND OVERLAPS
+
+// Solid voxels in b (already clipped) inside pyramid cell (l, c); with any set it stops at the first one
+static uint32_t queryCountCell(const QueryWorld* w, const int l, const int cx, const int cy, const int cz, const VoxelBox& b, const bool any)
+{
+    const int s = 1 << l;
+    const VoxelBox c = { cx * s, cy * s, cz * s, std::min(cx * s + s, w->size), std::min(cy * s + s, w->size), std::min(cz * s + s, w->size) };
+    const VoxelBox in = { std::max(c.x0, b.x0), std::max(c.y0, b.y0), std::max(c.z0, b.z0), std::min(c.x1, b.x1), std::min(c.y1, b.y1), std::min(c.z1, b.z1) };
+    if (in.empty()) return 0;
+
+    const uint32_t total = queryCell(w, l, cx, cy, cz);
+    if (!total) return 0;
+    if (in.x0 == c.x0 && in.y0 == c.y0 && in.z0 == c.z0 && in.x1 == c.x1 && in.y1 == c.y1 && in.z1 == c.z1) return total;
+
+    uint32_t n = 0;
+    if (l <= QUERY_SCAN_LEVEL) {
+        // Masked popcounts of the span [x0, x1) in every row
+        const int w0 = in.x0 >> 6, w1 = (in.x1 - 1) >> 6;
+        const uint64_t m0 = ~0ull << (in.x0 & 63), m1 = ~0ull >> (63 - ((in.x1 - 1) & 63));
+        for (int z = in.z0; z < in.z1; z++)
+            for (int y = in.y0; y < in.y1; y++) {
+                const uint64_t* row = &w->bits[(static_cast<size_t>(z) * w->size + y) * w->words];
+                if (w0 == w1) n += std::popcount(row[w0] & m0 & m1);
+                else {
+                    n += std::popcount(row[w0] & m0) + std::popcount(row[w1] & m1);
+                    for (int k = w0 + 1; k < w1; k++) n += std::popcount(row[k]);
+                }
+                if (any && n) return n;
+            }
+        return n;
+    }
+    for (int k = 0; k < 8; k++) {
+        n += queryCountCell(w, l - 1, 2 * cx + (k & 1), 2 * cy + (k >> 1 & 1), 2 * cz + (k >> 2), b, any);
+        if (any && n) return n;
+    }
+    return n;
+}
+
+static uint32_t queryCount(const QueryWorld* w, const VoxelBox& box, const bool any = false)
+{
+    const VoxelBox b = { std::max(box.x0, 0), std::max(box.y0, 0), std::max(box.z0, 0), std::min(box.x1, w->size), std::min(box.y1, w->size), std::min(box.z1, w->size) };
+    if (b.empty()) return 0;
+    return queryCountCell(w, static_cast<int>(w->levels.size()), 0, 0, 0, b, any);
+}
+
+// Solid voxel counts of integer regions
+static void queryCounts(const QueryWorld* w, const VoxelBox* boxes, const int count, uint32_t* out)
+{
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int i = 0; i < count; i++) out[i] = queryCount(w, boxes[i]);
+}
+
+// Whether float boxes (min, max corners) touch any solid voxel
+static void queryOverlaps(const QueryWorld* w, const float (*boxes)[6], const int count, uint8_t* out)
+{
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int i = 0; i < count; i++) {
+        const float* b = boxes[i];
+        const VoxelBox v = { static_cast<int>(floorf(b[0])), static_cast<int>(floorf(b[1])), static_cast<int>(floorf(b[2])),
+                             static_cast<int>(ceilf(b[3])), static_cast<int>(ceilf(b[4])), static_cast<int>(ceilf(b[5])) };
+        out[i] = queryCount(w, v, true) != 0;
+    }
+}
+
+// NEAREST SOLID
+
+struct QueryNode
+{
+    float d2;
+    int l, x, y, z;
+};
+
+static float queryCubeDist2(const float p[3], const int l, const int x, const int y, const int z)
+{
+    const int s = 1 << l;
+    const int c[3] = { x * s, y * s, z * s };
+    float d2 = 0.0f;
+    for (int a = 0; a < 3; a++) {
+        const float e = std::max({ static_cast<float>(c[a]) - p[a], 0.0f, p[a] - static_cast<float>(c[a] + s) });
+        d2 += e * e;
+    }
+    return d2;
+}
+
+// Closest first descent through non-empty cubes; heap is caller scratch
+static void queryNearestOne(const QueryWorld* w, const float p[3], const float max_dist, std::vector<QueryNode>* heap, QueryNearest* out)
+{
+    const auto later = [](const QueryNode& a, const QueryNode& b) { return a.d2 > b.d2; };
+    const int top = static_cast<int>(w->levels.size());
+    const float limit = max_dist * max_dist;
+    out->found = false;
+    heap->clear();
+    if (!queryCell(w, top, 0, 0, 0)) return;
+    heap->push_back({ queryCubeDist2(p, top, 0, 0, 0), top, 0, 0, 0 });
+
+    while (!heap->empty()) {
+        std::pop_heap(heap->begin(), heap->end(), later);
+        const QueryNode n = heap->back();
+        heap->pop_back();
+        if (n.d2 > limit) return;
+        if (n.l == 0) {
+            out->found = true;
+            out->dist = sqrtf(n.d2);
+            out->voxel[0] = n.x; out->voxel[1] = n.y; out->voxel[2] = n.z;
+            return;
+        }
+        const int child = n.l == 1 ? w->size : w->levels[n.l - 2].dim;
+        for (int k = 0; k < 8; k++) {
+            const int x = 2 * n.x + (k & 1), y = 2 * n.y + (k >> 1 & 1), z = 2 * n.z + (k >> 2);
+            if (x >= child || y >= child || z >= child) continue;
+            if (n.l == 1 ? !querySolid(w, x, y, z) : !queryCell(w, n.l - 1, x, y, z)) continue;
+            const float d2 = queryCubeDist2(p, n.l - 1, x, y, z);
+            if (d2 > limit) continue;
+            heap->push_back({ d2, n.l - 1, x, y, z });
+            std::push_heap(heap->begin(), heap->end(), later);
+        }
+    }
+}
+
+static void queryNearest(const QueryWorld* w, const float (*points)[3], const int count, const float max_dist, QueryNearest* out)
+{
+    #pragma omp parallel
+    {
+        std::vector<QueryNode> heap;
+        #pragma omp for schedule(dynamic, 64)
+        for (int i = 0; i < count; i++) queryNearestOne(w, points[i], max_dist, &heap, &out[i]);
+    }
+}
@@ -0,0 +1,616 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include "parallel.h"
+
+// SOFTWARE VOXEL RASTERIZER
+// Draws exposed voxel faces into caller owned color / depth / face id buffers, split into row bands
+// so threads (or processes) can fill disjoint parts of one target. Uses the wrapper math types.
+
+#define RASTER_BAND 32
+#define RASTER_NEAR 0.1f
+#define RASTER_AMBIENT 0.15f
+#define RASTER_BACKGROUND 0xFF000000u
+#define RASTER_ORTHO_FAR 65536.0f
+#define RASTER_LIGHT_FLOOR 0.05f // brightness of light level 0
+
+struct VoxelFace
+{
+    int16_t x, y, z;
+    uint8_t dir; // -X, +X, -Y, +Y, -Z, +Z (same order as the mesher offsets)
+    uint8_t material;
+    uint16_t light = 0xFFFF; // baked light level per corner, 4 bits each in kFaceQuad order
+};
+
+struct Framebuffer
+{
+    int width, height;
+    uint32_t* color;   // ARGB8888
+    float* depth;      // 1/z, 0 = nothing drawn
+    uint32_t* face_id; // 1 + face index, 0 = nothing drawn
+};
+
+struct RasterView
+{
+    Vec3 position;
+    Vec3 right, up, front;
+    Vec3 light_dir;
+    bool light;
+    float fov;  // vertical, degrees
+    float half; // voxel -> world offset (grid size / 2)
+    bool ortho;
+    float ortho_scale; // pixels per voxel
+};
+
+struct RasterBatch
+{
+    const VoxelFace* faces;
+    int count;
+    const float* transform = nullptr; // rigid local -> grid voxel transform, row major 3x4 (null = identity)
+};
+
+struct RasterPoly
+{
+    float x[5], y[5], iz[5];
+    float l[5]; // vertex brightness, only used when smooth
+    int n;
+    uint32_t id;
+    uint32_t color;
+    bool smooth;
+};
+
+// Orthographic face: corner 0 on screen, the rest of the quad is the same for every face of a direction
+struct RasterStamp
+{
+    float x, y, depth;
+    uint32_t id;
+    uint32_t color;
+    uint32_t dir;
+    int setup; // index into RasterScratch::setups, -1 for the view setup
+    float l[4]; // corner brightness, only used when smooth
+    bool smooth;
+};
+
+struct RasterRange
+{
+    int batch, begin, end;
+    uint32_t id_base;
+    int setup;
+};
+
+struct RasterSetup
+{
+    float ax[3], ay[3], az[3]; // camera space of the voxel axes
+    float origin[3];           // camera space of voxel (0,0,0)
+    float quad[6][4][3];       // camera space corner offsets per face direction
+    float eye[3];              // camera position in voxel coordinates
+    float focal, cx, cy;
+    uint32_t color[6][256];
+
+    // Orthographic: per direction visibility, screen edges of the quad, their inverse and depth slopes
+    bool ortho_visible[6];
+    float ortho_edge[6][2][2];
+    float ortho_inv_det[6];
+    float ortho_dz[6][2];
+    float ortho_box[6][4]; // min x, max x, min y, max y relative to corner 0
+};
+
+struct RasterScratch
+{
+    int threads; // 0 = all OpenMP threads
+    std::vector<RasterRange> ranges;
+    std::vector<std::vector<RasterPoly>> polys; // per thread
+    std::vector<std::vector<RasterStamp>> stamps; // per thread, orthographic path
+    std::vector<std::vector<uint32_t>> bins;    // per thread and band, indices into polys
+    std::vector<RasterSetup> setups;            // one per transformed batch
+};
+
+// Corner indices of each face, corner bit 0 = +x, bit 1 = +y, bit 2 = +z (same winding as the mesher)
+static const int kFaceQuad[6][4] = { {0,4,6,2}, {1,3,7,5}, {0,1,5,4}, {2,6,7,3}, {0,2,3,1}, {4,5,7,6} };
+static const float kFaceNormal[6][3] = { {-1,0,0}, {1,0,0}, {0,-1,0}, {0,1,0}, {0,0,-1}, {0,0,1} };
+
+static Vec3 materialColor(const uint8_t material)
+{
+    switch (material) {
+        case 2: return vec3(0.25f, 0.45f, 0.9f); // water
+        case 3: return vec3(1.0f, 0.85f, 0.55f); // lamp
+        default: return vec3(1.0f, 1.0f, 1.0f);
+    }
+}
+
+static uint32_t packColor(const float r, const float g, const float b)
+{
+    const auto c = [](const float v) { return static_cast<uint32_t>(fmaxf(0.0f, fminf(1.0f, v)) * 255.0f + 0.5f); };
+    return 0xFF000000u | c(r) << 16 | c(g) << 8 | c(b);
+}
+
+static uint32_t scaleColor(const uint32_t c, const float s)
+{
+    const auto k = static_cast<uint32_t>(s * 256.0f);
+    return 0xFF000000u | ((c >> 16 & 0xFF) * k >> 8) << 16 | ((c >> 8 & 0xFF) * k >> 8) << 8 | ((c & 0xFF) * k >> 8);
+}
+
+// Brightness of a baked light level: each level down dims by a fifth
+static float rasterLightScale(const int level)
+{
+    static const auto table = [] {
+        std::array<float, 16> t = {};
+        for (int i = 0; i < 16; i++) t[i] = RASTER_LIGHT_FLOOR + (1.0f - RASTER_LIGHT_FLOOR) * powf(0.8f, static_cast<float>(15 - i));
+        return t;
+    }();
+    return table[level & 15];
+}
+
+// Corner brightness of a face; flat faces fold it into color and report false
+static bool rasterFaceLight(const VoxelFace& f, uint32_t* color, float l[4])
+{
+    if (f.light == 0xFFFF) return false;
+    for (int k = 0; k < 4; k++) l[k] = rasterLightScale(f.light >> (k * 4));
+    if ((f.light & 0xF) * 0x1111 != f.light) return true;
+    *color = scaleColor(*color, l[0]);
+    return false;
+}
+
+static void framebufferInit(Framebuffer* fb, const int width, const int height)
+{
+    fb->width = width;
+    fb->height = height;
+    fb->color = static_cast<uint32_t*>(malloc(sizeof(uint32_t) * width * height));
+    fb->depth = static_cast<float*>(malloc(sizeof(float) * width * height));
+    fb->face_id = static_cast<uint32_t*>(malloc(sizeof(uint32_t) * width * height));
+}
+
+static void framebufferFree(Framebuffer* fb)
+{
+    free(fb->color);
+    free(fb->depth);
+    free(fb->face_id);
+    memset(fb, 0, sizeof(*fb));
+}
+
+static void rasterViewInit(RasterView* v, const Vec3 position, const Vec3 front, const Vec3 right, const float fov, const float half)
+{
+    v->position = position;
+    v->front = front;
+    v->right = right;
+    v->up = vec3(right.y * front.z - right.z * front.y,
+                 right.z * front.x - right.x * front.z,
+                 right.x * front.y - right.y * front.x);
+    v->fov = fov;
+    v->half = half;
+    v->ortho = false;
+    v->ortho_scale = 1.0f;
+}
+
+// Same convention as the camera: yaw / pitch in degrees, world up = +Y
+static void rasterViewFromAngles(RasterView* v, const Vec3 position, const float yaw, const float pitch, const float fov, const float half)
+{
+    const float y = yaw * 3.14159265f / 180.0f, p = pitch * 3.14159265f / 180.0f;
+    const Vec3 front = norm(vec3(cosf(y) * cosf(p), sinf(p), sinf(y) * cosf(p)));
+    const Vec3 right = norm(vec3(-front.z, 0.0f, front.x));
+    rasterViewInit(v, position, front, right, fov, half);
+}
+
+// With a transform, "voxel space" is the batch's local space: its axes, eye and face normals are rotated into it
+static void rasterSetup(RasterSetup* s, const RasterView* v, const Framebuffer* fb, const float* transform = nullptr)
+{
+    static const float kIdentity[12] = { 1,0,0,0, 0,1,0,0, 0,0,1,0 };
+    const float* mat = transform ? transform : kIdentity;
+
+    const Vec3 R[3] = { v->right, v->up, v->front };
+    for (int i = 0; i < 3; i++) {
+        s->ax[i] = R[i].x * mat[0] + R[i].y * mat[4] + R[i].z * mat[8];
+        s->ay[i] = R[i].x * mat[1] + R[i].y * mat[5] + R[i].z * mat[9];
+        s->az[i] = R[i].x * mat[2] + R[i].y * mat[6] + R[i].z * mat[10];
+    }
+
+    const float eye[3] = { v->position.x + v->half - mat[3], v->position.y + v->half - mat[7], v->position.z + v->half - mat[11] };
+    for (int j = 0; j < 3; j++) s->eye[j] = mat[j] * eye[0] + mat[4 + j] * eye[1] + mat[8 + j] * eye[2];
+    for (int i = 0; i < 3; i++)
+        s->origin[i] = -(s->ax[i] * s->eye[0] + s->ay[i] * s->eye[1] + s->az[i] * s->eye[2]);
+
+    for (int d = 0; d < 6; d++)
+    for (int k = 0; k < 4; k++) {
+        const int c = kFaceQuad[d][k];
+        for (int i = 0; i < 3; i++)
+            s->quad[d][k][i] = (c & 1) * s->ax[i] + (c >> 1 & 1) * s->ay[i] + (c >> 2 & 1) * s->az[i];
+    }
+
+    s->focal = v->ortho ? v->ortho_scale : fb->height * 0.5f / tanf(v->fov * 0.5f * 3.14159265f / 180.0f);
+    s->cx = fb->width * 0.5f;
+    s->cy = fb->height * 0.5f;
+
+    for (int d = 0; d < 6; d++) {
+        // Camera space z of the face normal decides visibility for every face of this direction at once
+        const float nz = kFaceNormal[d][0] * s->ax[2] + kFaceNormal[d][1] * s->ay[2] + kFaceNormal[d][2] * s->az[2];
+        float e[2][3];
+        for (int i = 0; i < 3; i++) {
+            e[0][i] = s->quad[d][1][i] - s->quad[d][0][i];
+            e[1][i] = s->quad[d][3][i] - s->quad[d][0][i];
+        }
+        for (int k = 0; k < 2; k++) {
+            s->ortho_edge[d][k][0] = s->focal * e[k][0];
+            s->ortho_edge[d][k][1] = -s->focal * e[k][1];
+            s->ortho_dz[d][k] = -e[k][2];
+        }
+        const float det = s->ortho_edge[d][0][0] * s->ortho_edge[d][1][1] - s->ortho_edge[d][0][1] * s->ortho_edge[d][1][0];
+        s->ortho_visible[d] = nz < 0.0f && fabsf(det) > 1e-6f;
+        s->ortho_inv_det[d] = s->ortho_visible[d] ? 1.0f / det : 0.0f;
+
+        const float xs[4] = { 0.0f, s->ortho_edge[d][0][0], s->ortho_edge[d][1][0], s->ortho_edge[d][0][0] + s->ortho_edge[d][1][0] };
+        const float ys[4] = { 0.0f, s->ortho_edge[d][0][1], s->ortho_edge[d][1][1], s->ortho_edge[d][0][1] + s->ortho_edge[d][1][1] };
+        s->ortho_box[d][0] = fminf(fminf(xs[0], xs[1]), fminf(xs[2], xs[3]));
+        s->ortho_box[d][1] = fmaxf(fmaxf(xs[0], xs[1]), fmaxf(xs[2], xs[3]));
+        s->ortho_box[d][2] = fminf(fminf(ys[0], ys[1]), fminf(ys[2], ys[3]));
+        s->ortho_box[d][3] = fmaxf(fmaxf(ys[0], ys[1]), fmaxf(ys[2], ys[3]));
+    }
+
+    for (int d = 0; d < 6; d++) {
+        float shade = 1.0f;
+        if (v->light) {
+            float n[3];
+            for (int i = 0; i < 3; i++) n[i] = mat[i*4] * kFaceNormal[d][0] + mat[i*4 + 1] * kFaceNormal[d][1] + mat[i*4 + 2] * kFaceNormal[d][2];
+            const float ndl = -(n[0] * v->light_dir.x + n[1] * v->light_dir.y + n[2] * v->light_dir.z);
+            shade = RASTER_AMBIENT + (1.0f - RASTER_AMBIENT) * fmaxf(0.0f, ndl);
+        }
+        for (int m = 0; m < 256; m++) {
+            const Vec3 c = materialColor(static_cast<uint8_t>(m));
+            s->color[d][m] = packColor(c.x * shade, c.y * shade, c.z * shade);
+        }
+    }
+}
+
+// Projects one face, returns false if it is back facing, behind the camera or off screen
+static bool rasterProject(const RasterSetup* s, const VoxelFace& f, const int width, const int height, RasterPoly* p)
+{
+    const int axis = f.dir >> 1;
+    const float plane = static_cast<float>((axis == 0 ? f.x : axis == 1 ? f.y : f.z) + (f.dir & 1));
+    const float side = s->eye[axis] - plane;
+    if ((f.dir & 1) ? side <= 0.0f : side >= 0.0f) return false;
+
+    float c[4][3];
+    bool all_front = true, any_front = false;
+    for (int k = 0; k < 4; k++) {
+        for (int i = 0; i < 3; i++)
+            c[k][i] = s->origin[i] + f.x * s->ax[i] + f.y * s->ay[i] + f.z * s->az[i] + s->quad[f.dir][k][i];
+        all_front &= c[k][2] >= RASTER_NEAR;
+        any_front |= c[k][2] >= RASTER_NEAR;
+    }
+    if (!any_front) return false;
+
+    p->color = s->color[f.dir][f.material];
+    float l[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    p->smooth = rasterFaceLight(f, &p->color, l);
+
+    // Clip against the near plane (Sutherland-Hodgman, one plane)
+    float v[5][3];
+    int n = 0;
+    if (all_front) {
+        memcpy(v, c, sizeof(c));
+        memcpy(p->l, l, sizeof(l));
+        n = 4;
+    } else {
+        for (int k = 0; k < 4; k++) {
+            const float* a = c[k];
+            const float* b = c[(k + 1) & 3];
+            const bool ain = a[2] >= RASTER_NEAR, bin = b[2] >= RASTER_NEAR;
+            if (ain) {
+                p->l[n] = l[k];
+                memcpy(v[n++], a, sizeof(float) * 3);
+            }
+            if (ain != bin) {
+                const float t = (RASTER_NEAR - a[2]) / (b[2] - a[2]);
+                for (int i = 0; i < 3; i++) v[n][i] = a[i] + t * (b[i] - a[i]);
+                p->l[n] = l[k] + t * (l[(k + 1) & 3] - l[k]);
+                n++;
+            }
+        }
+    }
+
+    float minx = 1e30f, maxx = -1e30f, miny = 1e30f, maxy = -1e30f;
+    for (int k = 0; k < n; k++) {
+        const float iz = 1.0f / v[k][2];
+        p->x[k] = s->cx + s->focal * v[k][0] * iz;
+        p->y[k] = s->cy - s->focal * v[k][1] * iz;
+        p->iz[k] = iz;
+        minx = fminf(minx, p->x[k]); maxx = fmaxf(maxx, p->x[k]);
+        miny = fminf(miny, p->y[k]); maxy = fmaxf(maxy, p->y[k]);
+    }
+    if (maxx < 0.0f || maxy < 0.0f || minx > width || miny > height) return false;
+
+    p->n = n;
+    return true;
+}
+
+static void rasterTriangle(const Framebuffer* fb, const RasterPoly& p, int i0, int i1, int i2, const int ry0, const int ry1)
+{
+    float area = (p.x[i1] - p.x[i0]) * (p.y[i2] - p.y[i0]) - (p.y[i1] - p.y[i0]) * (p.x[i2] - p.x[i0]);
+    if (fabsf(area) < 1e-12f) return;
+    if (area < 0.0f) { const int t = i1; i1 = i2; i2 = t; area = -area; }
+
+    const float x0 = p.x[i0], y0 = p.y[i0], x1 = p.x[i1], y1 = p.y[i1], x2 = p.x[i2], y2 = p.y[i2];
+    const int minx = std::max(0, static_cast<int>(floorf(fminf(x0, fminf(x1, x2)))));
+    const int maxx = std::min(fb->width - 1, static_cast<int>(ceilf(fmaxf(x0, fmaxf(x1, x2)))));
+    const int miny = std::max(ry0, static_cast<int>(floorf(fminf(y0, fminf(y1, y2)))));
+    const int maxy = std::min(ry1 - 1, static_cast<int>(ceilf(fmaxf(y0, fmaxf(y1, y2)))));
+    if (minx > maxx || miny > maxy) return;
+
+    const float inv = 1.0f / area;
+    const float dw0 = -(y2 - y1), dw1 = -(y0 - y2), dw2 = -(y1 - y0);
+    const float diz = (dw0 * p.iz[i0] + dw1 * p.iz[i1] + dw2 * p.iz[i2]) * inv;
+
+    if (p.smooth) {
+        // Gouraud: brightness interpolated linearly in screen space
+        const float dl = (dw0 * p.l[i0] + dw1 * p.l[i1] + dw2 * p.l[i2]) * inv;
+        for (int y = miny; y <= maxy; y++) {
+            const float px = minx + 0.5f, py = y + 0.5f;
+            float w0 = (x2 - x1) * (py - y1) - (y2 - y1) * (px - x1);
+            float w1 = (x0 - x2) * (py - y2) - (y0 - y2) * (px - x2);
+            float w2 = (x1 - x0) * (py - y0) - (y1 - y0) * (px - x0);
+            float iz = (w0 * p.iz[i0] + w1 * p.iz[i1] + w2 * p.iz[i2]) * inv;
+            float l = (w0 * p.l[i0] + w1 * p.l[i1] + w2 * p.l[i2]) * inv;
+
+            const int row = y * fb->width;
+            for (int x = minx; x <= maxx; x++) {
+                if (w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f && iz > fb->depth[row + x]) {
+                    fb->depth[row + x] = iz;
+                    fb->color[row + x] = scaleColor(p.color, fminf(l, 1.0f));
+                    fb->face_id[row + x] = p.id;
+                }
+                w0 += dw0; w1 += dw1; w2 += dw2; iz += diz; l += dl;
+            }
+        }
+        return;
+    }
+
+    for (int y = miny; y <= maxy; y++) {
+        const float px = minx + 0.5f, py = y + 0.5f;
+        float w0 = (x2 - x1) * (py - y1) - (y2 - y1) * (px - x1);
+        float w1 = (x0 - x2) * (py - y2) - (y0 - y2) * (px - x2);
+        float w2 = (x1 - x0) * (py - y0) - (y1 - y0) * (px - x0);
+        float iz = (w0 * p.iz[i0] + w1 * p.iz[i1] + w2 * p.iz[i2]) * inv;
+
+        const int row = y * fb->width;
+        for (int x = minx; x <= maxx; x++) {
+            if (w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f && iz > fb->depth[row + x]) {
+                fb->depth[row + x] = iz;
+                fb->color[row + x] = p.color;
+                fb->face_id[row + x] = p.id;
+            }
+            w0 += dw0; w1 += dw1; w2 += dw2; iz += diz;
+        }
+    }
+}
+
+// ORTHOGRAPHIC PATH
+// Every face of one direction covers the same screen parallelogram, so a face is just its corner 0
+// position plus per direction edge and depth slopes. No perspective divide, no clipping.
+static bool rasterProjectOrtho(const RasterSetup* s, const VoxelFace& f, const int width, const int height, RasterStamp* st)
+{
+    if (!s->ortho_visible[f.dir]) return false;
+
+    float c[3];
+    for (int i = 0; i < 3; i++)
+        c[i] = s->origin[i] + f.x * s->ax[i] + f.y * s->ay[i] + f.z * s->az[i] + s->quad[f.dir][0][i];
+
+    st->x = s->cx + s->focal * c[0];
+    st->y = s->cy - s->focal * c[1];
+    const float* box = s->ortho_box[f.dir];
+    if (st->x + box[1] < 0.0f || st->y + box[3] < 0.0f || st->x + box[0] > width || st->y + box[2] > height) return false;
+
+    st->depth = RASTER_ORTHO_FAR - c[2];
+    st->dir = f.dir;
+    st->color = s->color[f.dir][f.material];
+    st->smooth = rasterFaceLight(f, &st->color, st->l);
+    return true;
+}
+
+static void rasterStamp(const Framebuffer* fb, const RasterSetup* s, const RasterStamp& st, const int ry0, const int ry1)
+{
+    static constexpr float kEps = 1e-4f;
+    const int d = static_cast<int>(st.dir);
+    const float* box = s->ortho_box[d];
+    const int minx = std::max(0, static_cast<int>(floorf(st.x + box[0])));
+    const int maxx = std::min(fb->width - 1, static_cast<int>(ceilf(st.x + box[1])));
+    const int miny = std::max(ry0, static_cast<int>(floorf(st.y + box[2])));
+    const int maxy = std::min(ry1 - 1, static_cast<int>(ceilf(st.y + box[3])));
+
+    const float e0x = s->ortho_edge[d][0][0], e0y = s->ortho_edge[d][0][1];
+    const float e1x = s->ortho_edge[d][1][0], e1y = s->ortho_edge[d][1][1];
+    const float inv = s->ortho_inv_det[d];
+    const float da = e1y * inv, db = -e0y * inv;
+    const float ddepth = da * s->ortho_dz[d][0] + db * s->ortho_dz[d][1];
+
+    for (int y = miny; y <= maxy; y++) {
+        const float px = minx + 0.5f - st.x, py = y + 0.5f - st.y;
+        float a = (px * e1y - py * e1x) * inv;
+        float b = (e0x * py - e0y * px) * inv;
+        float depth = st.depth + a * s->ortho_dz[d][0] + b * s->ortho_dz[d][1];
+
+        const int row = y * fb->width;
+        for (int x = minx; x <= maxx; x++) {
+            if (a >= -kEps && a <= 1.0f + kEps && b >= -kEps && b <= 1.0f + kEps && depth > fb->depth[row + x]) {
+                fb->depth[row + x] = depth;
+                fb->color[row + x] = st.color;
+                fb->face_id[row + x] = st.id;
+                if (st.smooth) {
+                    // Bilinear over the quad: a runs from corner 0 to 1, b from corner 0 to 3
+                    const float ca = fminf(fmaxf(a, 0.0f), 1.0f), cb = fminf(fmaxf(b, 0.0f), 1.0f);
+                    const float l = (1.0f - cb) * (st.l[0] + ca * (st.l[1] - st.l[0])) + cb * (st.l[3] + ca * (st.l[2] - st.l[3]));
+                    fb->color[row + x] = scaleColor(st.color, l);
+                }
+            }
+            a += da; b += db; depth += ddepth;
+        }
+    }
+}
+
+static void rasterClear(const Framebuffer* fb, const int y0, const int y1)
+{
+    const int n = (y1 - y0) * fb->width;
+    const int base = y0 * fb->width;
+    for (int i = 0; i < n; i++) fb->color[base + i] = RASTER_BACKGROUND;
+    memset(fb->depth + base, 0, sizeof(float) * n);
+    memset(fb->face_id + base, 0, sizeof(uint32_t) * n);
+}
+
+// Clears and renders rows [y0, y1) of fb. Face ids are numbered across batches in order.
+static void rasterRender(const Framebuffer* fb, RasterScratch* s, const RasterBatch* batches, const int num_batches, const RasterView* view, const int y0, const int y1)
+{
+    static constexpr int kRangeSize = 4096;
+
+    RasterSetup setup;
+    rasterSetup(&setup, view, fb);
+
+    const int threads = s->threads > 0 ? s->threads : threadCount();
+    const int bands = (fb->height + RASTER_BAND - 1) / RASTER_BAND;
+    s->polys.resize(threads);
+    s->bins.resize(static_cast<size_t>(threads) * bands);
+    for (auto& p : s->polys) p.clear();
+    for (auto& b : s->bins) b.clear();
+
+    s->ranges.clear();
+    int num_setups = 0;
+    uint32_t id_base = 1;
+    for (int b = 0; b < num_batches; b++) {
+        const int setup_index = batches[b].transform ? num_setups++ : -1;
+        for (int i = 0; i < batches[b].count; i += kRangeSize)
+            s->ranges.push_back({ b, i, std::min(batches[b].count, i + kRangeSize), id_base, setup_index });
+        id_base += batches[b].count;
+    }
+
+    // Transformed batches get their own setup; the face loops only pick the one of their range
+    s->setups.resize(num_setups);
+    if (num_setups) {
+        std::vector<int> transformed;
+        for (int b = 0; b < num_batches; b++)
+            if (batches[b].transform) transformed.push_back(b);
+        #pragma omp parallel for num_threads(threads) if (threads > 1 && num_setups > 8)
+        for (int i = 0; i < num_setups; i++) rasterSetup(&s->setups[i], view, fb, batches[transformed[i]].transform);
+    }
+
+    const int num_ranges = static_cast<int>(s->ranges.size());
+    if (view->ortho) {
+        s->stamps.resize(threads);
+        for (auto& st : s->stamps) st.clear();
+
+        #pragma omp parallel for schedule(dynamic) num_threads(threads) if (threads > 1)
+        for (int r = 0; r < num_ranges; r++) {
+            const int t = threadIndex();
+            const RasterRange range = s->ranges[r];
+            const VoxelFace* faces = batches[range.batch].faces;
+            const RasterSetup* su = range.setup < 0 ? &setup : &s->setups[range.setup];
+            auto& stamps = s->stamps[t];
+            for (int i = range.begin; i < range.end; i++) {
+                RasterStamp st;
+                if (!rasterProjectOrtho(su, faces[i], fb->width, fb->height, &st)) continue;
+                st.id = range.id_base + i;
+                st.setup = range.setup;
+
+                const int b0 = std::max(y0, static_cast<int>(floorf(st.y + su->ortho_box[st.dir][2]))) / RASTER_BAND;
+                const int b1 = std::min(y1 - 1, static_cast<int>(ceilf(st.y + su->ortho_box[st.dir][3]))) / RASTER_BAND;
+                if (b0 > b1) continue;
+
+                const auto index = static_cast<uint32_t>(stamps.size());
+                stamps.push_back(st);
+                for (int b = b0; b <= b1; b++) s->bins[static_cast<size_t>(t) * bands + b].push_back(index);
+            }
+        }
+    } else {
+        #pragma omp parallel for schedule(dynamic) num_threads(threads) if (threads > 1)
+        for (int r = 0; r < num_ranges; r++) {
+            const int t = threadIndex();
+            const RasterRange range = s->ranges[r];
+            const VoxelFace* faces = batches[range.batch].faces;
+            const RasterSetup* su = range.setup < 0 ? &setup : &s->setups[range.setup];
+            auto& polys = s->polys[t];
+            for (int i = range.begin; i < range.end; i++) {
+                RasterPoly p;
+                if (!rasterProject(su, faces[i], fb->width, fb->height, &p)) continue;
+                p.id = range.id_base + i;
+
+                float miny = p.y[0], maxy = p.y[0];
+                for (int k = 1; k < p.n; k++) { miny = fminf(miny, p.y[k]); maxy = fmaxf(maxy, p.y[k]); }
+                const int b0 = std::max(y0, static_cast<int>(floorf(miny))) / RASTER_BAND;
+                const int b1 = std::min(y1 - 1, static_cast<int>(ceilf(maxy))) / RASTER_BAND;
+                if (b0 > b1) continue;
+
+                const auto index = static_cast<uint32_t>(polys.size());
+                polys.push_back(p);
+                for (int b = b0; b <= b1; b++) s->bins[static_cast<size_t>(t) * bands + b].push_back(index);
+            }
+        }
+    }
+
+    const int band0 = y0 / RASTER_BAND;
+    const int band1 = (y1 - 1) / RASTER_BAND;
+    #pragma omp parallel for schedule(dynamic) num_threads(threads) if (threads > 1)
+    for (int b = band0; b <= band1; b++) {
+        const int ry0 = std::max(y0, b * RASTER_BAND);
+        const int ry1 = std::min(y1, (b + 1) * RASTER_BAND);
+        rasterClear(fb, ry0, ry1);
+        for (int t = 0; t < threads; t++)
+            for (const uint32_t index : s->bins[static_cast<size_t>(t) * bands + b]) {
+                if (view->ortho) {
+                    const RasterStamp& st = s->stamps[t][index];
+                    rasterStamp(fb, st.setup < 0 ? &setup : &s->setups[st.setup], st, ry0, ry1);
+                    continue;
+                }
+                const RasterPoly& p = s->polys[t][index];
+                for (int k = 1; k + 1 < p.n; k++) rasterTriangle(fb, p, 0, k, k + 1, ry0, ry1);
+            }
+    }
+}
+
+// ANTI-ALIASING
+// Post pass that blends each pixel with the neighbours that belong to a different face. The face id
+// buffer marks geometric edges exactly, so flat interiors and texture-free faces are never blurred.
+static void rasterAntiAlias(const Framebuffer* fb, uint32_t* out, const int y0, const int y1, const int threads)
+{
+    // 16.16 reciprocals of (2 + number of edge neighbours)
+    static constexpr uint32_t kRecip[5] = { 65536 / 2, 65536 / 3, 65536 / 4, 65536 / 5, 65536 / 6 };
+    const int w = fb->width;
+    const int band0 = y0 / RASTER_BAND;
+    const int band1 = (y1 - 1) / RASTER_BAND;
+
+    #pragma omp parallel for schedule(dynamic) num_threads(threads > 0 ? threads : threadCount()) if (threads != 1)
+    for (int b = band0; b <= band1; b++) {
+        const int ry0 = std::max(y0, b * RASTER_BAND);
+        const int ry1 = std::min(y1, (b + 1) * RASTER_BAND);
+        for (int y = ry0; y < ry1; y++) {
+            const int up = (y > 0 ? y - 1 : y) * w;
+            const int row = y * w;
+            const int down = (y < fb->height - 1 ? y + 1 : y) * w;
+            const uint32_t* c = fb->color;
+            const uint32_t* id = fb->face_id;
+            uint32_t* o = out + row;
+
+            o[0] = c[row];
+            o[w - 1] = c[row + w - 1];
+
+            #pragma omp simd
+            for (int x = 1; x < w - 1; x++) {
+                const int i = row + x;
+                const uint32_t e_l = id[i - 1] != id[i];
+                const uint32_t e_r = id[i + 1] != id[i];
+                const uint32_t e_u = id[up + x] != id[i];
+                const uint32_t e_d = id[down + x] != id[i];
+                const uint32_t recip = kRecip[e_l + e_r + e_u + e_d];
+
+                const uint32_t cc = c[i], cl = c[i - 1], cr = c[i + 1], cu = c[up + x], cd = c[down + x];
+                uint32_t result = 0xFF000000u;
+                for (int shift = 0; shift <= 16; shift += 8) {
+                    const uint32_t sum = 2 * (cc >> shift & 0xFF)
+                                       + e_l * (cl >> shift & 0xFF) + e_r * (cr >> shift & 0xFF)
+                                       + e_u * (cu >> shift & 0xFF) + e_d * (cd >> shift & 0xFF);
+                    result |= (sum * recip >> 16) << shift;
+                }
+                o[x] = result;
+            }
+        }
+    }
+}
@@ -0,0 +1,466 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "raster.h"
+#include "image.h"
+
+// HEADLESS RENDER SERVICE
+// voxely serve <socket path> [--workers N]
+// The world is loaded and meshed once, then render requests arrive over a Unix stream socket. An idle
+// connection sits in the poll set; when a request header is readable the connection is handed to a
+// worker, which renders, replies and gives the connection back. Every worker owns its framebuffers.
+// Socket reads and writes time out after SERVE_IO_TIMEOUT_MS, so a client that stalls mid request (or stops
+// reading its reply) loses its connection instead of pinning a worker. Images are capped at SERVE_MAX_DIM a
+// side and SERVE_MAX_PIXELS in all, which bounds the framebuffers a single request makes a worker allocate.
+//
+// Wire format (host byte order, both sides are on the same machine):
+//   -> ServeRequest
+//   <- ServeResponse followed by ServeResponse::size payload bytes
+
+#define SERVE_REQUEST_MAGIC 0x51525856u  // "VXRQ"
+#define SERVE_RESPONSE_MAGIC 0x53525856u // "VXRS"
+#define SERVE_MAX_DIM 4096        // per side
+#define SERVE_MAX_PIXELS (1 << 23) // width * height, a little over 3840x2160
+#define SERVE_IO_TIMEOUT_MS 2000
+
+enum ServeKind : uint8_t { SERVE_RENDER = 0, SERVE_STATS = 1 };
+enum ServeFormat : uint8_t { SERVE_RAW = 0, SERVE_PPM = 1, SERVE_PNG = 2 };
+enum ServeStatus : uint32_t { SERVE_OK = 0, SERVE_BAD_REQUEST = 1 };
+
+struct ServeRequest
+{
+    uint32_t magic;
+    uint8_t kind;
+    uint8_t format;
+    uint8_t aa;
+    uint8_t reserved;
+    uint16_t width, height;
+    float position[3];
+    float yaw, pitch;
+    float light_dir[3]; // all zero = unlit
+    float fov;          // 0 = 60 degrees
+    float ortho_scale;  // 0 = perspective
+};
+
+struct ServeResponse
+{
+    uint32_t magic;
+    uint32_t status;
+    uint32_t size;
+    uint32_t render_us;  // raster + AA
+    uint32_t latency_us; // request readable -> response ready (queueing + render + encode)
+};
+
+// Latency histogram in power of two microsecond buckets
+struct ServeStats
+{
+    std::mutex lock;
+    uint64_t requests;
+    uint64_t errors;
+    double total_us;
+    double max_us;
+    uint64_t buckets[32];
+};
+
+struct ServeConnection
+{
+    int fd;
+    double ready_ms;
+};
+
+struct ServeContext
+{
+    const VoxelFace* faces;
+    int num_faces;
+    float half;
+
+    std::mutex lock;
+    std::condition_variable cv;
+    std::deque<ServeConnection> ready;  // poller -> workers
+    std::vector<int> returned;          // workers -> poller
+    int wake[2];                        // self pipe, wakes the poller when connections come back
+    std::atomic<bool> stop;
+
+    ServeStats stats;
+};
+
+static std::atomic<bool>* serveStopFlag = nullptr;
+
+static void serveSignal(int)
+{
+    if (serveStopFlag) serveStopFlag->store(true);
+}
+
+static bool serveReadAll(const int fd, void* data, size_t size)
+{
+    auto* p = static_cast<uint8_t*>(data);
+    while (size > 0) {
+        const ssize_t n = read(fd, p, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static bool serveWriteAll(const int fd, const void* data, size_t size)
+{
+    const auto* p = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        const ssize_t n = write(fd, p, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static void serveRecord(ServeStats* s, const double us, const bool ok)
+{
+    std::lock_guard<std::mutex> guard(s->lock);
+    s->requests++;
+    if (!ok) s->errors++;
+    s->total_us += us;
+    s->max_us = std::max(s->max_us, us);
+    int bucket = 0;
+    while (bucket < 31 && static_cast<double>(1u << bucket) < us) bucket++;
+    s->buckets[bucket]++;
+}
+
+static double servePercentile(const ServeStats* s, const double q)
+{
+    const auto target = static_cast<uint64_t>(static_cast<double>(s->requests) * q);
+    uint64_t seen = 0;
+    for (int b = 0; b < 32; b++) {
+        seen += s->buckets[b];
+        if (seen > target) return static_cast<double>(1u << b);
+    }
+    return s->max_us;
+}
+
+static int serveFormatStats(ServeStats* s, char* out, const size_t size)
+{
+    std::lock_guard<std::mutex> guard(s->lock);
+    const double mean = s->requests ? s->total_us / static_cast<double>(s->requests) : 0.0;
+    return snprintf(out, size, "requests %llu errors %llu mean %.0fus p50 <%.0fus p99 <%.0fus max %.0fus\n",
+                    static_cast<unsigned long long>(s->requests), static_cast<unsigned long long>(s->errors),
+                    mean, servePercentile(s, 0.5), servePercentile(s, 0.99), s->max_us);
+}
+
+static bool serveValid(const ServeRequest& q)
+{
+    if (q.magic != SERVE_REQUEST_MAGIC) return false;
+    if (q.kind == SERVE_STATS) return true;
+    return q.kind == SERVE_RENDER && q.format <= SERVE_PNG &&
+           q.width > 0 && q.height > 0 && q.width <= SERVE_MAX_DIM && q.height <= SERVE_MAX_DIM &&
+           static_cast<long long>(q.width) * q.height <= SERVE_MAX_PIXELS;
+}
+
+// Handles one request on fd, returns false if the connection should be closed
+static bool serveHandle(ServeContext* ctx, const ServeConnection& c, Framebuffer* fb, RasterScratch* scratch,
+                        std::vector<uint32_t>* aa, std::vector<uint8_t>* payload)
+{
+    ServeRequest q;
+    if (!serveReadAll(c.fd, &q, sizeof(q))) return false;
+
+    ServeResponse r = {};
+    r.magic = SERVE_RESPONSE_MAGIC;
+    payload->clear();
+
+    if (!serveValid(q)) r.status = SERVE_BAD_REQUEST;
+    else if (q.kind == SERVE_STATS) {
+        char text[256];
+        const int n = serveFormatStats(&ctx->stats, text, sizeof(text));
+        payload->assign(text, text + n);
+    } else {
+        if (fb->width != q.width || fb->height != q.height) {
+            framebufferFree(fb);
+            framebufferInit(fb, q.width, q.height);
+        }
+
+        const double t0 = nowMs();
+        RasterView view;
+        rasterViewFromAngles(&view, vec3(q.position[0], q.position[1], q.position[2]), q.yaw, q.pitch,
+                             q.fov > 0.0f ? q.fov : 60.0f, ctx->half);
+        const Vec3 light = vec3(q.light_dir[0], q.light_dir[1], q.light_dir[2]);
+        view.light = dot(light, light) > 0.0f;
+        view.light_dir = view.light ? norm(light) : light;
+        view.ortho = q.ortho_scale > 0.0f;
+        view.ortho_scale = q.ortho_scale;
+
+        const RasterBatch batch = { ctx->faces, ctx->num_faces };
+        rasterRender(fb, scratch, &batch, 1, &view, 0, fb->height);
+
+        const uint32_t* pixels = fb->color;
+        if (q.aa) {
+            aa->resize(static_cast<size_t>(q.width) * q.height);
+            rasterAntiAlias(fb, aa->data(), 0, fb->height, 1);
+            pixels = aa->data();
+        }
+        r.render_us = static_cast<uint32_t>((nowMs() - t0) * 1000.0);
+
+        if (q.format == SERVE_PNG) encodePNG(payload, pixels, q.width, q.height);
+        else if (q.format == SERVE_PPM) encodePPM(payload, pixels, q.width, q.height);
+        else {
+            const auto* bytes = reinterpret_cast<const uint8_t*>(pixels);
+            payload->assign(bytes, bytes + sizeof(uint32_t) * q.width * q.height);
+        }
+    }
+
+    r.size = static_cast<uint32_t>(payload->size());
+    const double latency_us = (nowMs() - c.ready_ms) * 1000.0;
+    r.latency_us = static_cast<uint32_t>(latency_us);
+    const bool sent = serveWriteAll(c.fd, &r, sizeof(r)) && serveWriteAll(c.fd, payload->data(), payload->size());
+    if (q.kind == SERVE_RENDER || r.status != SERVE_OK) serveRecord(&ctx->stats, latency_us, sent && r.status == SERVE_OK);
+    return sent && r.status == SERVE_OK;
+}
+
+static void serveWorker(ServeContext* ctx)
+{
+    Framebuffer fb = {};
+    RasterScratch scratch;
+    scratch.threads = 1;
+    std::vector<uint32_t> aa;
+    std::vector<uint8_t> payload;
+
+    while (true) {
+        ServeConnection c;
+        {
+            std::unique_lock<std::mutex> guard(ctx->lock);
+            ctx->cv.wait(guard, [&] { return ctx->stop.load() || !ctx->ready.empty(); });
+            if (ctx->ready.empty()) break;
+            c = ctx->ready.front();
+            ctx->ready.pop_front();
+        }
+
+        if (serveHandle(ctx, c, &fb, &scratch, &aa, &payload)) {
+            {
+                std::lock_guard<std::mutex> guard(ctx->lock);
+                ctx->returned.push_back(c.fd);
+            }
+            const char byte = 1;
+            (void)!write(ctx->wake[1], &byte, 1);
+        }
+        else close(c.fd);
+    }
+    framebufferFree(&fb);
+}
+
+static int serveRun(const int argc, char** argv, const VoxelFace* faces, const int num_faces, const float half)
+{
+    if (argc < 1) {
+        fprintf(stderr, "usage: voxely serve <socket path> [--workers N]\n");
+        return 1;
+    }
+    const char* path = argv[0];
+    int workers = threadCount();
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--workers") && i + 1 < argc) workers = std::max(1, atoi(argv[++i]));
+        else {
+            fprintf(stderr, "usage: voxely serve <socket path> [--workers N]\n");
+            return 1;
+        }
+    }
+
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "socket path too long: %s\n", path);
+        return 1;
+    }
+    strcpy(addr.sun_path, path);
+
+    const int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path);
+    if (listen_fd < 0 || bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listen_fd, 64) != 0) {
+        perror("serve: socket");
+        return 1;
+    }
+
+    auto* ctx = new ServeContext();
+    ctx->faces = faces;
+    ctx->num_faces = num_faces;
+    ctx->half = half;
+    ctx->stop = false;
+    if (pipe(ctx->wake) != 0) {
+        perror("serve: pipe");
+        return 1;
+    }
+    fcntl(ctx->wake[0], F_SETFL, O_NONBLOCK);
+
+    serveStopFlag = &ctx->stop;
+    signal(SIGINT, serveSignal);
+    signal(SIGTERM, serveSignal);
+    signal(SIGPIPE, SIG_IGN);
+
+    std::vector<std::thread> pool;
+    for (int i = 0; i < workers; i++) pool.emplace_back(serveWorker, ctx);
+    printf("serving %d faces on %s with %d workers\n", num_faces, path, workers);
+    fflush(stdout);
+
+    // Poll set: [0] listen socket, [1] wake pipe, [2..] idle connections
+    std::vector<pollfd> fds = { { listen_fd, POLLIN, 0 }, { ctx->wake[0], POLLIN, 0 } };
+    uint64_t reported = 0;
+    double last_report = nowMs();
+
+    while (!ctx->stop.load()) {
+        if (poll(fds.data(), fds.size(), 200) < 0 && errno != EINTR) break;
+
+        if (fds[0].revents & POLLIN) {
+            const int fd = accept(listen_fd, nullptr, nullptr);
+            if (fd >= 0) {
+                const timeval tv = { SERVE_IO_TIMEOUT_MS / 1000, (SERVE_IO_TIMEOUT_MS % 1000) * 1000 };
+                setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+                setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+                fds.push_back({ fd, POLLIN, 0 });
+            }
+        }
+
+        if (fds[1].revents & POLLIN) {
+            char drain[64];
+            while (read(ctx->wake[0], drain, sizeof(drain)) > 0) {}
+            std::lock_guard<std::mutex> guard(ctx->lock);
+            for (const int fd : ctx->returned) fds.push_back({ fd, POLLIN, 0 });
+            ctx->returned.clear();
+        }
+
+        const double now = nowMs();
+        for (size_t i = 2; i < fds.size();) {
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                {
+                    std::lock_guard<std::mutex> guard(ctx->lock);
+                    ctx->ready.push_back({ fds[i].fd, now });
+                }
+                ctx->cv.notify_one();
+                fds[i] = fds.back();
+                fds.pop_back();
+            }
+            else i++;
+        }
+
+        if (now - last_report > 5000.0) {
+            uint64_t requests;
+            {
+                std::lock_guard<std::mutex> guard(ctx->stats.lock);
+                requests = ctx->stats.requests;
+            }
+            if (requests != reported) {
+                char text[256];
+                serveFormatStats(&ctx->stats, text, sizeof(text));
+                fputs(text, stdout);
+                fflush(stdout);
+                reported = requests;
+            }
+            last_report = now;
+        }
+    }
+
+    ctx->stop = true;
+    ctx->cv.notify_all();
+    for (auto& t : pool) t.join();
+    for (size_t i = 2; i < fds.size(); i++) close(fds[i].fd);
+    for (const auto& c : ctx->ready) close(c.fd);
+    for (const int fd : ctx->returned) close(fd);
+
+    char text[256];
+    serveFormatStats(&ctx->stats, text, sizeof(text));
+    fputs(text, stdout);
+
+    close(listen_fd);
+    close(ctx->wake[0]);
+    close(ctx->wake[1]);
+    unlink(path);
+    serveStopFlag = nullptr;
+    delete ctx;
+    return 0;
+}
+
+// Minimal client: voxely request <socket path> <out file> px py pz yaw pitch [--size WxH] [--png] [--aa] [--stats]
+static int serveClient(const int argc, char** argv)
+{
+    const char* usage = "usage: voxely request <socket path> <out file> px py pz yaw pitch [--size WxH] [--png] [--aa] [--stats]\n";
+    if (argc < 7) {
+        fputs(usage, stderr);
+        return 1;
+    }
+
+    ServeRequest q = {};
+    q.magic = SERVE_REQUEST_MAGIC;
+    q.kind = SERVE_RENDER;
+    q.format = SERVE_PPM;
+    q.width = 1024;
+    q.height = 768;
+    for (int i = 0; i < 3; i++) q.position[i] = static_cast<float>(atof(argv[2 + i]));
+    q.yaw = static_cast<float>(atof(argv[5]));
+    q.pitch = static_cast<float>(atof(argv[6]));
+    q.light_dir[0] = 0.3f;
+    q.light_dir[1] = -1.0f;
+    q.light_dir[2] = 0.5f;
+
+    for (int i = 7; i < argc; i++) {
+        int w, h;
+        if (!strcmp(argv[i], "--png")) q.format = SERVE_PNG;
+        else if (!strcmp(argv[i], "--aa")) q.aa = 1;
+        else if (!strcmp(argv[i], "--stats")) q.kind = SERVE_STATS;
+        else if (!strcmp(argv[i], "--size") && i + 1 < argc && sscanf(argv[++i], "%dx%d", &w, &h) == 2) {
+            q.width = static_cast<uint16_t>(w);
+            q.height = static_cast<uint16_t>(h);
+        }
+        else {
+            fputs(usage, stderr);
+            return 1;
+        }
+    }
+
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, argv[0], sizeof(addr.sun_path) - 1);
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        perror("request: connect");
+        return 1;
+    }
+
+    const double t0 = nowMs();
+    ServeResponse r;
+    std::vector<uint8_t> payload;
+    bool ok = serveWriteAll(fd, &q, sizeof(q)) && serveReadAll(fd, &r, sizeof(r)) && r.magic == SERVE_RESPONSE_MAGIC;
+    if (ok) {
+        payload.resize(r.size);
+        ok = serveReadAll(fd, payload.data(), payload.size());
+    }
+    close(fd);
+
+    if (!ok || r.status != SERVE_OK) {
+        fprintf(stderr, "request failed (status %u)\n", ok ? r.status : SERVE_BAD_REQUEST);
+        return 1;
+    }
+    if (q.kind == SERVE_STATS) {
+        fwrite(payload.data(), 1, payload.size(), stdout);
+        return 0;
+    }
+    if (!writeFile(argv[1], payload)) {
+        fprintf(stderr, "failed to write %s\n", argv[1]);
+        return 1;
+    }
+    printf("%u bytes, render %uus, server %uus, round trip %.0fus\n", r.size, r.render_us, r.latency_us, (nowMs() - t0) * 1000.0);
+    return 0;
+}
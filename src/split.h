@@ -0,0 +1,258 @@
+#pragma once
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "raster.h"
+#include "image.h"
+
+#ifdef __linux__
+#include <atomic>
+#include <climits>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <ctime>
+#include <unistd.h>
+#endif
+
+// MULTI-PROCESS SPLIT RENDERER
+// voxely split <workers> <out file> [--size WxH] [--frames N] [--png] [--aa] [px py pz yaw pitch]
+// Forks N worker processes. The voxel grid and face list live in a sealed, read-only memfd mapping; the
+// framebuffer lives in a second shared memfd and every worker renders its own horizontal band of it.
+// Frames are started and collected through futexes on a shared control block. The parent waits with a
+// timeout and checks on the workers in between, so a crashed or killed worker fails the run instead of
+// hanging it.
+
+#define SPLIT_POLL_MS 100
+
+struct SplitWorld
+{
+    uint32_t grid_size;
+    uint32_t num_faces;
+    uint64_t faces_offset; // bytes from the start of the mapping, grid bytes follow this header
+};
+
+struct SplitControl
+{
+    uint32_t frame; // futex, bumped by the parent to start a frame
+    uint32_t done;  // futex, number of workers finished with the current frame
+    uint32_t quit;
+    RasterView view;
+};
+
+#ifdef __linux__
+
+// Sleeps while *addr == expected, at most timeout_ms when it is not negative
+static void splitFutexWait(uint32_t* addr, const uint32_t expected, const int timeout_ms = -1)
+{
+    const timespec ts = { timeout_ms / 1000, (timeout_ms % 1000) * 1000000L };
+    syscall(SYS_futex, addr, FUTEX_WAIT, expected, timeout_ms < 0 ? nullptr : &ts, nullptr, 0);
+}
+
+// Reaps workers that exited; returns false if any has, clearing its pid so teardown skips it
+static bool splitAlive(std::vector<pid_t>* children)
+{
+    bool alive = true;
+    for (pid_t& pid : *children) {
+        int status;
+        if (pid > 0 && waitpid(pid, &status, WNOHANG) == pid) {
+            if (WIFSIGNALED(status)) fprintf(stderr, "split: worker %d killed by signal %d\n", pid, WTERMSIG(status));
+            else fprintf(stderr, "split: worker %d exited with status %d\n", pid, WEXITSTATUS(status));
+            pid = 0;
+            alive = false;
+        }
+    }
+    return alive;
+}
+
+static void splitFutexWake(uint32_t* addr)
+{
+    syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+static void* splitMap(const int fd, const size_t size, const int prot)
+{
+    void* p = mmap(nullptr, size, prot, MAP_SHARED, fd, 0);
+    return p == MAP_FAILED ? nullptr : p;
+}
+
+[[noreturn]] static void splitWorker(SplitControl* ctl, const Framebuffer* fb, const SplitWorld* world, const int y0, const int y1)
+{
+    const auto* base = reinterpret_cast<const uint8_t*>(world);
+    const RasterBatch batch = { reinterpret_cast<const VoxelFace*>(base + world->faces_offset), static_cast<int>(world->num_faces) };
+    RasterScratch scratch;
+    scratch.threads = 1;
+
+    uint32_t seen = 0;
+    while (true) {
+        uint32_t frame;
+        while ((frame = std::atomic_ref<uint32_t>(ctl->frame).load()) == seen) splitFutexWait(&ctl->frame, seen);
+        seen = frame;
+        if (std::atomic_ref<uint32_t>(ctl->quit).load()) _exit(0);
+
+        if (y0 < y1) rasterRender(fb, &scratch, &batch, 1, &ctl->view, y0, y1);
+
+        std::atomic_ref<uint32_t>(ctl->done).fetch_add(1);
+        splitFutexWake(&ctl->done);
+    }
+}
+
+static int splitRender(const int argc, char** argv, const uint8_t* grid, const int grid_size, const VoxelFace* faces, const int num_faces)
+{
+    const char* usage = "usage: voxely split <workers> <out file> [--size WxH] [--frames N] [--png] [--aa] [px py pz yaw pitch]\n";
+    if (argc < 2) {
+        fputs(usage, stderr);
+        return 1;
+    }
+
+    const int workers = atoi(argv[0]);
+    const char* out_path = argv[1];
+    int width = 4096, height = 2560, frames = 1;
+    bool png = false, aa = false;
+    float pose[5] = { 0.0f, 30.0f, 400.0f, -90.0f, -20.0f };
+    int num_pose = 0;
+    for (int i = 2; i < argc; i++) {
+        if (!strcmp(argv[i], "--png")) png = true;
+        else if (!strcmp(argv[i], "--aa")) aa = true;
+        else if (!strcmp(argv[i], "--size") && i + 1 < argc && sscanf(argv[i + 1], "%dx%d", &width, &height) == 2) i++;
+        else if (!strcmp(argv[i], "--frames") && i + 1 < argc) frames = atoi(argv[++i]);
+        else if (num_pose < 5) pose[num_pose++] = static_cast<float>(atof(argv[i]));
+        else {
+            fputs(usage, stderr);
+            return 1;
+        }
+    }
+    if (workers < 1 || width < 1 || height < 1 || frames < 1 || (num_pose != 0 && num_pose != 5)) {
+        fputs(usage, stderr);
+        return 1;
+    }
+
+    // World: header + grid + faces, written once then sealed read only
+    const size_t grid_bytes = static_cast<size_t>(grid_size) * grid_size * grid_size;
+    const size_t faces_offset = (sizeof(SplitWorld) + grid_bytes + 63) & ~static_cast<size_t>(63);
+    const size_t world_bytes = faces_offset + sizeof(VoxelFace) * num_faces;
+    const int world_fd = memfd_create("voxely-world", MFD_ALLOW_SEALING);
+    if (world_fd < 0 || ftruncate(world_fd, static_cast<off_t>(world_bytes)) != 0) {
+        perror("split: world memfd");
+        return 1;
+    }
+    {
+        auto* w = static_cast<uint8_t*>(splitMap(world_fd, world_bytes, PROT_READ | PROT_WRITE));
+        if (!w) {
+            perror("split: world mmap");
+            return 1;
+        }
+        const SplitWorld header = { static_cast<uint32_t>(grid_size), static_cast<uint32_t>(num_faces), faces_offset };
+        memcpy(w, &header, sizeof(header));
+        memcpy(w + sizeof(header), grid, grid_bytes);
+        memcpy(w + faces_offset, faces, sizeof(VoxelFace) * num_faces);
+        munmap(w, world_bytes);
+    }
+    if (fcntl(world_fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) != 0) perror("split: seal");
+    const auto* world = static_cast<const SplitWorld*>(splitMap(world_fd, world_bytes, PROT_READ));
+
+    // Frame: control block + color + depth + face id
+    const size_t pixels = static_cast<size_t>(width) * height;
+    const size_t control_bytes = (sizeof(SplitControl) + 63) & ~static_cast<size_t>(63);
+    const size_t frame_bytes = control_bytes + pixels * (sizeof(uint32_t) + sizeof(float) + sizeof(uint32_t));
+    const int frame_fd = memfd_create("voxely-frame", 0);
+    if (!world || frame_fd < 0 || ftruncate(frame_fd, static_cast<off_t>(frame_bytes)) != 0) {
+        perror("split: frame memfd");
+        return 1;
+    }
+    auto* shared = static_cast<uint8_t*>(splitMap(frame_fd, frame_bytes, PROT_READ | PROT_WRITE));
+    if (!shared) {
+        perror("split: frame mmap");
+        return 1;
+    }
+    auto* ctl = reinterpret_cast<SplitControl*>(shared);
+    Framebuffer fb;
+    fb.width = width;
+    fb.height = height;
+    fb.color = reinterpret_cast<uint32_t*>(shared + control_bytes);
+    fb.depth = reinterpret_cast<float*>(fb.color + pixels);
+    fb.face_id = reinterpret_cast<uint32_t*>(fb.depth + pixels);
+
+    rasterViewFromAngles(&ctl->view, vec3(pose[0], pose[1], pose[2]), pose[3], pose[4], 60.0f, world->grid_size * 0.5f);
+    ctl->view.light_dir = norm(vec3(0.3f, -1.0f, 0.5f));
+    ctl->view.light = true;
+
+    std::vector<pid_t> children;
+    const int rows = (height + workers - 1) / workers;
+    for (int i = 0; i < workers; i++) {
+        const pid_t pid = fork();
+        if (pid < 0) {
+            perror("split: fork");
+            break;
+        }
+        if (pid == 0) splitWorker(ctl, &fb, world, std::min(height, i * rows), std::min(height, (i + 1) * rows));
+        children.push_back(pid);
+    }
+    const auto started = static_cast<uint32_t>(children.size());
+
+    double best = 1e30, total = 0.0;
+    bool alive = true;
+    for (int f = 0; f < frames && alive && started == static_cast<uint32_t>(workers); f++) {
+        const double t0 = nowMs();
+        std::atomic_ref<uint32_t>(ctl->done).store(0);
+        std::atomic_ref<uint32_t>(ctl->frame).fetch_add(1);
+        splitFutexWake(&ctl->frame);
+
+        uint32_t done;
+        while ((done = std::atomic_ref<uint32_t>(ctl->done).load()) < started && (alive = splitAlive(&children)))
+            splitFutexWait(&ctl->done, done, SPLIT_POLL_MS);
+        if (!alive) break;
+
+        const double ms = nowMs() - t0;
+        best = std::min(best, ms);
+        total += ms;
+    }
+
+    std::atomic_ref<uint32_t>(ctl->quit).store(1);
+    std::atomic_ref<uint32_t>(ctl->frame).fetch_add(1);
+    splitFutexWake(&ctl->frame);
+    for (const pid_t pid : children)
+        if (pid > 0) waitpid(pid, nullptr, 0);
+
+    int result = alive && started == static_cast<uint32_t>(workers) ? 0 : 1;
+    if (result == 0) {
+        printf("split render %dx%d with %d processes: best %.2f ms, mean %.2f ms over %d frames\n",
+               width, height, workers, best, total / frames, frames);
+
+        // Band seams need both neighbours, so AA runs once the whole frame is in
+        std::vector<uint32_t> resolved;
+        const uint32_t* out = fb.color;
+        if (aa) {
+            resolved.resize(pixels);
+            rasterAntiAlias(&fb, resolved.data(), 0, height, 0);
+            out = resolved.data();
+        }
+
+        std::vector<uint8_t> encoded;
+        if (png) encodePNG(&encoded, out, width, height);
+        else encodePPM(&encoded, out, width, height);
+        if (!writeFile(out_path, encoded)) {
+            fprintf(stderr, "failed to write %s\n", out_path);
+            result = 1;
+        }
+    }
+
+    munmap(shared, frame_bytes);
+    munmap(const_cast<SplitWorld*>(world), world_bytes);
+    close(frame_fd);
+    close(world_fd);
+    return result;
+}
+
+#else
+
+static int splitRender(const int, char**, const uint8_t*, const int, const VoxelFace*, const int)
+{
+    fprintf(stderr, "split rendering needs memfd and futex (Linux only)\n");
+    return 1;
+}
+
+#endif
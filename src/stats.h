@@ -0,0 +1,106 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "voxel.h"
+
+// WORLD STATISTICS
+// Solid voxel count, exposed faces (faces of solid voxels next to air or the grid edge, the same faces the
+// mesher emits), per material counts and tight solid bounds. Each CHUNK_SIZE^3 chunk keeps its own numbers;
+// a dirty chunk is recounted and the totals move by the difference, so an edit costs the chunks it touched
+// plus one pass over the chunk bounds. Faces belong to the chunk of their solid voxel, so an edit must also
+// dirty the chunks next to it, as the mesh dirty flags do. Voxel values are material ids, 0 is air.
+
+#define STATS_MATERIALS 256
+
+struct StatsChunk
+{
+    uint32_t solid;
+    uint32_t faces;
+    VoxelBox bounds; // empty when the chunk has no solid voxel
+    uint32_t material[STATS_MATERIALS];
+    bool dirty;
+};
+
+struct WorldStats
+{
+    int size;
+    int chunks; // per axis
+    std::vector<StatsChunk> chunk;
+    uint64_t solid;
+    uint64_t faces;
+    uint64_t material[STATS_MATERIALS];
+    VoxelBox bounds;
+    int num_materials; // materials with at least one voxel, air excluded
+};
+
+static void statsCountChunk(const WorldStats* s, const uint8_t* data, const int index, StatsChunk* out)
+{
+    const int n = s->size, k = s->chunks;
+    const int x0 = index % k * CHUNK_SIZE, y0 = index / k % k * CHUNK_SIZE, z0 = index / (k * k) * CHUNK_SIZE;
+    const int x1 = std::min(x0 + CHUNK_SIZE, n), y1 = std::min(y0 + CHUNK_SIZE, n), z1 = std::min(z0 + CHUNK_SIZE, n);
+    const auto air = [&](const int x, const int y, const int z) {
+        return x < 0 || y < 0 || z < 0 || x >= n || y >= n || z >= n || !data[(static_cast<size_t>(z) * n + y) * n + x];
+    };
+
+    out->solid = out->faces = 0;
+    memset(out->material, 0, sizeof(out->material));
+    out->bounds = { x1, y1, z1, x0, y0, z0 };
+    for (int z = z0; z < z1; z++)
+        for (int y = y0; y < y1; y++)
+            for (int x = x0; x < x1; x++) {
+                const uint8_t m = data[(static_cast<size_t>(z) * n + y) * n + x];
+                if (!m) continue;
+                out->solid++;
+                out->material[m]++;
+                out->faces += air(x - 1, y, z) + air(x + 1, y, z) + air(x, y - 1, z) + air(x, y + 1, z) + air(x, y, z - 1) + air(x, y, z + 1);
+                VoxelBox& b = out->bounds;
+                b = { std::min(b.x0, x), std::min(b.y0, y), std::min(b.z0, z), std::max(b.x1, x + 1), std::max(b.y1, y + 1), std::max(b.z1, z + 1) };
+            }
+}
+
+// Recounts dirty chunks and refreshes the totals, returns how many chunks were recounted
+static int statsUpdate(WorldStats* s, const uint8_t* data)
+{
+    std::vector<int> dirty;
+    for (int i = 0; i < static_cast<int>(s->chunk.size()); i++)
+        if (s->chunk[i].dirty) dirty.push_back(i);
+    if (dirty.empty()) return 0;
+
+    const int count = static_cast<int>(dirty.size());
+    std::vector<StatsChunk> fresh(count);
+    #pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < count; i++) statsCountChunk(s, data, dirty[i], &fresh[i]);
+
+    for (int i = 0; i < count; i++) {
+        StatsChunk& c = s->chunk[dirty[i]];
+        s->solid += fresh[i].solid - static_cast<uint64_t>(c.solid);
+        s->faces += fresh[i].faces - static_cast<uint64_t>(c.faces);
+        for (int m = 1; m < STATS_MATERIALS; m++) s->material[m] += fresh[i].material[m] - static_cast<uint64_t>(c.material[m]);
+        c = fresh[i];
+        c.dirty = false;
+    }
+
+    s->num_materials = 0;
+    for (int m = 1; m < STATS_MATERIALS; m++) s->num_materials += s->material[m] != 0;
+    s->bounds = { s->size, s->size, s->size, 0, 0, 0 };
+    for (const StatsChunk& c : s->chunk) {
+        if (!c.solid) continue;
+        VoxelBox& b = s->bounds;
+        b = { std::min(b.x0, c.bounds.x0), std::min(b.y0, c.bounds.y0), std::min(b.z0, c.bounds.z0),
+              std::max(b.x1, c.bounds.x1), std::max(b.y1, c.bounds.y1), std::max(b.z1, c.bounds.z1) };
+    }
+    return count;
+}
+
+static void statsInit(WorldStats* s, const uint8_t* data, const int size)
+{
+    s->size = size;
+    s->chunks = (size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    s->chunk.assign(static_cast<size_t>(s->chunks) * s->chunks * s->chunks, {});
+    for (StatsChunk& c : s->chunk) c.dirty = true;
+    s->solid = s->faces = 0;
+    memset(s->material, 0, sizeof(s->material));
+    statsUpdate(s, data);
+}
@@ -0,0 +1,214 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "voxel.h"
+#include "gen.h"
+
+// LAZY CHUNK STORE
+// An unbounded world of CHUNK_SIZE^3 chunks that only exist once something asks for them. A chunk is a pure
+// function of the generator settings and its coordinates, so untouched chunks are a cache: at capacity the
+// least recently used one is dropped and simply generated again if it is needed later. Chunks that are all
+// air or all solid keep no voxel array.
+// Lookups are single threaded; storePrefetch generates a batch of missing chunks on all threads. storeFill
+// pulls part of the world into a fixed size grid, storeAt reads single voxels straight from the store.
+
+struct StoreChunk
+{
+    int cx, cy, cz;
+    std::vector<uint8_t> voxels; // CHUNK_SIZE^3, x fastest; empty if uniform
+    uint8_t uniform;             // value of every voxel when voxels is empty
+    int prev, next;              // LRU list, most recent at the head
+};
+
+struct ChunkStore
+{
+    GenTerrain gen;
+    int scale;    // world height the terrain fractions refer to
+    int capacity; // chunks kept before eviction starts
+    std::unordered_map<uint64_t, int> index;
+    std::vector<StoreChunk> slots;
+    std::vector<int> free_slots;
+    int head, tail;
+    long long generated, evicted, hits, misses;
+};
+
+static uint64_t storeKey(const int cx, const int cy, const int cz)
+{
+    const auto pack = [](const int v) { return static_cast<uint64_t>(static_cast<uint32_t>(v) & 0x1FFFFF); };
+    return pack(cx) | pack(cy) << 21 | pack(cz) << 42;
+}
+
+static void storeInit(ChunkStore* s, const GenTerrain& gen, const int scale, const int capacity)
+{
+    s->gen = gen;
+    s->scale = scale;
+    s->capacity = capacity;
+    s->index.clear();
+    s->slots.clear();
+    s->free_slots.clear();
+    s->head = s->tail = -1;
+    s->generated = s->evicted = s->hits = s->misses = 0;
+}
+
+// Generates chunk (cx, cy, cz) into c; uniform chunks end up without a voxel array
+static void storeGenerate(const ChunkStore* s, const int cx, const int cy, const int cz, StoreChunk* c)
+{
+    constexpr int S = CHUNK_SIZE;
+    c->cx = cx;
+    c->cy = cy;
+    c->cz = cz;
+    c->voxels.resize(S * S * S);
+    genTerrainBox(&s->gen, s->scale, { cx * S, cy * S, cz * S, cx * S + S, cy * S + S, cz * S + S }, c->voxels.data());
+    const uint8_t first = c->voxels[0];
+    if (std::all_of(c->voxels.begin(), c->voxels.end(), [&](const uint8_t v) { return v == first; })) {
+        c->uniform = first;
+        c->voxels.clear();
+        c->voxels.shrink_to_fit();
+    }
+}
+
+static void storeUnlink(ChunkStore* s, const int slot)
+{
+    StoreChunk& c = s->slots[slot];
+    if (c.prev >= 0) s->slots[c.prev].next = c.next;
+    else s->head = c.next;
+    if (c.next >= 0) s->slots[c.next].prev = c.prev;
+    else s->tail = c.prev;
+    c.prev = c.next = -1;
+}
+
+static void storePushFront(ChunkStore* s, const int slot)
+{
+    StoreChunk& c = s->slots[slot];
+    c.prev = -1;
+    c.next = s->head;
+    if (s->head >= 0) s->slots[s->head].prev = slot;
+    s->head = slot;
+    if (s->tail < 0) s->tail = slot;
+}
+
+// Drops least recently used chunks until there is room for one more
+static void storeEvict(ChunkStore* s)
+{
+    while (static_cast<int>(s->index.size()) >= s->capacity && s->tail >= 0) {
+        const int slot = s->tail;
+        StoreChunk& c = s->slots[slot];
+        storeUnlink(s, slot);
+        s->index.erase(storeKey(c.cx, c.cy, c.cz));
+        c.voxels.clear();
+        c.voxels.shrink_to_fit();
+        s->free_slots.push_back(slot);
+        s->evicted++;
+    }
+}
+
+static int storeInsert(ChunkStore* s, StoreChunk&& c)
+{
+    storeEvict(s);
+    int slot;
+    if (!s->free_slots.empty()) {
+        slot = s->free_slots.back();
+        s->free_slots.pop_back();
+    } else {
+        slot = static_cast<int>(s->slots.size());
+        s->slots.emplace_back();
+    }
+    s->index[storeKey(c.cx, c.cy, c.cz)] = slot;
+    s->slots[slot] = std::move(c);
+    storePushFront(s, slot);
+    s->generated++;
+    return slot;
+}
+
+// The chunk at (cx, cy, cz), generated on first use; the reference stays valid until the next lookup
+static StoreChunk& storeChunk(ChunkStore* s, const int cx, const int cy, const int cz)
+{
+    const auto it = s->index.find(storeKey(cx, cy, cz));
+    if (it != s->index.end()) {
+        s->hits++;
+        if (s->head != it->second) {
+            storeUnlink(s, it->second);
+            storePushFront(s, it->second);
+        }
+        return s->slots[it->second];
+    }
+    s->misses++;
+    StoreChunk c;
+    storeGenerate(s, cx, cy, cz, &c);
+    return s->slots[storeInsert(s, std::move(c))];
+}
+
+static int storeFloorDiv(const int v)
+{
+    return v >= 0 ? v / CHUNK_SIZE : -((-v + CHUNK_SIZE - 1) / CHUNK_SIZE);
+}
+
+static uint8_t storeAt(ChunkStore* s, const int x, const int y, const int z)
+{
+    const int cx = storeFloorDiv(x), cy = storeFloorDiv(y), cz = storeFloorDiv(z);
+    const StoreChunk& c = storeChunk(s, cx, cy, cz);
+    if (c.voxels.empty()) return c.uniform;
+    const int lx = x - cx * CHUNK_SIZE, ly = y - cy * CHUNK_SIZE, lz = z - cz * CHUNK_SIZE;
+    return c.voxels[(lz * CHUNK_SIZE + ly) * CHUNK_SIZE + lx];
+}
+
+// Generates the missing chunks of a list (chunk coordinates, 3 ints each) in parallel, then inserts them;
+// a chunk listed more than once is generated once
+static void storePrefetch(ChunkStore* s, const int* chunks, const int count)
+{
+    std::vector<int> missing;
+    std::unordered_set<uint64_t> queued;
+    for (int i = 0; i < count; i++) {
+        const uint64_t key = storeKey(chunks[i * 3], chunks[i * 3 + 1], chunks[i * 3 + 2]);
+        if (!s->index.count(key) && queued.insert(key).second) missing.push_back(i);
+    }
+    const int n = static_cast<int>(missing.size());
+    std::vector<StoreChunk> fresh(n);
+    #pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < n; i++) {
+        const int* c = chunks + missing[i] * 3;
+        storeGenerate(s, c[0], c[1], c[2], &fresh[i]);
+    }
+    for (int i = 0; i < n; i++) {
+        s->misses++;
+        storeInsert(s, std::move(fresh[i]));
+    }
+}
+
+// Fills the air voxels inside box of a size^3 grid (x fastest) whose corner shows the world at origin, chunk by
+// chunk; voxels already set in the grid are kept
+static void storeFill(ChunkStore* s, const int origin[3], uint8_t* data, const int size, const VoxelBox& box)
+{
+    constexpr int S = CHUNK_SIZE;
+    if (box.empty()) return;
+    const int lo[3] = { box.x0, box.y0, box.z0 }, hi[3] = { box.x1, box.y1, box.z1 };
+    int c0[3], c1[3];
+    for (int a = 0; a < 3; a++) {
+        c0[a] = storeFloorDiv(origin[a] + lo[a]);
+        c1[a] = storeFloorDiv(origin[a] + hi[a] - 1);
+    }
+    std::vector<int> list;
+    for (int cz = c0[2]; cz <= c1[2]; cz++)
+        for (int cy = c0[1]; cy <= c1[1]; cy++)
+            for (int cx = c0[0]; cx <= c1[0]; cx++) list.insert(list.end(), { cx, cy, cz });
+    storePrefetch(s, list.data(), static_cast<int>(list.size() / 3));
+
+    for (size_t i = 0; i < list.size(); i += 3) {
+        const int* cc = &list[i];
+        const StoreChunk& c = storeChunk(s, cc[0], cc[1], cc[2]);
+        const int bx = cc[0] * S - origin[0], by = cc[1] * S - origin[1], bz = cc[2] * S - origin[2];
+        if (c.voxels.empty() && !c.uniform) continue;
+        const int lx0 = std::max(lo[0] - bx, 0), lx1 = std::min(hi[0] - bx, S);
+        for (int lz = std::max(lo[2] - bz, 0); lz < std::min(hi[2] - bz, S); lz++)
+            for (int ly = std::max(lo[1] - by, 0); ly < std::min(hi[1] - by, S); ly++) {
+                uint8_t* row = data + (static_cast<size_t>(bz + lz) * size + (by + ly)) * size + bx;
+                const uint8_t* src = c.voxels.empty() ? nullptr : &c.voxels[(lz * S + ly) * S];
+                for (int lx = lx0; lx < lx1; lx++)
+                    if (!row[lx]) row[lx] = src ? src[lx] : c.uniform;
+            }
+    }
+}
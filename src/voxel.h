@@ -0,0 +1,280 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+#define GRID_SIZE 200
+#define CHUNK_SIZE 16
+#define CHUNKS ((GRID_SIZE + CHUNK_SIZE - 1) / CHUNK_SIZE)
+#define SPONGE_THRESHOLD 0.4f
+
+// Half-open voxel region [x0, x1) x [y0, y1) x [z0, z1)
+struct VoxelBox
+{
+    int x0, y0, z0, x1, y1, z1;
+
+    [[nodiscard]] bool empty() const { return x0 >= x1 || y0 >= y1 || z0 >= z1; }
+};
+
+// VOXEL DATA STRUCTURE
+struct VoxelGrid
+{
+    uint8_t data[GRID_SIZE][GRID_SIZE][GRID_SIZE];
+    int size;
+
+    void init()
+    {
+        size = GRID_SIZE;
+        memset(data, 0, sizeof(data));
+    }
+
+    void setSphere(const float radius)
+    {
+        memset(data, 0, sizeof(data));
+        stampSphere(size * 0.5f, size * 0.5f, size * 0.5f, radius, 1);
+    }
+
+    VoxelBox setCube(const int cx, const int cy, const int cz, int size, const uint8_t value = 1)
+    {
+        const int half = size / 2;
+        return stampBox({ cx - half, cy - half, cz - half, cx + half + 1, cy + half + 1, cz + half + 1 }, value);
+    }
+
+    // SHAPE STAMPING
+    // Shapes are written row by row: the x extent of each (y, z) row inside the shape is solved directly
+    // and filled with one memset, so a stamp only visits the rows of its bounding box. Samples sit on
+    // integer voxel coordinates (same convention as setSphere). Each stamp returns the box it touched.
+
+    VoxelBox stampBox(const VoxelBox b, const uint8_t value)
+    {
+        const VoxelBox box = clip(b);
+        if (box.empty()) return box;
+        for (int z = box.z0; z < box.z1; z++)
+        for (int y = box.y0; y < box.y1; y++)
+            memset(&data[z][y][box.x0], value, box.x1 - box.x0);
+        return box;
+    }
+
+    VoxelBox stampSphere(const float cx, const float cy, const float cz, const float radius, const uint8_t value)
+    {
+        const VoxelBox box = clip(bounds(cx - radius, cy - radius, cz - radius, cx + radius, cy + radius, cz + radius));
+        for (int z = box.z0; z < box.z1; z++)
+        for (int y = box.y0; y < box.y1; y++) {
+            const float d2 = radius*radius - (y - cy)*(y - cy) - (z - cz)*(z - cz);
+            if (d2 > 0.0f) fillRow(y, z, cx - sqrtf(d2), cx + sqrtf(d2), value);
+        }
+        return box;
+    }
+
+    // Vertical cylinder around (cx, cz), y in [y0, y1)
+    VoxelBox stampCylinder(const float cx, const float cz, const float radius, const int y0, const int y1, const uint8_t value)
+    {
+        VoxelBox box = bounds(cx - radius, 0.0f, cz - radius, cx + radius, 0.0f, cz + radius);
+        box.y0 = y0;
+        box.y1 = y1;
+        box = clip(box);
+        for (int z = box.z0; z < box.z1; z++) {
+            const float d2 = radius*radius - (z - cz)*(z - cz);
+            if (d2 <= 0.0f) continue;
+            for (int y = box.y0; y < box.y1; y++) fillRow(y, z, cx - sqrtf(d2), cx + sqrtf(d2), value);
+        }
+        return box;
+    }
+
+    // Segment a -> b swept by a sphere. The squared distance to the segment is convex along a row, so the
+    // row minimum is solved in closed form and both span ends are found by binary search from it.
+    VoxelBox stampCapsule(const float a[3], const float b[3], const float radius, const uint8_t value)
+    {
+        const VoxelBox box = clip(bounds(fminf(a[0], b[0]) - radius, fminf(a[1], b[1]) - radius, fminf(a[2], b[2]) - radius,
+                                         fmaxf(a[0], b[0]) + radius, fmaxf(a[1], b[1]) + radius, fmaxf(a[2], b[2]) + radius));
+        const float d[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+        const float len2 = d[0]*d[0] + d[1]*d[1] + d[2]*d[2];
+        const float r2 = radius * radius;
+
+        const auto dist2 = [&](const float x, const float y, const float z) {
+            const float t = len2 > 0.0f ? clamp(((x - a[0])*d[0] + (y - a[1])*d[1] + (z - a[2])*d[2]) / len2, 0.0f, 1.0f) : 0.0f;
+            const float px = a[0] + t*d[0] - x, py = a[1] + t*d[1] - y, pz = a[2] + t*d[2] - z;
+            return px*px + py*py + pz*pz;
+        };
+
+        const float yz2 = d[1]*d[1] + d[2]*d[2];
+        for (int z = box.z0; z < box.z1; z++)
+        for (int y = box.y0; y < box.y1; y++) {
+            // Closest segment point to the row line: minimise the y/z distance only, x follows it
+            const float t = yz2 > 0.0f ? clamp(((y - a[1])*d[1] + (z - a[2])*d[2]) / yz2, 0.0f, 1.0f) : 0.5f;
+            const float xm = a[0] + t*d[0];
+            const int xi = std::clamp(static_cast<int>(roundf(xm)), box.x0, box.x1 - 1);
+            if (dist2(static_cast<float>(xi), static_cast<float>(y), static_cast<float>(z)) >= r2) continue;
+
+            int lo = box.x0, hi = xi; // first inside on the left
+            while (lo < hi) {
+                const int mid = (lo + hi) / 2;
+                if (dist2(static_cast<float>(mid), static_cast<float>(y), static_cast<float>(z)) < r2) hi = mid; else lo = mid + 1;
+            }
+            const int x0 = lo;
+            lo = xi; hi = box.x1 - 1; // last inside on the right
+            while (lo < hi) {
+                const int mid = (lo + hi + 1) / 2;
+                if (dist2(static_cast<float>(mid), static_cast<float>(y), static_cast<float>(z)) < r2) lo = mid; else hi = mid - 1;
+            }
+            memset(&data[z][y][x0], value, lo + 1 - x0);
+        }
+        return box;
+    }
+
+    // Fills the integer x strictly inside (x0, x1) on row (y, z)
+    void fillRow(const int y, const int z, const float x0, const float x1, const uint8_t value)
+    {
+        const int a = std::max(static_cast<int>(floorf(x0)) + 1, 0);
+        const int b = std::min(static_cast<int>(ceilf(x1)), size);
+        if (a < b) memset(&data[z][y][a], value, b - a);
+    }
+
+    // Integer box holding every sample in the float bounds (inclusive)
+    static VoxelBox bounds(const float x0, const float y0, const float z0, const float x1, const float y1, const float z1)
+    {
+        return { static_cast<int>(floorf(x0)), static_cast<int>(floorf(y0)), static_cast<int>(floorf(z0)),
+                 static_cast<int>(floorf(x1)) + 1, static_cast<int>(floorf(y1)) + 1, static_cast<int>(floorf(z1)) + 1 };
+    }
+
+    [[nodiscard]] VoxelBox clip(const VoxelBox b) const
+    {
+        return { std::max(b.x0, 0), std::max(b.y0, 0), std::max(b.z0, 0), std::min(b.x1, size), std::min(b.y1, size), std::min(b.z1, size) };
+    }
+
+    // Helper functions
+    static float clamp(const float x, const float min, const float max) {
+        return fmaxf(min, fminf(max, x));
+    }
+
+    static float mix(const float a, const float b, const float t)
+    {
+        return a + t * (b - a);
+    }
+
+    static float smoothstep(const float edge0, const float edge1, float x)
+    {
+        x = clamp((x - edge0) / (edge1 - edge0), 0.0f, 1.0f);
+        return x * x * (3 - 2 * x);
+    }
+
+    static float fract(const float x)
+    {
+        return x - floorf(x);
+    }
+
+    static float hash3(const float x, const float y, const float z)
+    {
+        return fract(sin(dot(vec3(x, y, z), vec3(12.9898, 78.233, 45.164))) * 43758.5453);
+    }
+
+    float noise3(const float x, const float y, const float z)
+    {
+        const int ix = static_cast<int>(floorf(x));
+        const int iy = static_cast<int>(floorf(y));
+        const int iz = static_cast<int>(floorf(z));
+
+        const float fx = x - ix;
+        const float fy = y - iy;
+        const float fz = z - iz;
+
+        const float n000 = hash3(ix, iy, iz);
+        const float n100 = hash3(ix + 1, iy, iz);
+        const float n010 = hash3(ix, iy + 1, iz);
+        const float n110 = hash3(ix + 1, iy + 1, iz);
+        const float n001 = hash3(ix, iy, iz + 1);
+        const float n101 = hash3(ix + 1, iy, iz + 1);
+        const float n011 = hash3(ix, iy + 1, iz + 1);
+        const float n111 = hash3(ix + 1, iy + 1, iz + 1);
+
+        const float u = smoothstep(0.0f, 1.0f, fx);
+        const float v = smoothstep(0.0f, 1.0f, fy);
+        const float w = smoothstep(0.0f, 1.0f, fz);
+
+        const float nx00 = mix(n000, n100, u);
+        const float nx10 = mix(n010, n110, u);
+        const float nx01 = mix(n001, n101, u);
+        const float nx11 = mix(n011, n111, u);
+
+        const float ny0 = mix(nx00, nx10, v);
+        const float ny1 = mix(nx01, nx11, v);
+
+        return mix(ny0, ny1, w);
+    }
+
+    // Sponge noise field at a voxel coordinate, solid above SPONGE_THRESHOLD
+    float spongeNoise(const float x, const float y, const float z)
+    {
+        constexpr float scale = 10.0f;
+        return noise3(x / size * scale, y / size * scale, z / size * scale);
+    }
+
+    void setRandomNoiseSponge()
+    {
+        memset(data, 0, sizeof(data));
+
+        for (int z = 0; z < size; z++)
+        for (int y = 0; y < size; y++)
+        for (int x = 0; x < size; x++) {
+            if (spongeNoise(x, y, z) > SPONGE_THRESHOLD) data[z][y][x] = 1;
+        }
+    }
+
+    [[nodiscard]] bool at(const int x, const int y, const int z) const
+    {
+        if (x < 0 || y < 0 || z < 0) return false;
+        if (x >= size || y >= size || z >= size) return false;
+        return data[z][y][x] != 0;
+    }
+
+    // Amanatides & Woo traversal in voxel coordinates (dir normalized). Returns the first solid voxel and
+    // the normal of the face the ray entered it through (zero if the ray starts inside it).
+    bool raycast(const float origin[3], const float dir[3], const float max_dist, int hit[3], int normal[3]) const
+    {
+        // Clip the ray to the grid bounds first so rays from outside do not walk empty space
+        float t0 = 0.0f, t1 = max_dist;
+        int entry_axis = -1;
+        for (int a = 0; a < 3; a++) {
+            if (fabsf(dir[a]) < 1e-12f) {
+                if (origin[a] < 0.0f || origin[a] >= static_cast<float>(size)) return false;
+                continue;
+            }
+            float ta = (0.0f - origin[a]) / dir[a];
+            float tb = (static_cast<float>(size) - origin[a]) / dir[a];
+            if (ta > tb) std::swap(ta, tb);
+            if (ta > t0) { t0 = ta; entry_axis = a; }
+            t1 = std::min(t1, tb);
+        }
+        if (t0 > t1) return false;
+
+        int cell[3], step[3];
+        float t_max[3], t_delta[3];
+        for (int a = 0; a < 3; a++) {
+            const float p = origin[a] + dir[a] * t0;
+            cell[a] = std::clamp(static_cast<int>(floorf(p)), 0, size - 1);
+            step[a] = dir[a] > 0.0f ? 1 : -1;
+            t_delta[a] = fabsf(dir[a]) > 1e-12f ? fabsf(1.0f / dir[a]) : 1e30f;
+            const float boundary = static_cast<float>(cell[a] + (dir[a] > 0.0f ? 1 : 0));
+            t_max[a] = fabsf(dir[a]) > 1e-12f ? (boundary - origin[a]) / dir[a] : 1e30f;
+            normal[a] = 0;
+        }
+        if (entry_axis >= 0) normal[entry_axis] = -step[entry_axis];
+
+        float t = t0;
+        while (t <= t1) {
+            if (data[cell[2]][cell[1]][cell[0]]) {
+                hit[0] = cell[0]; hit[1] = cell[1]; hit[2] = cell[2];
+                return true;
+            }
+            const int a = t_max[0] < t_max[1] ? (t_max[0] < t_max[2] ? 0 : 2) : (t_max[1] < t_max[2] ? 1 : 2);
+            cell[a] += step[a];
+            if (cell[a] < 0 || cell[a] >= size) return false;
+            t = t_max[a];
+            t_max[a] += t_delta[a];
+            normal[0] = normal[1] = normal[2] = 0;
+            normal[a] = -step[a];
+        }
+        return false;
+    }
+};